@@ -0,0 +1,45 @@
+# Compiles Slang shaders to SPIR-V at build time, so the binaries the pipelines load always match their sources
+
+find_program(SLANGC_EXECUTABLE slangc
+    HINTS "$ENV{VULKAN_SDK}/bin" "$ENV{VULKAN_SDK}/Bin"
+    REQUIRED
+)
+
+# Slang stage names and the extension of the binary each entry point is written to
+set(SLANG_STAGES vertex hull domain geometry fragment)
+set(SLANG_STAGE_EXT_vertex vert)
+set(SLANG_STAGE_EXT_hull tesc)
+set(SLANG_STAGE_EXT_domain tese)
+set(SLANG_STAGE_EXT_geometry geom)
+set(SLANG_STAGE_EXT_fragment frag)
+
+# Every [shader("<stage>")] entry point of a source, named <stage>Main, becomes <name>.<ext>.spv next to it
+function(add_slang_shaders TARGET)
+    set(SPV_FILES)
+    foreach(SOURCE ${ARGN})
+        get_filename_component(SOURCE "${SOURCE}" ABSOLUTE)
+        get_filename_component(SOURCE_DIR "${SOURCE}" DIRECTORY)
+        get_filename_component(SOURCE_NAME "${SOURCE}" NAME_WE)
+        set_property(DIRECTORY APPEND PROPERTY CMAKE_CONFIGURE_DEPENDS "${SOURCE}")
+
+        file(READ "${SOURCE}" SOURCE_TEXT)
+        foreach(STAGE ${SLANG_STAGES})
+            if(NOT SOURCE_TEXT MATCHES "\\[shader\\(\"${STAGE}\"\\)\\]")
+                continue()
+            endif()
+
+            set(SPV "${SOURCE_DIR}/${SOURCE_NAME}.${SLANG_STAGE_EXT_${STAGE}}.spv")
+            add_custom_command(
+                OUTPUT "${SPV}"
+                COMMAND "${SLANGC_EXECUTABLE}" "${SOURCE}" -target spirv -profile spirv_1_4 -stage ${STAGE} -entry ${STAGE}Main -o "${SPV}"
+                DEPENDS "${SOURCE}"
+                COMMENT "Compiling ${SOURCE_NAME}.slang ${STAGE}"
+                VERBATIM
+            )
+            list(APPEND SPV_FILES "${SPV}")
+        endforeach()
+    endforeach()
+
+    add_custom_target(${TARGET}Shaders DEPENDS ${SPV_FILES})
+    add_dependencies(${TARGET} ${TARGET}Shaders)
+endfunction()
@@ -4,10 +4,23 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb.h>
 #include <stb_image.h>
+
+#include "implot.h"
+#include "Hash.h"
+
+#include <algorithm>
 #include <array>
+#include <fstream>
 
 namespace jgw
 {
+    static constexpr std::array<vk::PresentModeKHR, 4> kPresentModes = {
+        vk::PresentModeKHR::eFifo,
+        vk::PresentModeKHR::eFifoRelaxed,
+        vk::PresentModeKHR::eMailbox,
+        vk::PresentModeKHR::eImmediate
+    };
+
     BaseApp::BaseApp(const WindowConfig& config)
     {
         windowPtr = std::make_unique<Window>(config);
@@ -17,6 +30,19 @@ namespace jgw
         canvas3D = std::make_unique<LineCanvas3D>();
         canvas2D = std::make_unique<LineCanvas2D>();
         canvasGrid = std::make_unique<GridCanvas>();
+        jobQueue = std::make_unique<JobQueue>();
+
+        // CPU implementations such as lavapipe are what GPU-less hosts have to offer
+        contextPtr->SetHeadless(config.headless);
+        contextPtr->GetDeviceSelectionConfig().allowCpu = config.headless || !config.device.empty();
+        contextPtr->GetDeviceSelectionConfig().preferredDevice = config.device;
+        frameLimit = config.frameCount;
+        renderThreaded = config.renderThread;
+        contextPtr->GetFramePacingConfig().frameRateLimit = config.frameRateLimit;
+
+        // Benchmarks measure the frame, not the display refresh
+        if (config.benchmark)
+            contextPtr->GetFramePacingConfig().presentMode = vk::PresentModeKHR::eImmediate;
     }
 
     void BaseApp::Start()
@@ -28,29 +54,92 @@ namespace jgw
         double curTime = 0.0;
 
         GLFWwindow* handle = windowPtr->GetHandle();
-        while (!glfwWindowShouldClose(handle))
+        const double fixedTimestep = windowPtr->GetConfig().fixedTimestep;
+        if (renderThreaded)
         {
-            glfwPollEvents();
+            lastFrameEnd = glfwGetTime();
+            renderThread = std::thread(&BaseApp::RenderThreadMain, this);
+        }
 
+        while (!glfwWindowShouldClose(handle) && (frameLimit == 0 || renderedFrames < frameLimit))
+        {
+            // Waits before input is sampled, so the limiter does not add to the latency
+            if (!benchmark)
+                frameLimiter.Wait(contextPtr->GetFramePacingConfig().frameRateLimit);
+
+            const double frameStart = glfwGetTime();
+            PollEvents();
+            const double inputTime = glfwGetTime();
+            if (renderThreaded)
+                PublishCamera();
+            else
+                ApplyResize();
+
+            // Benchmarks advance by the fixed timestep so every run sees the same simulation
             curTime = glfwGetTime();
-            Update(curTime - lastTime);
+            Update(benchmark ? fixedTimestep : curTime - lastTime);
             lastTime = curTime;
-            
-            if (!iconified && contextPtr->BeginRender())
+
+            if (!renderThreaded)
+            {
+                if (!iconified)
+                {
+                    CaptureSnapshot(frameStart, inputTime);
+                    RenderFrame();
+                }
+                FinishFrame();
+                continue;
+            }
+
+            // The previous frame has to be submitted before its snapshot is replaced, the swapchain and
+            // everything else the render thread uses may only change in between
+            WaitRenderThread();
+            ApplyResize();
+            FinishFrame();
+
+            if (!iconified && (frameLimit == 0 || renderedFrames < frameLimit))
             {
-                Render();
-                contextPtr->EndRender();
+                CaptureSnapshot(frameStart, inputTime);
+                KickRenderThread();
             }
         }
 
+        StopRenderThread();
         contextPtr->WaitDeviceIdle();
+        if (frameLimit > 0)
+            spdlog::info("Rendered {} frames{}", renderedFrames.load(), contextPtr->IsHeadless() ? " headless" : "");
+
+        if (benchmark)
+        {
+            const WindowConfig& config = windowPtr->GetConfig();
+            const BenchmarkInfo info{
+                .name = config.title,
+                .device = contextPtr->GetPhysicalDevice().getProperties().deviceName.data(),
+                .extent = contextPtr->GetRenderExtent(),
+                .timestep = fixedTimestep,
+                .headless = contextPtr->IsHeadless()
+            };
+            benchmark->WriteJson(config.benchmarkOutput.c_str(), info);
+        }
+
         Cleanup();
     }
 
     void BaseApp::Resize(int width, int height)
     {
-        contextPtr->WindowResize();
-        OnResize(width, height);
+        resizePending = true;
+        pendingWidth = width;
+        pendingHeight = height;
+    }
+
+    void BaseApp::ApplyResize()
+    {
+        if (!resizePending || iconified)
+            return;
+
+        resizePending = false;
+        contextPtr->RecreateSwapchain();
+        OnResize(pendingWidth, pendingHeight);
     }
 
     void BaseApp::OnKey(int key, int scancode, int action, int mods)
@@ -68,6 +157,12 @@ namespace jgw
             cameraPtr->keyState.acc = pressed;
         if (key == GLFW_KEY_F1 && !pressed)
             showUI = !showUI;
+        if (key == GLFW_KEY_F2 && !pressed)
+            showMemoryStats = !showMemoryStats;
+        if (key == GLFW_KEY_F3 && !pressed)
+            showFramePacing = !showFramePacing;
+        if (key == GLFW_KEY_F4 && !pressed)
+            showAllocations = !showAllocations;
     }
 
     void BaseApp::OnMouse(int button, int action, int modes)
@@ -94,6 +189,8 @@ namespace jgw
         }
 
         mouseState.pos = glm::vec2(nx, ny);
+        mouseState.cursor = glm::vec2(x, y);
+        mouseState.timestamp = glfwGetTime();
     }
 
     void BaseApp::OnMouseScroll(float x, float y)
@@ -124,6 +221,8 @@ namespace jgw
 
     std::vector<const char*> BaseApp::GetDeviceExtensions() const
     {
+        if (windowPtr->IsHeadless())
+            return { VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME };
         return { VK_KHR_SWAPCHAIN_EXTENSION_NAME, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME };
     }
 
@@ -136,92 +235,270 @@ namespace jgw
             contextPtr->GetDevice(),
             contextPtr->GetQueue(),
             contextPtr->GetQueuFamily(),
-            contextPtr->GetSwapchain()->GetImageCount(),
-            static_cast<VkFormat>(contextPtr->GetSwapchain()->GetFormat()),
+            contextPtr->GetColorImageCount(),
+            static_cast<VkFormat>(contextPtr->GetColorFormat()),
             static_cast<VkFormat>(depthFormat),
             contextPtr->GetApiVersion()
         );
     }
 
-    void BaseApp::TransitionImageLayout(
-        vk::CommandBuffer       commandBuffer,
-        vk::Image               image,
-        vk::ImageLayout         oldLayout,
-        vk::ImageLayout         newLayout,
-        vk::AccessFlags         srcAccessMask,
-        vk::AccessFlags         dstAccessMask,
-        vk::PipelineStageFlags  srcStage,
-        vk::PipelineStageFlags  dstStage
-    )
-    {
-        vk::ImageMemoryBarrier imageMemoryBarrier{
-            .srcAccessMask = srcAccessMask,
-            .dstAccessMask = dstAccessMask,
-            .oldLayout = oldLayout,
-            .newLayout = newLayout,
-            .image = image,
-            .subresourceRange = {
-                .aspectMask = vk::ImageAspectFlagBits::eColor,
-                .baseMipLevel = 0,
-                .levelCount = 1,
-                .baseArrayLayer = 0,
-                .layerCount = 1
-            }
-        };
-
-        commandBuffer.pipelineBarrier(srcStage, dstStage, {}, {}, {}, imageMemoryBarrier);
-    }
-
     std::unique_ptr<VulkanTexture> BaseApp::LoadTexture(const char* filename, bool mipmapped)
     {
-        int w, h, comp;
-        stbi_set_flip_vertically_on_load(true);
-        auto* data = stbi_load(filename, &w, &h, &comp, 4);
+        auto textures = LoadTextures({ filename }, mipmapped);
+        return std::move(textures[0]);
+    }
 
-        const TextureDesc desc{
-            .usageFlags = vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled,
-            .extent = {
-                .width = static_cast<uint32_t>(w),
-                .height = static_cast<uint32_t>(h),
-                .depth = 1
-            },
-            .mipLevels = mipmapped ? static_cast<uint32_t>(std::floor(std::log2(std::max<int>(w, h)))) + 1 : 1,
-            .mipmapped = mipmapped
+    std::vector<std::unique_ptr<VulkanTexture>> BaseApp::LoadTextures(const std::vector<std::string>& filenames, bool mipmapped)
+    {
+        struct ImageInfo
+        {
+            int width = 0;
+            int height = 0;
+            vk::DeviceSize offset = 0;
+            bool valid = false;
         };
 
-        const VmaAllocationDesc allocDesc{
-            .flags = vma::AllocationCreateFlagBits::eDedicatedMemory,
-            .usage = vma::MemoryUsage::eAutoPreferDevice
+        std::vector<std::unique_ptr<VulkanTexture>> textures(filenames.size());
+
+        // Single level images are written by the workers straight from the decoded pixels when the device
+        // supports host image copy, mip chains are still generated with blits on the graphics queue
+        const bool hostCopy = !mipmapped && contextPtr->SupportsHostImageCopy(vk::Format::eR8G8B8A8Srgb);
+
+        // Only the headers are read here to lay out the staging buffer
+        std::vector<ImageInfo> images(filenames.size());
+        vk::DeviceSize stagingSize = 0;
+        bool anyValid = false;
+        for (size_t i = 0; i < filenames.size(); ++i)
+        {
+            int comp;
+            if (!stbi_info(filenames[i].c_str(), &images[i].width, &images[i].height, &comp))
+            {
+                spdlog::error("Failed to load texture {}: {}", filenames[i], stbi_failure_reason());
+                continue;
+            }
+
+            images[i].offset = stagingSize;
+            images[i].valid = true;
+            anyValid = true;
+            if (!hostCopy)
+                stagingSize += (static_cast<vk::DeviceSize>(images[i].width) * images[i].height * 4 + 15) & ~vk::DeviceSize(15);
+        }
+
+        if (!anyValid)
+            return textures;
+
+        auto createTexture = [&](size_t i) {
+            vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled;
+            if (hostCopy)
+                usage |= vk::ImageUsageFlagBits::eHostTransferEXT;
+
+            const TextureDesc desc{
+                .usageFlags = usage,
+                .extent = {
+                    .width = static_cast<uint32_t>(images[i].width),
+                    .height = static_cast<uint32_t>(images[i].height),
+                    .depth = 1
+                },
+                .mipLevels = mipmapped ? static_cast<uint32_t>(std::floor(std::log2(std::max(images[i].width, images[i].height)))) + 1 : 1,
+                .mipmapped = mipmapped
+            };
+
+            textures[i] = contextPtr->CreateTexture(desc);
         };
 
-        std::unique_ptr<VulkanTexture> texture = contextPtr->CreateTexture(desc, allocDesc);
-        std::unique_ptr<VulkanBuffer> stagingBuffer = contextPtr->CreateBuffer(
-            w * h * 4,
-            vk::BufferUsageFlagBits::eTransferSrc,
-            vma::AllocationCreateFlagBits::eMapped | vma::AllocationCreateFlagBits::eHostAccessSequentialWrite
-        );
+        std::unique_ptr<VulkanBuffer> stagingBuffer;
+        uint8_t* staging = nullptr;
+        if (hostCopy)
+        {
+            // The workers write into the images, so they have to exist first
+            for (size_t i = 0; i < filenames.size(); ++i)
+            {
+                if (images[i].valid)
+                    createTexture(i);
+            }
+        }
+        else
+        {
+            stagingBuffer = contextPtr->CreateBuffer(
+                stagingSize,
+                vk::BufferUsageFlagBits::eTransferSrc,
+                vma::AllocationCreateFlagBits::eMapped | vma::AllocationCreateFlagBits::eHostAccessSequentialWrite
+            );
+            staging = static_cast<uint8_t*>(stagingBuffer->Data());
+        }
+
+        // Workers decode into disjoint ranges of the mapped staging buffer or copy into their own image
+        std::vector<uint8_t> decoded(filenames.size(), 0);
+        for (size_t i = 0; i < filenames.size(); ++i)
+        {
+            if (!images[i].valid)
+                continue;
+
+            jobQueue->Submit([&, i] {
+                stbi_set_flip_vertically_on_load_thread(true);
+
+                int w, h, comp;
+                auto* data = stbi_load(filenames[i].c_str(), &w, &h, &comp, 4);
+                if (data == nullptr || w != images[i].width || h != images[i].height)
+                {
+                    spdlog::error("Failed to decode texture {}: {}", filenames[i], stbi_failure_reason());
+                }
+                else if (hostCopy)
+                {
+                    vk::MemoryToImageCopyEXT region{
+                        .pHostPointer = data,
+                        .imageSubresource = {
+                            .aspectMask = vk::ImageAspectFlagBits::eColor,
+                            .mipLevel = 0,
+                            .baseArrayLayer = 0,
+                            .layerCount = 1
+                        },
+                        .imageExtent = {
+                            .width = static_cast<uint32_t>(w),
+                            .height = static_cast<uint32_t>(h),
+                            .depth = 1
+                        }
+                    };
+                    decoded[i] = contextPtr->HostCopyToTexture(textures[i].get(), { region }) ? 1 : 0;
+                }
+                else
+                {
+                    memcpy(staging + images[i].offset, data, static_cast<size_t>(w) * h * 4);
+                    decoded[i] = 1;
+                }
+                stbi_image_free(data);
+            });
+        }
+
+        // Create the images while the workers decode
+        if (!hostCopy)
+        {
+            for (size_t i = 0; i < filenames.size(); ++i)
+            {
+                if (images[i].valid)
+                    createTexture(i);
+            }
+        }
+
+        jobQueue->Wait();
+
+        if (hostCopy)
+        {
+            for (size_t i = 0; i < filenames.size(); ++i)
+            {
+                if (!decoded[i])
+                    textures[i].reset();
+            }
+
+            return textures;
+        }
+
+        stagingBuffer->Flush();
 
         contextPtr->BeginCommand();
-        contextPtr->UploadTexture(data, stagingBuffer.get(), texture.get());
+        for (size_t i = 0; i < filenames.size(); ++i)
+        {
+            if (decoded[i])
+                contextPtr->CopyBufferToTexture(stagingBuffer.get(), images[i].offset, textures[i].get());
+            else
+                textures[i].reset();
+        }
         contextPtr->EndCommand();
 
-        stbi_image_free(data);
-
-        return texture;
+        return textures;
     }
 
     std::unique_ptr<VulkanTexture> BaseApp::LoadCubeTexture(const char* filename, vk::Format format)
     {
+        return LoadKtxTexture(filename, format);
+    }
+
+    // Best block format the device can sample, in order of quality
+    static ktx_transcode_fmt_e ChooseTranscodeFormat(const VulkanContext& context)
+    {
+        const vk::FormatFeatureFlags features = vk::FormatFeatureFlagBits::eSampledImage | vk::FormatFeatureFlagBits::eTransferDst;
+
+        if (context.IsFormatSupported(vk::Format::eBc7UnormBlock, features))
+            return KTX_TTF_BC7_RGBA;
+        if (context.IsFormatSupported(vk::Format::eAstc4x4UnormBlock, features))
+            return KTX_TTF_ASTC_4x4_RGBA;
+        if (context.IsFormatSupported(vk::Format::eEtc2R8G8B8A8UnormBlock, features))
+            return KTX_TTF_ETC2_RGBA;
+        if (context.IsFormatSupported(vk::Format::eBc3UnormBlock, features))
+            return KTX_TTF_BC3_RGBA;
+
+        return KTX_TTF_RGBA32;
+    }
+
+    std::unique_ptr<VulkanTexture> BaseApp::LoadKtxTexture(const char* filename, vk::Format format)
+    {
+        // Only the header is read here, image data goes to staging memory further down
         ktxTexture* ktxTexture;
-        ktxResult result = ktxTexture_CreateFromNamedFile(filename, KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
-        assert(result == KTX_SUCCESS);
+        ktxResult result = ktxTexture_CreateFromNamedFile(filename, KTX_TEXTURE_CREATE_NO_FLAGS, &ktxTexture);
+        if (result != KTX_SUCCESS)
+        {
+            spdlog::error("Failed to load KTX texture {}: {}", filename, ktxErrorString(result));
+            return nullptr;
+        }
+
+        // Supercompressed or Basis data has to be inflated or transcoded by libktx in its own buffer first
+        const bool supercompressed = ktxTexture->classId == ktxTexture2_c && reinterpret_cast<ktxTexture2*>(ktxTexture)->supercompressionScheme != KTX_SS_NONE;
+        bool direct = !supercompressed && !ktxTexture_NeedsTranscoding(ktxTexture);
+        if (!direct)
+        {
+            result = ktxTexture_LoadImageData(ktxTexture, nullptr, 0);
+            if (result != KTX_SUCCESS)
+            {
+                spdlog::error("Failed to load KTX image data {}: {}", filename, ktxErrorString(result));
+                ktxTexture_Destroy(ktxTexture);
+                return nullptr;
+            }
+        }
+
+        if (ktxTexture_NeedsTranscoding(ktxTexture))
+        {
+            const ktx_transcode_fmt_e transcodeFormat = ChooseTranscodeFormat(*contextPtr);
+            result = ktxTexture2_TranscodeBasis(reinterpret_cast<ktxTexture2*>(ktxTexture), transcodeFormat, 0);
+            if (result != KTX_SUCCESS)
+            {
+                spdlog::error("Failed to transcode KTX texture {}: {}", filename, ktxErrorString(result));
+                ktxTexture_Destroy(ktxTexture);
+                return nullptr;
+            }
+        }
+
+        if (format == vk::Format::eUndefined)
+            format = static_cast<vk::Format>(ktxTexture_GetVkFormat(ktxTexture));
+
+        if (format == vk::Format::eUndefined || !contextPtr->IsFormatSupported(format, vk::FormatFeatureFlagBits::eSampledImage))
+        {
+            spdlog::error("Unsupported format {} in KTX texture {}", vk::to_string(format), filename);
+            ktxTexture_Destroy(ktxTexture);
+            return nullptr;
+        }
 
         ktx_size_t ktxTextureSize = ktxTexture_GetDataSize(ktxTexture);
 
+        const bool cube = ktxTexture->isCubemap;
+        const bool array = ktxTexture->isArray;
+
+        vk::ImageViewType viewType = vk::ImageViewType::e2D;
+        if (cube)
+            viewType = array ? vk::ImageViewType::eCubeArray : vk::ImageViewType::eCube;
+        else if (array)
+            viewType = vk::ImageViewType::e2DArray;
+
+        // KTX files carry their whole mip chain, so every level can be written from the host
+        const bool hostCopy = contextPtr->SupportsHostImageCopy(format);
+
+        vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled;
+        if (hostCopy)
+            usage |= vk::ImageUsageFlagBits::eHostTransferEXT;
+
         const TextureDesc desc{
-            .flags = vk::ImageCreateFlagBits::eCubeCompatible,
-            .usageFlags = vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled,
-            .viewType = vk::ImageViewType::eCube,
+            .flags = cube ? vk::ImageCreateFlagBits::eCubeCompatible : vk::ImageCreateFlags{},
+            .usageFlags = usage,
+            .viewType = viewType,
             .format = format,
             .extent = {
                 .width = static_cast<uint32_t>(ktxTexture->baseWidth),
@@ -229,7 +506,7 @@ namespace jgw
                 .depth = ktxTexture->baseDepth
             },
             .mipLevels = ktxTexture->numLevels,
-            .arrayLayers = ktxTexture->numFaces,
+            .arrayLayers = ktxTexture->numLayers * ktxTexture->numFaces,
             .mipmapped = (ktxTexture->numLevels > 1)
         };
 
@@ -238,14 +515,50 @@ namespace jgw
         };
 
         std::unique_ptr<VulkanTexture> texture = contextPtr->CreateTexture(desc, allocDesc);
+
+        if (hostCopy)
+        {
+            // Host copies read from the buffer owned by libktx, staging stays a fallback
+            if (direct)
+            {
+                result = ktxTexture_LoadImageData(ktxTexture, nullptr, 0);
+                if (result != KTX_SUCCESS)
+                {
+                    spdlog::error("Failed to load KTX image data {}: {}", filename, ktxErrorString(result));
+                    ktxTexture_Destroy(ktxTexture);
+                    return nullptr;
+                }
+                direct = false;
+            }
+
+            if (contextPtr->HostCopyKtxToTexture(ktxTexture, texture.get()))
+            {
+                ktxTexture_Destroy(ktxTexture);
+                return texture;
+            }
+        }
+
         std::unique_ptr<VulkanBuffer> stagingBuffer = contextPtr->CreateBuffer(
             ktxTextureSize,
             vk::BufferUsageFlagBits::eTransferSrc,
             vma::AllocationCreateFlagBits::eMapped | vma::AllocationCreateFlagBits::eHostAccessSequentialWrite
         );
 
+        // Level by level and face by face from the file straight into mapped staging memory
+        if (direct)
+            result = ktxTexture_LoadImageData(ktxTexture, static_cast<ktx_uint8_t*>(stagingBuffer->Data()), ktxTextureSize);
+        else
+            memcpy(stagingBuffer->Data(), ktxTexture_GetData(ktxTexture), ktxTextureSize);
+
+        if (result != KTX_SUCCESS)
+        {
+            spdlog::error("Failed to load KTX image data {}: {}", filename, ktxErrorString(result));
+            ktxTexture_Destroy(ktxTexture);
+            return nullptr;
+        }
+
         contextPtr->BeginCommand();
-        contextPtr->UploadCubeTexture(ktxTexture, stagingBuffer.get(), texture.get());
+        contextPtr->CopyKtxToTexture(ktxTexture, stagingBuffer.get(), texture.get());
         contextPtr->EndCommand();
         
         ktxTexture_Destroy(ktxTexture);
@@ -253,6 +566,66 @@ namespace jgw
         return texture;
     }
 
+    std::shared_ptr<VulkanTexture> BaseApp::AcquireTexture(const char* filename, bool mipmapped)
+    {
+        uint64_t params = 0;
+        HashCombine(params, mipmapped);
+
+        return AcquireCachedTexture(filename, params, [&] { return LoadTexture(filename, mipmapped); });
+    }
+
+    std::shared_ptr<VulkanTexture> BaseApp::AcquireKtxTexture(const char* filename, vk::Format format)
+    {
+        uint64_t params = 1;
+        HashCombine(params, static_cast<uint32_t>(format));
+
+        return AcquireCachedTexture(filename, params, [&] { return LoadKtxTexture(filename, format); });
+    }
+
+    std::shared_ptr<VulkanTexture> BaseApp::AcquireCachedTexture(const char* filename, uint64_t params, const std::function<std::unique_ptr<VulkanTexture>()>& load)
+    {
+        std::ifstream is(filename, std::ios::binary);
+        if (!is.is_open())
+        {
+            spdlog::error("Could not open texture file {}", filename);
+            return nullptr;
+        }
+
+        // Same content under a different path still hits the cache. The file is hashed in chunks, the loader
+        // reads it again on a miss and nothing holds a second copy of it.
+        std::array<char, 16 * 1024> chunk;
+        uint64_t key = kHashSeed;
+        while (is.read(chunk.data(), chunk.size()) || is.gcount() > 0)
+            key = HashBytes(chunk.data(), static_cast<size_t>(is.gcount()), key);
+        HashCombine(key, params);
+
+        auto& cached = textureCache[key];
+        if (auto texture = cached.lock())
+            return texture;
+
+        std::shared_ptr<VulkanTexture> texture = load();
+        cached = texture;
+        return texture;
+    }
+
+    std::unique_ptr<VulkanTexture> BaseApp::LoadStreamingTexture(const char* filename)
+    {
+        int w, h, comp;
+        stbi_set_flip_vertically_on_load(true);
+        auto* data = stbi_load(filename, &w, &h, &comp, 4);
+        if (data == nullptr)
+        {
+            spdlog::error("Failed to load texture {}", filename);
+            return nullptr;
+        }
+
+        auto texture = contextPtr->GetTextureStreamer()->CreateTexture(data, static_cast<uint32_t>(w), static_cast<uint32_t>(h), vk::Format::eR8G8B8A8Srgb, jobQueue.get());
+
+        stbi_image_free(data);
+
+        return texture;
+    }
+
     bool BaseApp::Initialize()
     {
         if (!windowPtr->Initialize())
@@ -277,44 +650,354 @@ namespace jgw
         if (!canvasGrid->Initialize(*contextPtr))
             return false;
 
-        return OnInit();
+        renderGraph = std::make_unique<RenderGraph>(*contextPtr);
+        contextPtr->SetLateLatch([this](FrameConstants& constants) { LatchCamera(constants); });
+
+        if (!OnInit())
+            return false;
+
+        // Most pipelines exist by now, a crash later on still finds them cached next run
+        contextPtr->SavePipelineCache();
+
+        return InitBenchmark();
+    }
+
+    void BaseApp::PollEvents()
+    {
+        // Benchmarks and headless runs have nobody to wait for
+        if (benchmark || contextPtr->IsHeadless())
+        {
+            glfwPollEvents();
+            return;
+        }
+
+        // Nothing is rendered while minimized, sleep until the window is restored or closed
+        if (iconified)
+        {
+            glfwWaitEvents();
+            return;
+        }
+
+        const FramePacingConfig& config = contextPtr->GetFramePacingConfig();
+        float rate = focused ? 0.0f : config.unfocusedFrameRate;
+        if (config.idleFrameRate > 0.0f && glfwGetTime() - lastInputTime > config.idleDelay)
+            rate = rate > 0.0f ? std::min(rate, config.idleFrameRate) : config.idleFrameRate;
+
+        // Any event ends the wait early, so input is still handled right away
+        if (rate > 0.0f)
+            glfwWaitEventsTimeout(1.0 / rate);
+        else
+            glfwPollEvents();
+    }
+
+    void BaseApp::LatchCamera(FrameConstants& constants)
+    {
+        // Benchmarks fly a fixed path, picking up input would make runs differ
+        if (!snapshot.lateLatch || benchmark)
+            return;
+
+        PublishedCamera camera;
+        if (renderThreaded)
+        {
+            // Events may only be polled on the main thread, which publishes the camera after each poll
+            std::lock_guard lock(cameraMutex);
+            camera = publishedCamera;
+        }
+        else
+        {
+            // Mouse motion that arrived while the frame was recorded turns a copy of the camera before submit. The
+            // cursor is sampled directly, pumping events here would run every other callback in the middle of
+            // EndRender. The camera itself still turns in the next PollEvents, from the same mouse position.
+            double x = 0.0, y = 0.0;
+            glfwGetCursorPos(windowPtr->GetHandle(), &x, &y);
+            if (!mouseState.pressedRight || glm::vec2(x, y) == mouseState.cursor)
+                return;
+
+            int width, height;
+            glfwGetFramebufferSize(windowPtr->GetHandle(), &width, &height);
+            const float dx = static_cast<float>(x / width) - mouseState.pos.x;
+            const float dy = static_cast<float>(y / height) - mouseState.pos.y;
+
+            Camera latched = *cameraPtr;
+            latched.Rotate(glm::vec3(dy * latched.RotationSpeed(), dx * latched.RotationSpeed(), 0.0f));
+
+            camera = {
+                .view = latched.GetViewMatrix(),
+                .position = latched.GetPosition(),
+                .timestamp = glfwGetTime()
+            };
+        }
+
+        if (camera.timestamp <= snapshot.mouseTime)
+            return;
+
+        constants.view = camera.view;
+        constants.viewProj = constants.proj * constants.view;
+        constants.cameraPos = glm::vec4(camera.position, 1.0f);
+        contextPtr->MarkInputSampled(camera.timestamp);
+    }
+
+    void BaseApp::CaptureSnapshot(double frameStart, double inputTime)
+    {
+        snapshot.constants = {
+            .view = cameraPtr->GetViewMatrix(),
+            .proj = cameraPtr->GetProjMatrix(),
+            .viewProj = cameraPtr->GetProjMatrix() * cameraPtr->GetViewMatrix(),
+            .cameraPos = glm::vec4(cameraPtr->GetPosition(), 1.0f),
+            .time = static_cast<float>(simulationTime)
+        };
+        snapshot.frameStart = frameStart;
+        snapshot.inputTime = inputTime;
+        snapshot.mouseTime = mouseState.timestamp;
+        snapshot.lateLatch = lateLatch;
+
+        AllocationScope allocationScope(EAllocationSubsystem::Update);
+        imguiPtr->Snapshot();
+        canvas3D->Snapshot();
+        OnSnapshot();
+    }
+
+    void BaseApp::RenderFrame()
+    {
+        contextPtr->MarkInputSampled(snapshot.inputTime);
+        if (!contextPtr->BeginRender())
+            return;
+
+        {
+            AllocationScope allocationScope(EAllocationSubsystem::Render);
+            Render();
+        }
+
+        AllocationScope allocationScope(EAllocationSubsystem::Submit);
+        contextPtr->EndRender();
+        const double frameEnd = glfwGetTime();
+        ++renderedFrames;
+
+        if (benchmark)
+        {
+            // With the render thread the stages overlap, a frame takes as long as the interval between submits
+            const double frameStart = renderThreaded ? lastFrameEnd : snapshot.frameStart;
+            const DrawStats drawStats = contextPtr->GetDrawStats();
+            benchmark->AddFrame({
+                .cpuFrameMs = static_cast<float>((frameEnd - frameStart) * 1000.0),
+                .gpuFrameMs = contextPtr->GetGpuFrameTimeMs(),
+                .draws = drawStats.draws,
+                .triangles = drawStats.triangles
+            });
+        }
+        lastFrameEnd = frameEnd;
+    }
+
+    void BaseApp::FinishFrame()
+    {
+        for (auto& command : idleCommands)
+            command();
+        idleCommands.clear();
+
+        if (showUI && (showMemoryStats || showFramePacing))
+            CaptureStats();
+
+        AllocationTracker::EndFrame();
+    }
+
+    void BaseApp::CaptureStats()
+    {
+        uiStats.heaps = contextPtr->GetHeapStats();
+        for (uint32_t i = 0; i < static_cast<uint32_t>(EMemoryCategory::Count); ++i)
+            uiStats.categories[i] = contextPtr->GetCategoryStats(static_cast<EMemoryCategory>(i));
+        uiStats.texturePools = contextPtr->GetTexturePoolStats();
+        uiStats.streaming = contextPtr->GetTextureStreamer()->GetStats();
+        uiStats.residency = contextPtr->GetResidencyManager()->GetStats();
+        uiStats.residencyConfig = contextPtr->GetResidencyManager()->Config();
+        uiStats.renderGraph = renderGraph->GetStats();
+        uiStats.pipelines = contextPtr->GetPipelineStats();
+        uiStats.pendingDestroys = contextPtr->GetPendingDestroyCount();
+        uiStats.defragmenting = contextPtr->IsDefragmenting();
+
+        uiStats.latency = contextPtr->GetLatencyStats();
+        uiStats.gpuFrameTimeMs = contextPtr->GetGpuFrameTimeMs();
+        uiStats.colorImageCount = contextPtr->GetColorImageCount();
+        uiStats.frameInFlight = contextPtr->GetFrameInFlight();
+
+        auto* swapchain = contextPtr->GetSwapchain();
+        uiStats.swapchain = swapchain != nullptr;
+        uiStats.presentModes.clear();
+        if (swapchain)
+        {
+            uiStats.presentMode = swapchain->GetPresentMode();
+            uiStats.imageCount = swapchain->GetImageCount();
+            for (const auto mode : kPresentModes)
+            {
+                if (swapchain->IsPresentModeSupported(mode))
+                    uiStats.presentModes.push_back(mode);
+            }
+        }
+    }
+
+    void BaseApp::PublishCamera()
+    {
+        // Only the main thread writes the published camera, reading it here needs no lock
+        if (mouseState.timestamp == publishedCamera.timestamp)
+            return;
+
+        std::lock_guard lock(cameraMutex);
+        publishedCamera = {
+            .view = cameraPtr->GetViewMatrix(),
+            .position = cameraPtr->GetPosition(),
+            .timestamp = mouseState.timestamp
+        };
+    }
+
+    void BaseApp::RenderThreadMain()
+    {
+        std::unique_lock lock(renderMutex);
+        while (true)
+        {
+            renderCondition.wait(lock, [this] { return renderRequested || renderStop; });
+            if (!renderRequested)
+                return;
+
+            lock.unlock();
+            RenderFrame();
+            lock.lock();
+
+            renderRequested = false;
+            renderCondition.notify_all();
+        }
+    }
+
+    void BaseApp::KickRenderThread()
+    {
+        {
+            std::lock_guard lock(renderMutex);
+            renderRequested = true;
+        }
+        renderCondition.notify_all();
+    }
+
+    void BaseApp::WaitRenderThread()
+    {
+        std::unique_lock lock(renderMutex);
+        renderCondition.wait(lock, [this] { return !renderRequested; });
+    }
+
+    void BaseApp::StopRenderThread()
+    {
+        if (!renderThread.joinable())
+            return;
+
+        {
+            std::lock_guard lock(renderMutex);
+            renderStop = true;
+        }
+        renderCondition.notify_all();
+        renderThread.join();
+    }
+
+    bool BaseApp::InitBenchmark()
+    {
+        const WindowConfig& config = windowPtr->GetConfig();
+        if (!config.benchmark)
+            return true;
+
+        // A recorded path replaces the one of the app
+        if (!config.cameraPath.empty())
+        {
+            if (!benchmarkPath.Load(config.cameraPath.c_str()))
+                return false;
+        }
+        else
+        {
+            benchmarkPath = GetBenchmarkPath();
+        }
+
+        if (benchmarkPath.IsEmpty())
+        {
+            spdlog::error("Benchmark needs a camera path, pass --camera-path or override GetBenchmarkPath");
+            return false;
+        }
+
+        // Without a frame count the path is flown once
+        const uint32_t measuredFrames = config.frameCount > 0
+            ? config.frameCount
+            : static_cast<uint32_t>(std::ceil(benchmarkPath.GetDuration() / config.fixedTimestep)) + 1;
+        benchmark = std::make_unique<FrameBenchmark>(kBenchmarkWarmupFrames, measuredFrames);
+        frameLimit = benchmark->GetFrameCount();
+
+        spdlog::info("Benchmark: {} warmup and {} measured frames at {} s per frame", kBenchmarkWarmupFrames, measuredFrames, config.fixedTimestep);
+        return true;
     }
 
     void BaseApp::Render()
     {
         auto commandBuffer = contextPtr->GetCommandBuffer();
 
-        TransitionImageLayout(
-            commandBuffer,
-            contextPtr->GetSwapchain()->GetImage(),
-            vk::ImageLayout::eUndefined,
-            vk::ImageLayout::eColorAttachmentOptimal,
-            {},
-            vk::AccessFlagBits::eColorAttachmentWrite,
-            vk::PipelineStageFlagBits::eTopOfPipe,
-            vk::PipelineStageFlagBits::eColorAttachmentOutput
-        );
+        const auto extent = contextPtr->GetRenderExtent();
+        FrameConstants frameConstants = snapshot.constants;
+        frameConstants.viewportSize = glm::vec2(extent.width, extent.height);
+        frameConstants.frameIndex = static_cast<uint32_t>(contextPtr->GetFrameIndex());
+        contextPtr->SetFrameConstants(frameConstants);
+
+        auto depthTexture = contextPtr->GetDepthTexture();
+
+        renderGraph->Reset();
+
+        // The acquire semaphore is waited on at color attachment output. Offscreen targets are left ready
+        // for a copy, the frame slot wait already ordered them after the frame that used them before.
+        const bool headless = contextPtr->IsHeadless();
+        swapchainTarget = renderGraph->Import(headless ? "Offscreen" : "Swapchain", {
+            .image = contextPtr->GetColorImage(),
+            .view = contextPtr->GetColorView(),
+            .format = contextPtr->GetColorFormat(),
+            .extent = extent,
+            .initialState = {
+                .stageMask = vk::PipelineStageFlagBits2::eColorAttachmentOutput
+            },
+            .finalLayout = headless ? vk::ImageLayout::eTransferSrcOptimal : vk::ImageLayout::ePresentSrcKHR
+        });
 
-        OnRender(commandBuffer);
-
-        TransitionImageLayout(
-            commandBuffer,
-            contextPtr->GetSwapchain()->GetImage(),
-            vk::ImageLayout::eColorAttachmentOptimal,
-            vk::ImageLayout::ePresentSrcKHR,
-            vk::AccessFlagBits::eColorAttachmentWrite,
-            {},
-            vk::PipelineStageFlagBits::eColorAttachmentOutput,
-            vk::PipelineStageFlagBits::eBottomOfPipe
-        );
+        // Shared by all frames in flight, the depth writes of the previous frame have to finish first
+        depthTarget = renderGraph->Import("Depth", {
+            .image = depthTexture->GetImage(),
+            .view = depthTexture->GetView(),
+            .format = depthTexture->GetFormat(),
+            .extent = extent,
+            .aspectMask = vk::ImageAspectFlagBits::eDepth,
+            .initialState = {
+                .stageMask = vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests,
+                .accessMask = vk::AccessFlagBits2::eDepthStencilAttachmentWrite
+            }
+        });
+
+        OnRender(*renderGraph);
+
+        renderGraph->Execute(commandBuffer);
     }
 
     void BaseApp::Update(double delta)
     {
         fpsCounter.Tick(delta);
+        simulationTime += delta;
 
-        OnUpdate(delta);
+        // The path starts once the warmup frames are done, live input is ignored. Counted in updates, the
+        // render thread may still be behind by a frame.
+        if (benchmark)
+        {
+            const uint64_t pathFrame = simulatedFrames > kBenchmarkWarmupFrames ? simulatedFrames - kBenchmarkWarmupFrames : 0;
+            glm::vec3 position, rotation;
+            benchmarkPath.Evaluate(static_cast<float>(pathFrame * windowPtr->GetConfig().fixedTimestep), position, rotation);
+            cameraPtr->keyState = {};
+            cameraPtr->SetPosition(position);
+            cameraPtr->SetRotation(rotation);
+        }
+        ++simulatedFrames;
 
+        {
+            AllocationScope allocationScope(EAllocationSubsystem::Update);
+            OnUpdate(delta);
+        }
+
+        AllocationScope allocationScope(EAllocationSubsystem::UI);
         imguiPtr->BeginFrame();
 
         if (showUI)
@@ -322,8 +1005,18 @@ namespace jgw
             
             OnGUI();
             ShowFPS();
+
+            if (showMemoryStats)
+                ShowMemoryStats();
+
+            if (showFramePacing)
+                ShowFramePacing();
+
+            if (showAllocations)
+                ShowAllocations();
         }
 
+        // Clearing keeps the capacity, the line buffers stop growing once the busiest frame has been seen
         canvas2D->Clear();
         canvas3D->Clear();
         OnGizmos();
@@ -335,6 +1028,7 @@ namespace jgw
     {
         OnCleanup();
 
+        renderGraph.reset();
         cameraPtr.reset();
         canvasGrid.reset();
         canvas3D.reset();
@@ -376,6 +1070,244 @@ namespace jgw
         ImGui::End();
     }
 
+    void BaseApp::ShowFramePacing()
+    {
+        ImGui::SetNextWindowSize(ImVec2(320, 0), ImGuiCond_FirstUseEver);
+        if (ImGui::Begin("Frame Pacing", &showFramePacing))
+        {
+            if (!uiStats.swapchain)
+            {
+                ImGui::TextDisabled("Headless, rendering into %u offscreen targets", uiStats.colorImageCount);
+                ImGui::End();
+                return;
+            }
+
+            const vk::PresentModeKHR currentMode = uiStats.presentMode;
+            if (ImGui::BeginCombo("Present mode", vk::to_string(currentMode).c_str()))
+            {
+                for (const auto mode : uiStats.presentModes)
+                {
+                    if (ImGui::Selectable(vk::to_string(mode).c_str(), mode == currentMode) && mode != currentMode)
+                        idleCommands.push_back([this, mode] { contextPtr->SetPresentMode(mode); });
+                }
+                ImGui::EndCombo();
+            }
+
+            int imageCount = static_cast<int>(uiStats.imageCount);
+            if (ImGui::SliderInt("Swapchain images", &imageCount, 2, 8))
+                idleCommands.push_back([this, imageCount] { contextPtr->SetSwapchainImageCount(static_cast<uint32_t>(imageCount)); });
+
+            int frameInFlight = static_cast<int>(uiStats.frameInFlight);
+            if (ImGui::SliderInt("Frames in flight", &frameInFlight, 1, static_cast<int>(VulkanContext::kMaxFrameInFlight)))
+                idleCommands.push_back([this, frameInFlight] { contextPtr->SetFrameInFlight(static_cast<uint32_t>(frameInFlight)); });
+
+            ImGui::Checkbox("Late latch camera", &lateLatch);
+
+            ImGui::Separator();
+
+            auto& config = contextPtr->GetFramePacingConfig();
+            ImGui::SliderFloat("Frame rate limit", &config.frameRateLimit, 0.0f, 360.0f, config.frameRateLimit > 0.0f ? "%.0f fps" : "Off");
+            ImGui::SliderFloat("Unfocused rate", &config.unfocusedFrameRate, 0.0f, 60.0f, config.unfocusedFrameRate > 0.0f ? "%.0f fps" : "Off");
+            ImGui::SliderFloat("Idle rate", &config.idleFrameRate, 0.0f, 60.0f, config.idleFrameRate > 0.0f ? "%.0f fps" : "Off");
+            if (config.frameRateLimit > 0.0f)
+                ImGui::Text("Limiter wait      : %.2f ms, spin %.2f ms", frameLimiter.GetWaitMs(), frameLimiter.GetSpinMarginMs());
+
+            ImGui::Separator();
+
+            const LatencyStats& latency = uiStats.latency;
+            if (uiStats.gpuFrameTimeMs >= 0.0f)
+                ImGui::Text("GPU frame         : %.2f ms", uiStats.gpuFrameTimeMs);
+            ImGui::Text("Input to submit   : %.2f ms", latency.inputToSubmitMs);
+            if (latency.presentWait)
+            {
+                ImGui::Text("Submit to present : %.2f ms", latency.submitToPresentMs);
+                ImGui::Text("Input to present  : %.2f ms", latency.inputToPresentMs);
+            }
+            else
+            {
+                ImGui::Text("Submit to present call : %.2f ms", latency.submitToPresentMs);
+                ImGui::Text("Input to present call  : %.2f ms", latency.inputToPresentMs);
+                ImGui::TextDisabled("Present wait not supported");
+            }
+        }
+        ImGui::End();
+    }
+
+    void BaseApp::ShowAllocations()
+    {
+        ImGui::SetNextWindowSize(ImVec2(420, 0), ImGuiCond_FirstUseEver);
+        if (ImGui::Begin("Heap Allocations", &showAllocations))
+        {
+            if (!AllocationTracker::IsAvailable())
+            {
+                ImGui::TextDisabled("Configure with ENGINE_TRACK_ALLOCATIONS=ON to count allocations");
+                ImGui::End();
+                return;
+            }
+
+            bool enabled = AllocationTracker::IsEnabled();
+            if (ImGui::Checkbox("Count allocations", &enabled))
+                AllocationTracker::SetEnabled(enabled);
+
+            ImGui::Text("Frames with allocations: %llu of %llu",
+                static_cast<unsigned long long>(AllocationTracker::GetAllocatingFrameCount()),
+                static_cast<unsigned long long>(AllocationTracker::GetFrameCount()));
+
+            const auto& last = AllocationTracker::GetLastFrame();
+            const auto& peak = AllocationTracker::GetPeakFrame();
+            if (ImGui::BeginTable("Allocations", 5, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV))
+            {
+                ImGui::TableSetupColumn("Subsystem");
+                ImGui::TableSetupColumn("Allocs");
+                ImGui::TableSetupColumn("Bytes");
+                ImGui::TableSetupColumn("Peak allocs");
+                ImGui::TableSetupColumn("Peak bytes");
+                ImGui::TableHeadersRow();
+
+                auto row = [](const char* name, const AllocationCounters& current, const AllocationCounters& worst) {
+                    ImGui::TableNextColumn(); ImGui::TextUnformatted(name);
+                    ImGui::TableNextColumn(); ImGui::Text("%llu", static_cast<unsigned long long>(current.allocations));
+                    ImGui::TableNextColumn(); ImGui::Text("%llu", static_cast<unsigned long long>(current.bytes));
+                    ImGui::TableNextColumn(); ImGui::Text("%llu", static_cast<unsigned long long>(worst.allocations));
+                    ImGui::TableNextColumn(); ImGui::Text("%llu", static_cast<unsigned long long>(worst.bytes));
+                };
+
+                for (size_t i = 0; i < last.subsystems.size(); ++i)
+                {
+                    row(ToString(static_cast<EAllocationSubsystem>(i)), last.subsystems[i], peak.subsystems[i]);
+                }
+                row("Total", last.total, peak.total);
+                ImGui::EndTable();
+            }
+
+            if (ImGui::Button("Dump JSON"))
+                AllocationTracker::DumpJson("../cache/allocation_stats.json");
+        }
+        ImGui::End();
+    }
+
+    void BaseApp::ShowMemoryStats()
+    {
+        constexpr float kMiB = 1024.0f * 1024.0f;
+
+        const auto& heaps = uiStats.heaps;
+
+        float deviceUsage = 0.0f;
+        for (const auto& heap : heaps)
+        {
+            if (heap.deviceLocal)
+                deviceUsage += heap.usage / kMiB;
+        }
+        memoryHistory[memoryHistoryOffset] = deviceUsage;
+        memoryHistoryOffset = (memoryHistoryOffset + 1) % kMemoryHistorySize;
+
+        ImGui::SetNextWindowSize(ImVec2(420, 0), ImGuiCond_FirstUseEver);
+        if (ImGui::Begin("GPU Memory", &showMemoryStats))
+        {
+            if (ImGui::CollapsingHeader("Heaps", ImGuiTreeNodeFlags_DefaultOpen))
+            {
+                for (const auto& heap : heaps)
+                {
+                    const float fraction = heap.budget > 0 ? static_cast<float>(heap.usage) / heap.budget : 0.0f;
+                    char overlay[64];
+                    snprintf(overlay, sizeof(overlay), "%.1f / %.1f MiB", heap.usage / kMiB, heap.budget / kMiB);
+                    ImGui::Text("Heap %u%s", heap.heapIndex, heap.deviceLocal ? " (device local)" : "");
+                    ImGui::ProgressBar(fraction, ImVec2(-1, 0), overlay);
+                    ImGui::Text("  blocks %u (%.1f MiB), allocations %u (%.1f MiB)",
+                        heap.blockCount, heap.blockBytes / kMiB, heap.allocationCount, heap.allocationBytes / kMiB);
+                }
+
+                if (ImPlot::BeginPlot("##DeviceUsage", ImVec2(-1, 120), ImPlotFlags_NoInputs | ImPlotFlags_NoLegend))
+                {
+                    ImPlot::SetupAxes(nullptr, "MiB", ImPlotAxisFlags_NoDecorations, ImPlotAxisFlags_AutoFit);
+                    ImPlot::PlotLine("Device", memoryHistory.data(), kMemoryHistorySize, 1.0, 0.0, ImPlotLineFlags_None, memoryHistoryOffset);
+                    ImPlot::EndPlot();
+                }
+            }
+
+            if (ImGui::CollapsingHeader("Categories", ImGuiTreeNodeFlags_DefaultOpen) &&
+                ImGui::BeginTable("##Categories", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_Borders))
+            {
+                ImGui::TableSetupColumn("Category");
+                ImGui::TableSetupColumn("Count");
+                ImGui::TableSetupColumn("MiB");
+                ImGui::TableHeadersRow();
+
+                for (uint32_t i = 0; i < static_cast<uint32_t>(EMemoryCategory::Count); ++i)
+                {
+                    const auto category = static_cast<EMemoryCategory>(i);
+                    const auto& stats = uiStats.categories[i];
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn(); ImGui::TextUnformatted(ToString(category));
+                    ImGui::TableNextColumn(); ImGui::Text("%u", stats.count);
+                    ImGui::TableNextColumn(); ImGui::Text("%.2f", stats.bytes / kMiB);
+                }
+                ImGui::EndTable();
+            }
+
+            if (ImGui::CollapsingHeader("Texture Pools"))
+            {
+                for (const auto& pool : uiStats.texturePools)
+                {
+                    char overlay[64];
+                    snprintf(overlay, sizeof(overlay), "%.1f / %.1f MiB", pool.allocationBytes / kMiB, pool.blockBytes / kMiB);
+                    ImGui::Text("%s: %u allocations in %u blocks", pool.name, pool.allocationCount, pool.blockCount);
+                    ImGui::ProgressBar(pool.Occupancy(), ImVec2(-1, 0), overlay);
+                }
+            }
+
+            if (ImGui::CollapsingHeader("Texture Streaming"))
+            {
+                const auto& stats = uiStats.streaming;
+                ImGui::Text("Textures: %u, pending: %u", stats.textures, stats.pendingTextures);
+                ImGui::Text("Resident: %.2f MiB of %.2f MiB", stats.residentBytes / kMiB, stats.fullBytes / kMiB);
+            }
+
+            if (ImGui::CollapsingHeader("Residency"))
+            {
+                const auto& stats = uiStats.residency;
+                ImGui::Text("Evicted textures: %u, buffers: %u", stats.evictedTextures, stats.evictedBuffers);
+                ImGui::Text("Host memory: %.2f MiB", stats.hostBytes / kMiB);
+
+                // The render thread reads the config while recording, edits are applied between frames
+                ResidencyConfig& config = uiStats.residencyConfig;
+                bool changed = ImGui::SliderFloat("High watermark", &config.highWatermark, 0.1f, 1.0f);
+                changed |= ImGui::SliderFloat("Low watermark", &config.lowWatermark, 0.1f, config.highWatermark);
+                if (changed)
+                    idleCommands.push_back([this, config] { contextPtr->GetResidencyManager()->Config() = config; });
+            }
+
+            if (ImGui::CollapsingHeader("Render Graph"))
+            {
+                const auto& stats = uiStats.renderGraph;
+                ImGui::Text("Passes: %u, culled: %u", stats.passes, stats.culledPasses);
+                ImGui::Text("Image barriers: %u in %u batches", stats.imageBarriers, stats.barrierBatches);
+                ImGui::Text("Transient images: %u in %u allocations", stats.transientImages, stats.transientAllocations);
+                ImGui::Text("Transient memory: %.2f MiB, %.2f MiB without aliasing", stats.transientBytes / kMiB, stats.unaliasedBytes / kMiB);
+            }
+
+            if (ImGui::CollapsingHeader("Pipelines"))
+            {
+                const auto& stats = uiStats.pipelines;
+                ImGui::Text("Pipelines: %u created, %u shared", stats.pipelinesCreated, stats.pipelinesShared);
+                ImGui::Text("Layouts: %u created, %u shared", stats.layoutsCreated, stats.layoutsShared);
+                ImGui::Text("Shader modules: %u created, %u shared", stats.shaderModulesCreated, stats.shaderModulesShared);
+            }
+
+            ImGui::Text("Pending destroys: %zu", uiStats.pendingDestroys);
+
+            if (ImGui::Button("Dump JSON"))
+                idleCommands.push_back([this] { contextPtr->DumpMemoryStats("../cache/memory_stats.json"); });
+
+            ImGui::SameLine();
+            ImGui::BeginDisabled(uiStats.defragmenting);
+            if (ImGui::Button("Defragment"))
+                idleCommands.push_back([this] { contextPtr->StartDefragmentation(); });
+            ImGui::EndDisabled();
+        }
+        ImGui::End();
+    }
+
     void BaseApp::SetCallback(GLFWwindow* handle)
     {
         glfwSetWindowUserPointer(handle, this);
@@ -383,6 +1315,7 @@ namespace jgw
         glfwSetKeyCallback(handle, [](GLFWwindow* window, int key, int scancode, int action, int mods) {
             BaseApp* app = static_cast<BaseApp*>(glfwGetWindowUserPointer(window));
             if (app) app->OnKey(key, scancode, action, mods);
+            if (app) app->lastInputTime = glfwGetTime();
 
             if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
                 glfwSetWindowShouldClose(window, GLFW_TRUE);
@@ -393,6 +1326,7 @@ namespace jgw
             if (app)
             {
                 app->OnMouse(button, action, mods);
+                app->lastInputTime = glfwGetTime();
             }
         });
 
@@ -401,6 +1335,7 @@ namespace jgw
             if (app)
             {
                 app->OnMouseScroll(xoffset, yoffset);
+                app->lastInputTime = glfwGetTime();
             }
         });
 
@@ -417,6 +1352,7 @@ namespace jgw
             {
                 app->Resize(width, height);
                 app->iconified = false;
+                app->lastInputTime = glfwGetTime();
             }
         });
 
@@ -425,6 +1361,7 @@ namespace jgw
             if (app)
             {
                 app->OnMouseMove(x, y);
+                app->lastInputTime = glfwGetTime();
             }
         });
 
@@ -432,5 +1369,11 @@ namespace jgw
             BaseApp* app = static_cast<BaseApp*>(glfwGetWindowUserPointer(window));
             app->iconified = iconified;
         });
+
+        glfwSetWindowFocusCallback(handle, [](GLFWwindow* window, int focused) {
+            BaseApp* app = static_cast<BaseApp*>(glfwGetWindowUserPointer(window));
+            app->focused = focused;
+            app->lastInputTime = glfwGetTime();
+        });
     }
 }
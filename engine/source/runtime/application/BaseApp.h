@@ -2,11 +2,16 @@
 
 #include "Window.h"
 #include "VulkanContext.h"
+#include "RenderGraph.h"
 #include "VulkanImgui.h"
 #include "Camera.h"
 #include "FpsCounter.h"
+#include "FrameLimiter.h"
+#include "JobQueue.h"
+#include "AllocationTracker.h"
 #include "LineCanvas.h"
 #include "GridCanvas.h"
+#include "Benchmark.h"
 
 #define IMGUI_IMPL_VULKAN_NO_PROTOTYPES
 #include "imgui.h"
@@ -17,6 +22,12 @@
 #include <assimp/postprocess.h>
 #include <assimp/cimport.h>
 
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 namespace jgw
 {
     class BaseApp
@@ -27,11 +38,17 @@ namespace jgw
         BaseApp(const WindowConfig& config = {});
 
         void Start();
+
+        // Size events are coalesced, the swapchain is recreated once per frame with the latest size
         void Resize(int width, int height);
 
     protected:
         virtual bool OnInit() { return true; }
-        virtual void OnRender(vk::CommandBuffer commandBuffer) {}
+        // Adds the passes of the frame, the graph is executed once this returns. With the render thread this
+        // runs concurrently with OnUpdate and OnGizmos of the next frame, so it may only read what OnSnapshot copied.
+        virtual void OnRender(RenderGraph& graph) {}
+        // Copies the state OnRender reads, called between frames while nothing is rendering
+        virtual void OnSnapshot() {}
         virtual void OnCleanup() {}
         virtual void OnGUI() {}
         virtual void OnGizmos() {};
@@ -42,6 +59,9 @@ namespace jgw
         virtual void OnMouseScroll(float x, float y);
         virtual void OnResize(int width, int height) {}
 
+        // Flythrough used by --benchmark when no --camera-path is given
+        virtual CameraPath GetBenchmarkPath() const { return {}; }
+
         virtual std::vector<const char*> GetInstanceLayers() const;
         virtual std::vector<const char*> GetInstanceExtensions() const;
         virtual std::vector<const char*> GetDeviceExtensions() const;
@@ -50,20 +70,24 @@ namespace jgw
 
         bool InitImgui(vk::Format depthFormat);
 
-        void TransitionImageLayout(
-            vk::CommandBuffer       commandBuffer,
-            vk::Image               image,
-            vk::ImageLayout         oldLayout,
-            vk::ImageLayout         newLayout,
-            vk::AccessFlags         srcAccessMask,
-            vk::AccessFlags         dstAccessMask,
-            vk::PipelineStageFlags  srcStage,
-            vk::PipelineStageFlags  dstStage
-        );
-
         std::unique_ptr<VulkanTexture> LoadTexture(const char* filename, bool mipmapped = false);
+
+        // Decodes all images on the job queue straight into one staging buffer and uploads them with a single submit.
+        // Entries of files that fail to load are nullptr.
+        std::vector<std::unique_ptr<VulkanTexture>> LoadTextures(const std::vector<std::string>& filenames, bool mipmapped = false);
         std::unique_ptr<VulkanTexture> LoadCubeTexture(const char* filename, vk::Format format);
 
+        // KTX1 or KTX2 file with its own mips, Basis Universal payloads are transcoded to a block format the device supports.
+        // The format is read from the file unless given.
+        std::unique_ptr<VulkanTexture> LoadKtxTexture(const char* filename, vk::Format format = vk::Format::eUndefined);
+
+        // Shared handles keyed by file content and load parameters, a file already loaded is not decoded or uploaded again
+        std::shared_ptr<VulkanTexture> AcquireTexture(const char* filename, bool mipmapped = false);
+        std::shared_ptr<VulkanTexture> AcquireKtxTexture(const char* filename, vk::Format format = vk::Format::eUndefined);
+
+        // Uploads the coarsest mips only, finer mips are streamed in when shaders request them
+        std::unique_ptr<VulkanTexture> LoadStreamingTexture(const char* filename);
+
         std::unique_ptr<Window> windowPtr;
         std::unique_ptr<VulkanContext> contextPtr;
         std::unique_ptr<VulkanImgui> imguiPtr;
@@ -71,27 +95,134 @@ namespace jgw
         std::unique_ptr<LineCanvas3D> canvas3D;
         std::unique_ptr<LineCanvas2D> canvas2D;
         std::unique_ptr<GridCanvas> canvasGrid;
+        std::unique_ptr<JobQueue> jobQueue;
+        std::unique_ptr<RenderGraph> renderGraph;
+
+        // Imported into the render graph every frame, the swapchain image is transitioned for present afterwards
+        RenderResource swapchainTarget = kInvalidRenderResource;
+        RenderResource depthTarget = kInvalidRenderResource;
 
         struct MouseState
         {
             glm::vec2 pos = glm::vec2(0.0f);
+
+            // Window coordinates of the last move, tells a sampled cursor position from one already handled
+            glm::vec2 cursor = glm::vec2(0.0f);
             bool pressedLeft = false;
             bool pressedRight = false;
+
+            // Time of the newest move event, GLFW has no event timestamps so it is taken at dispatch
+            double timestamp = 0.0;
         } mouseState;
 
         FpsCounter fpsCounter{};
 
     private:
         bool Initialize();
+        bool InitBenchmark();
         void Render();
         void Update(double delta);
+        void ApplyResize();
+        void PollEvents();
+        void LatchCamera(FrameConstants& constants);
+        void CaptureSnapshot(double frameStart, double inputTime);
+        void RenderFrame();
+        void FinishFrame();
+        void CaptureStats();
+        void PublishCamera();
+        void RenderThreadMain();
+        void KickRenderThread();
+        void WaitRenderThread();
+        void StopRenderThread();
         void Cleanup();
         void ShowFPS();
+        void ShowMemoryStats();
+        void ShowFramePacing();
+        void ShowAllocations();
         void SetCallback(GLFWwindow* handle);
 
+        std::shared_ptr<VulkanTexture> AcquireCachedTexture(const char* filename, uint64_t params, const std::function<std::unique_ptr<VulkanTexture>()>& load);
+
         int iconified = 0;
+        int focused = 1;
+        double lastInputTime = 0.0;
+        FrameLimiter frameLimiter;
+        uint32_t frameLimit = 0;
+        std::atomic<uint64_t> renderedFrames{ 0 };
+        uint64_t simulatedFrames = 0;
+        double simulationTime = 0.0;
+
+        // Everything Render reads that the main thread changes, captured while nothing is rendering
+        struct FrameSnapshot
+        {
+            FrameConstants constants{};
+            double frameStart = 0.0;
+            double inputTime = 0.0;
+            double mouseTime = 0.0;
+            bool lateLatch = true;
+        } snapshot;
+
+        // Pipelined rendering, the render thread records frame N while the main thread updates frame N+1
+        bool renderThreaded = false;
+        std::thread renderThread;
+        std::mutex renderMutex;
+        std::condition_variable renderCondition;
+        bool renderRequested = false;
+        bool renderStop = false;
+        double lastFrameEnd = 0.0;
+
+        // Newest camera of the main thread, the render thread cannot poll events for its late latch
+        struct PublishedCamera
+        {
+            glm::mat4 view = glm::mat4(1.0f);
+            glm::vec3 position = glm::vec3(0.0f);
+            double timestamp = 0.0;
+        } publishedCamera;
+        std::mutex cameraMutex;
+
+        // Context changes requested by the UI, applied between frames
+        std::vector<std::function<void()>> idleCommands;
+
+        // Render thread state shown by the debug windows, copied while nothing is rendering
+        struct UIStats
+        {
+            std::vector<MemoryHeapStats> heaps;
+            std::array<MemoryCategoryStats, static_cast<size_t>(EMemoryCategory::Count)> categories{};
+            std::vector<MemoryPoolStats> texturePools;
+            TextureStreamingStats streaming{};
+            ResidencyStats residency{};
+            ResidencyConfig residencyConfig{};
+            RenderGraphStats renderGraph{};
+            PipelineStats pipelines{};
+            size_t pendingDestroys = 0;
+            bool defragmenting = false;
+
+            LatencyStats latency{};
+            float gpuFrameTimeMs = -1.0f;
+            bool swapchain = false;
+            vk::PresentModeKHR presentMode = vk::PresentModeKHR::eFifo;
+            std::vector<vk::PresentModeKHR> presentModes;
+            uint32_t imageCount = 0;
+            uint32_t colorImageCount = 0;
+            uint32_t frameInFlight = 0;
+        } uiStats;
+
+        static constexpr uint32_t kBenchmarkWarmupFrames = 60;
+        std::unique_ptr<FrameBenchmark> benchmark;
+        CameraPath benchmarkPath;
+        bool resizePending = false;
+        int pendingWidth = 0;
+        int pendingHeight = 0;
         bool showUI = true;
+        bool showMemoryStats = false;
+        bool showFramePacing = false;
+        bool showAllocations = false;
+        bool lateLatch = true;
+
+        static constexpr int kMemoryHistorySize = 256;
+        std::array<float, kMemoryHistorySize> memoryHistory{};
+        int memoryHistoryOffset = 0;
 
-        
+        std::unordered_map<uint64_t, std::weak_ptr<VulkanTexture>> textureCache;
     };
 }
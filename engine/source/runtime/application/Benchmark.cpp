@@ -0,0 +1,234 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+namespace jgw
+{
+    namespace
+    {
+        struct Distribution
+        {
+            double min = 0.0;
+            double mean = 0.0;
+            double p50 = 0.0;
+            double p90 = 0.0;
+            double p95 = 0.0;
+            double p99 = 0.0;
+            double max = 0.0;
+        };
+
+        // Nearest rank percentiles over the sorted values
+        Distribution Summarize(std::vector<double> values)
+        {
+            Distribution result{};
+            if (values.empty())
+                return result;
+
+            std::sort(values.begin(), values.end());
+            auto percentile = [&values](double p) {
+                const size_t rank = static_cast<size_t>(std::ceil(p * values.size()));
+                return values[std::clamp<size_t>(rank, 1, values.size()) - 1];
+            };
+
+            double sum = 0.0;
+            for (double value : values)
+                sum += value;
+
+            result.min = values.front();
+            result.mean = sum / values.size();
+            result.p50 = percentile(0.50);
+            result.p90 = percentile(0.90);
+            result.p95 = percentile(0.95);
+            result.p99 = percentile(0.99);
+            result.max = values.back();
+            return result;
+        }
+
+        // Quotes a string as a JSON string literal, names come from the command line and the driver
+        void WriteString(std::ofstream& os, const std::string& value)
+        {
+            constexpr char kHex[] = "0123456789abcdef";
+
+            os << '"';
+            for (char c : value)
+            {
+                const auto byte = static_cast<unsigned char>(c);
+                if (c == '"' || c == '\\')
+                    os << '\\' << c;
+                else if (byte < 0x20)
+                    os << "\\u00" << kHex[byte >> 4] << kHex[byte & 0xf];
+                else
+                    os << c;
+            }
+            os << '"';
+        }
+
+        void WriteDistribution(std::ofstream& os, const char* name, const Distribution& d, bool last = false)
+        {
+            os << "    \"" << name << "\": { \"min\": " << d.min << ", \"mean\": " << d.mean
+               << ", \"p50\": " << d.p50 << ", \"p90\": " << d.p90 << ", \"p95\": " << d.p95
+               << ", \"p99\": " << d.p99 << ", \"max\": " << d.max << " }" << (last ? "\n" : ",\n");
+        }
+    }
+
+    void CameraPath::AddKeyframe(const CameraKeyframe& keyframe)
+    {
+        auto it = std::upper_bound(keyframes.begin(), keyframes.end(), keyframe.time, [](float time, const CameraKeyframe& k) {
+            return time < k.time;
+        });
+        keyframes.insert(it, keyframe);
+    }
+
+    void CameraPath::Evaluate(float time, glm::vec3& position, glm::vec3& rotation) const
+    {
+        if (keyframes.empty())
+            return;
+
+        if (time <= keyframes.front().time || keyframes.size() == 1)
+        {
+            position = keyframes.front().position;
+            rotation = keyframes.front().rotation;
+            return;
+        }
+        if (time >= keyframes.back().time)
+        {
+            position = keyframes.back().position;
+            rotation = keyframes.back().rotation;
+            return;
+        }
+
+        size_t i = 1;
+        while (keyframes[i].time < time)
+            ++i;
+
+        const CameraKeyframe& k1 = keyframes[i - 1];
+        const CameraKeyframe& k2 = keyframes[i];
+        const glm::vec3& p0 = keyframes[i > 1 ? i - 2 : i - 1].position;
+        const glm::vec3& p3 = keyframes[std::min(i + 1, keyframes.size() - 1)].position;
+
+        const float span = k2.time - k1.time;
+        const float t = span > 0.0f ? (time - k1.time) / span : 1.0f;
+        const float t2 = t * t;
+        const float t3 = t2 * t;
+
+        position = 0.5f * ((2.0f * k1.position) +
+            (-p0 + k2.position) * t +
+            (2.0f * p0 - 5.0f * k1.position + 4.0f * k2.position - p3) * t2 +
+            (-p0 + 3.0f * k1.position - 3.0f * k2.position + p3) * t3);
+        rotation = glm::mix(k1.rotation, k2.rotation, t);
+    }
+
+    bool CameraPath::Load(const char* filename)
+    {
+        std::ifstream is(filename);
+        if (!is.is_open())
+        {
+            spdlog::error("Could not open camera path {}", filename);
+            return false;
+        }
+
+        keyframes.clear();
+        std::string line;
+        while (std::getline(is, line))
+        {
+            if (line.empty() || line[0] == '#')
+                continue;
+
+            std::istringstream ls(line);
+            CameraKeyframe keyframe{};
+            if (!(ls >> keyframe.time >> keyframe.position.x >> keyframe.position.y >> keyframe.position.z
+                     >> keyframe.rotation.x >> keyframe.rotation.y >> keyframe.rotation.z))
+            {
+                spdlog::error("Malformed keyframe in {}: {}", filename, line);
+                keyframes.clear();
+                return false;
+            }
+            AddKeyframe(keyframe);
+        }
+
+        return !keyframes.empty();
+    }
+
+    bool CameraPath::Save(const char* filename) const
+    {
+        std::ofstream os(filename);
+        if (!os.is_open())
+        {
+            spdlog::error("Could not open camera path {}", filename);
+            return false;
+        }
+
+        os << "# time px py pz rx ry rz\n";
+        for (const auto& k : keyframes)
+        {
+            os << k.time << ' ' << k.position.x << ' ' << k.position.y << ' ' << k.position.z << ' '
+               << k.rotation.x << ' ' << k.rotation.y << ' ' << k.rotation.z << '\n';
+        }
+        return true;
+    }
+
+    FrameBenchmark::FrameBenchmark(uint32_t warmupFrames, uint32_t measuredFrames)
+        : warmupFrames(warmupFrames)
+        , measuredFrames(measuredFrames)
+    {
+        // Sized up front so the measured frames do not allocate
+        samples.reserve(measuredFrames);
+    }
+
+    void FrameBenchmark::AddFrame(const BenchmarkSample& sample)
+    {
+        if (skippedFrames < warmupFrames)
+        {
+            ++skippedFrames;
+            return;
+        }
+
+        if (!IsComplete())
+            samples.push_back(sample);
+    }
+
+    bool FrameBenchmark::WriteJson(const char* filename, const BenchmarkInfo& info) const
+    {
+        std::ofstream os(filename);
+        if (!os.is_open())
+        {
+            spdlog::error("Could not open benchmark file {}", filename);
+            return false;
+        }
+
+        std::vector<double> cpu, gpu, draws, triangles;
+        for (const auto& sample : samples)
+        {
+            cpu.push_back(sample.cpuFrameMs);
+            if (sample.gpuFrameMs >= 0.0f)
+                gpu.push_back(sample.gpuFrameMs);
+            draws.push_back(sample.draws);
+            triangles.push_back(static_cast<double>(sample.triangles));
+        }
+
+        os << "{\n  \"name\": ";
+        WriteString(os, info.name);
+        os << ",\n  \"device\": ";
+        WriteString(os, info.device);
+        os << ",\n"
+           << "  \"width\": " << info.extent.width << ",\n"
+           << "  \"height\": " << info.extent.height << ",\n"
+           << "  \"headless\": " << (info.headless ? "true" : "false") << ",\n"
+           << "  \"timestep\": " << info.timestep << ",\n"
+           << "  \"warmupFrames\": " << warmupFrames << ",\n"
+           << "  \"frames\": " << samples.size() << ",\n"
+           << "  \"gpuTimestamps\": " << (gpu.empty() ? "false" : "true") << ",\n"
+           << "  \"stats\": {\n";
+        WriteDistribution(os, "cpuFrameMs", Summarize(std::move(cpu)));
+        WriteDistribution(os, "gpuFrameMs", Summarize(std::move(gpu)));
+        WriteDistribution(os, "draws", Summarize(std::move(draws)));
+        WriteDistribution(os, "triangles", Summarize(std::move(triangles)), true);
+        os << "  }\n}\n";
+
+        spdlog::info("Benchmark results written to {}", filename);
+        return true;
+    }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "Common.h"
+
+#include <string>
+
+namespace jgw
+{
+    // Camera pose at a point in time, rotation in degrees as used by Camera::SetRotation
+    struct CameraKeyframe
+    {
+        float time = 0.0f;
+        glm::vec3 position{};
+        glm::vec3 rotation{};
+    };
+
+    // Keyframed camera flythrough. Positions follow a Catmull-Rom spline through the keyframes,
+    // rotations are interpolated linearly.
+    class CameraPath final
+    {
+    public:
+        void AddKeyframe(const CameraKeyframe& keyframe);
+        void Clear() { keyframes.clear(); }
+
+        bool IsEmpty() const { return keyframes.empty(); }
+        float GetDuration() const { return keyframes.empty() ? 0.0f : keyframes.back().time; }
+
+        void Evaluate(float time, glm::vec3& position, glm::vec3& rotation) const;
+
+        // One keyframe per line as "time px py pz rx ry rz", lines starting with # are comments
+        bool Load(const char* filename);
+        bool Save(const char* filename) const;
+
+    private:
+        std::vector<CameraKeyframe> keyframes;
+    };
+
+    struct BenchmarkSample
+    {
+        float cpuFrameMs = 0.0f;
+
+        // Negative when the device has no timestamps
+        float gpuFrameMs = -1.0f;
+
+        uint32_t draws = 0;
+        uint64_t triangles = 0;
+    };
+
+    // Written next to the statistics so runs can be told apart
+    struct BenchmarkInfo
+    {
+        std::string name;
+        std::string device;
+        vk::Extent2D extent{};
+        double timestep = 0.0;
+        bool headless = false;
+    };
+
+    // Collects per frame samples after a warmup and writes min, mean, max and percentiles of each as JSON
+    class FrameBenchmark final
+    {
+    public:
+        CLASS_COPY_MOVE_DELETE(FrameBenchmark)
+
+        FrameBenchmark(uint32_t warmupFrames, uint32_t measuredFrames);
+
+        void AddFrame(const BenchmarkSample& sample);
+        bool IsComplete() const { return samples.size() >= measuredFrames; }
+        uint32_t GetFrameCount() const { return warmupFrames + measuredFrames; }
+
+        bool WriteJson(const char* filename, const BenchmarkInfo& info) const;
+
+    private:
+        uint32_t warmupFrames;
+        uint32_t measuredFrames;
+        uint32_t skippedFrames = 0;
+        std::vector<BenchmarkSample> samples;
+    };
+}
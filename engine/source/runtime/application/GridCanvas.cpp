@@ -24,19 +24,12 @@ namespace jgw
 
     void GridCanvas::Render(VulkanContext& context)
     {
+        pushConstantData.frame = context.GetFrameConstantsAddress();
+
         auto commandBuffer = context.GetCommandBuffer();
         commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, gridPipeline->Handle());
         commandBuffer.pushConstants(gridPipeline->Layout(), vk::ShaderStageFlagBits::eVertex, 0, sizeof(PushConstantData), &pushConstantData);
         commandBuffer.draw(6, 1, 0, 0);
     }
 
-    void GridCanvas::SetMatrix(glm::mat4 m)
-    {
-        pushConstantData.mvp = m;
-    }
-
-    void GridCanvas::SetCameraPos(glm::vec4 pos)
-    {
-        pushConstantData.cameraPos = pos;
-    }
 }
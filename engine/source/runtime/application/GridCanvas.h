@@ -13,18 +13,15 @@ namespace jgw
         GridCanvas() = default;
 
         bool Initialize(VulkanContext& context);
+        // Follows the camera of the frame constants
         void Render(VulkanContext& context);
 
-        void SetMatrix(glm::mat4 m);
-        void SetCameraPos(glm::vec4 pos);
-
     private:
         struct PushConstantData
         {
-            glm::mat4 mvp;
-            glm::vec4 cameraPos;
+            vk::DeviceAddress frame;
         } pushConstantData;
 
-        std::unique_ptr<VulkanPipeline> gridPipeline;
+        std::shared_ptr<VulkanPipeline> gridPipeline;
     };
 }
@@ -12,13 +12,22 @@ namespace jgw
     LinearGraph::LinearGraph(const char* name, size_t maxGraphPoints)
         : name(name)
         , maxPoints(maxGraphPoints)
+        , graph(maxGraphPoints)
+        , dataX(maxGraphPoints)
+        , dataY(maxGraphPoints)
     { }
 
     void LinearGraph::AddPoint(float value)
     {
-        graph.push_back(value);
-        if (graph.size() > maxPoints)
-            graph.erase(graph.begin());
+        if (graphCount < maxPoints)
+        {
+            graph[(graphBegin + graphCount++) % maxPoints] = value;
+        }
+        else
+        {
+            graph[graphBegin] = value;
+            graphBegin = (graphBegin + 1) % maxPoints;
+        }
     }
 
     void LinearGraph::Render(uint32_t x, uint32_t y, uint32_t width, uint32_t height, const glm::vec4 color)
@@ -26,8 +35,9 @@ namespace jgw
         float minVal = std::numeric_limits<float>::max();
         float maxVal = std::numeric_limits<float>::min();
 
-        for (float f : graph)
+        for (size_t i = 0; i < graphCount; ++i)
         {
+            const float f = graph[(graphBegin + i) % maxPoints];
             if (f < minVal) minVal = f;
             if (f > maxVal) maxVal = f;
         }
@@ -35,17 +45,13 @@ namespace jgw
         const float range = maxVal - minVal;
         float valX = 0.0;
 
-        std::vector<float> dataX;
-        std::vector<float> dataY;
-        dataX.reserve(graph.size());
-        dataY.reserve(graph.size());
-
-        for (float f : graph)
+        for (size_t i = 0; i < graphCount; ++i)
         {
+            const float f = graph[(graphBegin + i) % maxPoints];
             const float valY = (f - minVal) / range;
             valX += 1.0f / maxPoints;
-            dataX.push_back(valX);
-            dataY.push_back(valY);
+            dataX[i] = valX;
+            dataY[i] = valY;
         }
 
         ImGui::SetNextWindowPos(ImVec2(x, y));
@@ -65,7 +71,7 @@ namespace jgw
             ImPlot::SetupAxes(nullptr, nullptr, ImPlotAxisFlags_NoDecorations, ImPlotAxisFlags_NoDecorations);
             ImPlot::PushStyleColor(ImPlotCol_Line, ImVec4(color.r, color.g, color.b, color.a));
             ImPlot::PushStyleColor(ImPlotCol_PlotBg, ImVec4(0, 0, 0, 0));
-            ImPlot::PlotLine("#line", dataX.data(), dataY.data(), (int)graph.size(), ImPlotLineFlags_None);
+            ImPlot::PlotLine("#line", dataX.data(), dataY.data(), (int)graphCount, ImPlotLineFlags_None);
             ImPlot::PopStyleColor(2);
             ImPlot::EndPlot();
         }
@@ -133,37 +139,27 @@ namespace jgw
 
     void LineCanvas3D::Render(VulkanContext& context)
     {
-        if (lines.empty())
+        if (renderLines.empty())
             return;
 
-        vk::DeviceSize requiredSize = lines.size() * sizeof(LineData);
-        if (!lineBuffer || lineBuffer->TotalSize() < requiredSize)
-        {
-            lineBuffer = context.CreateBuffer(
-                requiredSize,
-                vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress,
-                vma::AllocationCreateFlagBits::eMapped | vma::AllocationCreateFlagBits::eHostAccessSequentialWrite
-            );
-
-            vk::BufferDeviceAddressInfo addrInfo{
-                .buffer = lineBuffer->Handle()
-            };
-            pushConstantData.addr = context.GetDevice().getBufferAddress(addrInfo);
-
-            lineBuffer->Map();
-        }
+        // Transient memory of the current frame, never overwritten while the GPU may read it
+        FrameAllocation lineData = context.GetFrameAllocator()->Allocate(renderLines.size() * sizeof(LineData));
+        if (!lineData)
+            return;
 
-        lineBuffer->CopyFromHost(lines.data(), requiredSize);
+        memcpy(lineData.data, renderLines.data(), lineData.size);
+        pushConstantData.frame = context.GetFrameConstantsAddress();
+        pushConstantData.addr = lineData.address;
 
         auto commandBuffer = context.GetCommandBuffer();
         commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, linePipeline->Handle());
         commandBuffer.pushConstants(linePipeline->Layout(), vk::ShaderStageFlagBits::eVertex, 0, sizeof(PushConstantData), &pushConstantData);
-        commandBuffer.draw(lines.size(), 1, 0, 0);
+        commandBuffer.draw(renderLines.size(), 1, 0, 0);
     }
 
     void LineCanvas3D::SetMatrix(glm::mat4 m)
     {
-        pushConstantData.mvp = m;
+        matrix = m;
     }
 
     void LineCanvas3D::Clear()
@@ -171,6 +167,12 @@ namespace jgw
         lines.clear();
     }
 
+    void LineCanvas3D::Snapshot()
+    {
+        std::swap(lines, renderLines);
+        pushConstantData.model = matrix;
+    }
+
     void LineCanvas3D::Line(const glm::vec3 p1, const glm::vec3 p2, const glm::vec4 c)
     {
         lines.push_back({ .pos = glm::vec4(p1, 1.0f), .color = c });
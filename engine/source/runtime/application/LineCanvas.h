@@ -3,8 +3,6 @@
 #include "Common.h"
 #include "VulkanContext.h"
 
-#include <deque>
-
 namespace jgw
 {
     class LinearGraph
@@ -20,7 +18,13 @@ namespace jgw
     private:
         const char* name;
         const size_t maxPoints;
-        std::deque<float> graph;
+
+        // Ring of the last maxPoints values and the plot coordinates, sized once so rendering never allocates
+        std::vector<float> graph;
+        size_t graphBegin = 0;
+        size_t graphCount = 0;
+        std::vector<float> dataX;
+        std::vector<float> dataY;
     };
 
     class LineCanvas2D
@@ -53,8 +57,13 @@ namespace jgw
         bool Initialize(VulkanContext& context);
         void Render(VulkanContext& context);
 
+        // Model matrix of the lines, the camera comes from the frame constants
         void SetMatrix(glm::mat4 m);
         void Clear();
+
+        // Hands the lines and model matrix drawn so far to Render, the next frame may be drawn meanwhile
+        void Snapshot();
+
         void Line(const glm::vec3 p1, const glm::vec3 p2, const glm::vec4 c);
         void Plane(const glm::vec3 o, const glm::vec3 v1, const glm::vec3 v2, int n1, int n2, float s1, float s2, const glm::vec4 color, const glm::vec4 outlineColor);
         void Box(const glm::mat4 m, const glm::vec3 size, const glm::vec4 c);
@@ -69,12 +78,15 @@ namespace jgw
 
         struct PushConstantData
         {
-            glm::mat4 mvp;
+            glm::mat4 model;
+            vk::DeviceAddress frame;
             vk::DeviceAddress addr;
         } pushConstantData;
 
+        // Swapped on Snapshot, both keep their capacity
         std::vector<LineData> lines;
-        std::unique_ptr<VulkanBuffer> lineBuffer;
-        std::unique_ptr<VulkanPipeline> linePipeline;
+        std::vector<LineData> renderLines;
+        glm::mat4 matrix = glm::mat4(1.0f);
+        std::shared_ptr<VulkanPipeline> linePipeline;
     };
 }
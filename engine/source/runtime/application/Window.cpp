@@ -1,5 +1,9 @@
 #include "Window.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <string_view>
+
 namespace jgw
 {
     Window::Window(const WindowConfig& config) :
@@ -12,13 +16,52 @@ namespace jgw
         Destroy();
     }
 
+    void ParseCommandLine(int argc, char** argv, WindowConfig& config)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string_view arg = argv[i];
+            if (arg == "--headless")
+                config.headless = true;
+            else if (arg == "--frames" && i + 1 < argc)
+                config.frameCount = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+            else if (arg == "--device" && i + 1 < argc)
+                config.device = argv[++i];
+            else if (arg == "--benchmark")
+                config.benchmark = true;
+            else if (arg == "--camera-path" && i + 1 < argc)
+                config.cameraPath = argv[++i];
+            else if (arg == "--benchmark-output" && i + 1 < argc)
+                config.benchmarkOutput = argv[++i];
+            else if (arg == "--timestep" && i + 1 < argc)
+                config.fixedTimestep = std::max(std::strtod(argv[++i], nullptr), 1e-4);
+            else if (arg == "--render-thread")
+                config.renderThread = true;
+            else if (arg == "--fps" && i + 1 < argc)
+                config.frameRateLimit = std::max(std::strtof(argv[++i], nullptr), 0.0f);
+            else
+                spdlog::warn("Unknown command line argument {}", arg);
+        }
+    }
+
     bool Window::Initialize()
     {
+        // The null platform needs no display server, its windows still deliver sizes, time and input state
+        if (windowConfig.headless)
+            glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+
         if (!glfwInit())
             return false;
 
         glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
 
+        if (windowConfig.headless)
+        {
+            glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+            handle = glfwCreateWindow(windowConfig.width, windowConfig.height, windowConfig.title.c_str(), nullptr, nullptr);
+            return handle != nullptr;
+        }
+
         GLFWmonitor* monitor = glfwGetPrimaryMonitor();
         const GLFWvidmode* mode = glfwGetVideoMode(monitor);
 
@@ -17,8 +17,34 @@ namespace jgw
         int width = 1280;
         int height = 800;
         EWindowMode mode = EWindowMode::Windowed;
+
+        // Renders offscreen on the GLFW null platform, for hosts without a display, see VulkanContext::SetHeadless
+        bool headless = false;
+
+        // Frames rendered before the app quits on its own, 0 runs until the window is closed
+        uint32_t frameCount = 0;
+
+        // Part of the name of the physical device to prefer, CPU devices are only accepted headless or with this set
+        std::string device = "";
+
+        // Flies the camera along a keyframed path with a fixed timestep and writes frame statistics as JSON.
+        // An empty camera path uses the one of the app, frameCount 0 flies the path once.
+        bool benchmark = false;
+        std::string cameraPath = "";
+        std::string benchmarkOutput = "../cache/benchmark.json";
+        double fixedTimestep = 1.0 / 60.0;
+
+        // Records and submits on a separate thread while the main thread updates the next frame
+        bool renderThread = false;
+
+        // Caps the frame rate, 0 leaves it to the present mode, see FramePacingConfig::frameRateLimit
+        float frameRateLimit = 0.0f;
     };
 
+    // Overrides the config with --headless, --frames <count>, --device <name>, --benchmark,
+    // --camera-path <file>, --benchmark-output <file>, --timestep <seconds>, --render-thread and --fps <rate>
+    void ParseCommandLine(int argc, char** argv, WindowConfig& config);
+
     class Window final
     {
     public:
@@ -28,6 +54,8 @@ namespace jgw
         ~Window();
 
         GLFWwindow* GetHandle() const { return handle; }
+        const WindowConfig& GetConfig() const { return windowConfig; }
+        bool IsHeadless() const { return windowConfig.headless; }
 
         bool Initialize();
         void Destroy();
@@ -1,4 +1,7 @@
 #include "VulkanMesh.h"
+#include "JobQueue.h"
+
+#include <algorithm>
 
 namespace jgw
 {
@@ -71,7 +74,46 @@ namespace jgw
         CreatePipeline(context, header, meshData);
     }
 
-    void VulkanMesh::Draw(vk::CommandBuffer commandBuffer)
+    void VulkanMesh::Draw(VulkanContext& context, vk::CommandBuffer commandBuffer)
+    {
+        context.MarkUsed(vertexBuffer.get());
+        context.MarkUsed(indexBuffer.get());
+        context.MarkUsed(indirectBuffer.get());
+
+        pcData.frame = context.GetFrameConstantsAddress();
+        Bind(commandBuffer);
+        commandBuffer.drawIndexedIndirect(indirectBuffer->Handle(), sizeof(uint32_t), header.meshCount, sizeof(DrawIndexedIndirectCommand));
+        context.AddDrawStats(header.meshCount, numIndices / 3);
+    }
+
+    void VulkanMesh::DrawParallel(VulkanContext& context, JobQueue& jobQueue, const vk::Viewport& viewport, const vk::Rect2D& scissor)
+    {
+        context.MarkUsed(vertexBuffer.get());
+        context.MarkUsed(indexBuffer.get());
+        context.MarkUsed(indirectBuffer.get());
+
+        pcData.frame = context.GetFrameConstantsAddress();
+        const uint32_t taskCount = std::clamp((header.meshCount + kMinDrawsPerTask - 1) / kMinDrawsPerTask, 1u, jobQueue.ThreadCount());
+        const uint32_t drawsPerTask = (header.meshCount + taskCount - 1) / taskCount;
+
+        context.RecordParallel(jobQueue, taskCount, [&](vk::CommandBuffer commandBuffer, uint32_t task) {
+            const uint32_t firstDraw = task * drawsPerTask;
+            const uint32_t drawCount = std::min(drawsPerTask, header.meshCount - firstDraw);
+
+            commandBuffer.setViewport(0, 1, &viewport);
+            commandBuffer.setScissor(0, 1, &scissor);
+            Bind(commandBuffer);
+            commandBuffer.drawIndexedIndirect(
+                indirectBuffer->Handle(),
+                sizeof(uint32_t) + firstDraw * sizeof(DrawIndexedIndirectCommand),
+                drawCount,
+                sizeof(DrawIndexedIndirectCommand)
+            );
+        });
+        context.AddDrawStats(header.meshCount, numIndices / 3);
+    }
+
+    void VulkanMesh::Bind(vk::CommandBuffer commandBuffer) const
     {
         commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline->Handle());
 
@@ -80,7 +122,6 @@ namespace jgw
         commandBuffer.bindIndexBuffer(indexBuffer->Handle(), 0, vk::IndexType::eUint32);
         commandBuffer.bindVertexBuffers(0, 1, vertexBuffers, offsets);
         commandBuffer.pushConstants(pipeline->Layout(), vk::ShaderStageFlagBits::eVertex, 0, sizeof(PushConstantData), &pcData);
-        commandBuffer.drawIndexedIndirect(indirectBuffer->Handle(), sizeof(uint32_t), header.meshCount, sizeof(DrawIndexedIndirectCommand));
     }
 
     void VulkanMesh::CreatePipeline(VulkanContext& context, const MeshFileHeader& header, const MeshData& meshData)
@@ -12,10 +12,18 @@ namespace jgw
 
         VulkanMesh(VulkanContext& context, const MeshFileHeader& header, const MeshData& meshData);
 
-        inline void SetMVP(glm::mat4 m) { pcData.mvp = m; }
-        void Draw(vk::CommandBuffer commandBuffer);
+        // The camera is read from the frame constants, so it may still be latched after recording
+        inline void SetModel(glm::mat4 m) { pcData.model = m; }
+        void Draw(VulkanContext& context, vk::CommandBuffer commandBuffer);
+
+        // Splits the indirect draws into ranges recorded on the job queue, see VulkanContext::RecordParallel
+        void DrawParallel(VulkanContext& context, JobQueue& jobQueue, const vk::Viewport& viewport, const vk::Rect2D& scissor);
 
     private:
+        // Fewer draws than this per task cost more in recording overhead than they save
+        static constexpr uint32_t kMinDrawsPerTask = 64;
+
+        void Bind(vk::CommandBuffer commandBuffer) const;
         void CreatePipeline(VulkanContext& context, const MeshFileHeader& header, const MeshData& meshData);
 
         struct DrawIndexedIndirectCommand
@@ -29,7 +37,8 @@ namespace jgw
 
         struct PushConstantData
         {
-            glm::mat4 mvp;
+            glm::mat4 model = glm::mat4(1.0f);
+            vk::DeviceAddress frame = 0;
         } pcData;
 
         uint32_t numIndices;
@@ -38,6 +47,6 @@ namespace jgw
         std::unique_ptr<VulkanBuffer> vertexBuffer;
         std::unique_ptr<VulkanBuffer> indexBuffer;
         std::unique_ptr<VulkanBuffer> indirectBuffer;
-        std::unique_ptr<VulkanPipeline> pipeline;
+        std::shared_ptr<VulkanPipeline> pipeline;
     };
 }
\ No newline at end of file
@@ -0,0 +1,326 @@
+#include "AllocationTracker.h"
+
+#include <spdlog/spdlog.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
+
+namespace jgw
+{
+    namespace
+    {
+        struct Counters
+        {
+            std::atomic<uint64_t> allocations{ 0 };
+            std::atomic<uint64_t> bytes{ 0 };
+            std::atomic<uint64_t> frees{ 0 };
+        };
+
+        // Constant initialized, the allocator may be entered before any dynamic initialization has run
+        constinit std::array<Counters, AllocationFrameStats::kSubsystemCount> counters{};
+#ifdef JGW_TRACK_ALLOCATIONS
+        constinit std::atomic<bool> enabled{ true };
+#else
+        constinit std::atomic<bool> enabled{ false };
+#endif
+        constinit thread_local EAllocationSubsystem currentSubsystem = EAllocationSubsystem::Other;
+
+        AllocationFrameStats lastFrame{};
+        AllocationFrameStats peakFrame{};
+        uint64_t frameCount = 0;
+        uint64_t allocatingFrameCount = 0;
+
+        [[maybe_unused]] void CountAllocation(std::size_t size)
+        {
+            if (!enabled.load(std::memory_order_relaxed))
+                return;
+
+            auto& subsystem = counters[static_cast<size_t>(currentSubsystem)];
+            subsystem.allocations.fetch_add(1, std::memory_order_relaxed);
+            subsystem.bytes.fetch_add(size, std::memory_order_relaxed);
+        }
+
+        [[maybe_unused]] void CountFree(void* pointer)
+        {
+            if (pointer == nullptr || !enabled.load(std::memory_order_relaxed))
+                return;
+
+            counters[static_cast<size_t>(currentSubsystem)].frees.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    const char* ToString(EAllocationSubsystem subsystem)
+    {
+        switch (subsystem)
+        {
+        case EAllocationSubsystem::Other: return "Other";
+        case EAllocationSubsystem::Update: return "Update";
+        case EAllocationSubsystem::UI: return "UI";
+        case EAllocationSubsystem::Render: return "Render";
+        case EAllocationSubsystem::Submit: return "Submit";
+        case EAllocationSubsystem::Streaming: return "Streaming";
+        case EAllocationSubsystem::Jobs: return "Jobs";
+        default: return "Unknown";
+        }
+    }
+
+    bool AllocationTracker::IsAvailable()
+    {
+#ifdef JGW_TRACK_ALLOCATIONS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void AllocationTracker::SetEnabled(bool enable)
+    {
+        enabled.store(enable && IsAvailable(), std::memory_order_relaxed);
+    }
+
+    bool AllocationTracker::IsEnabled()
+    {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    void AllocationTracker::EndFrame()
+    {
+        if (!IsEnabled())
+            return;
+
+        AllocationFrameStats frame{};
+        for (size_t i = 0; i < counters.size(); ++i)
+        {
+            auto& subsystem = frame.subsystems[i];
+            subsystem.allocations = counters[i].allocations.exchange(0, std::memory_order_relaxed);
+            subsystem.bytes = counters[i].bytes.exchange(0, std::memory_order_relaxed);
+            subsystem.frees = counters[i].frees.exchange(0, std::memory_order_relaxed);
+
+            frame.total.allocations += subsystem.allocations;
+            frame.total.bytes += subsystem.bytes;
+            frame.total.frees += subsystem.frees;
+        }
+
+        lastFrame = frame;
+        if (frame.total.allocations > peakFrame.total.allocations)
+            peakFrame = frame;
+
+        ++frameCount;
+        if (frame.total.allocations > 0)
+            ++allocatingFrameCount;
+    }
+
+    const AllocationFrameStats& AllocationTracker::GetLastFrame()
+    {
+        return lastFrame;
+    }
+
+    const AllocationFrameStats& AllocationTracker::GetPeakFrame()
+    {
+        return peakFrame;
+    }
+
+    uint64_t AllocationTracker::GetFrameCount()
+    {
+        return frameCount;
+    }
+
+    uint64_t AllocationTracker::GetAllocatingFrameCount()
+    {
+        return allocatingFrameCount;
+    }
+
+    bool AllocationTracker::DumpJson(const char* filename)
+    {
+        std::ofstream os(filename);
+        if (!os.is_open())
+        {
+            spdlog::error("Could not open allocation stats file {}", filename);
+            return false;
+        }
+
+        auto writeFrame = [&os](const AllocationFrameStats& frame) {
+            os << "{\n    \"total\": { \"allocations\": " << frame.total.allocations
+               << ", \"bytes\": " << frame.total.bytes
+               << ", \"frees\": " << frame.total.frees << " },\n    \"subsystems\": {";
+            for (size_t i = 0; i < frame.subsystems.size(); ++i)
+            {
+                const auto& subsystem = frame.subsystems[i];
+                os << (i ? "," : "") << "\n      \"" << ToString(static_cast<EAllocationSubsystem>(i)) << "\": { \"allocations\": " << subsystem.allocations
+                   << ", \"bytes\": " << subsystem.bytes
+                   << ", \"frees\": " << subsystem.frees << " }";
+            }
+            os << "\n    }\n  }";
+        };
+
+        os << "{\n  \"frames\": " << frameCount
+           << ",\n  \"allocatingFrames\": " << allocatingFrameCount
+           << ",\n  \"lastFrame\": ";
+        writeFrame(lastFrame);
+        os << ",\n  \"peakFrame\": ";
+        writeFrame(peakFrame);
+        os << "\n}\n";
+
+        spdlog::info("Allocation stats written to {}", filename);
+        return true;
+    }
+
+    AllocationScope::AllocationScope(EAllocationSubsystem subsystem)
+        : previous(currentSubsystem)
+    {
+        currentSubsystem = subsystem;
+    }
+
+    AllocationScope::~AllocationScope()
+    {
+        currentSubsystem = previous;
+    }
+
+    void AllocationScope::SetThreadSubsystem(EAllocationSubsystem subsystem)
+    {
+        currentSubsystem = subsystem;
+    }
+}
+
+#ifdef JGW_TRACK_ALLOCATIONS
+
+namespace
+{
+    void* AlignedAlloc(std::size_t size, std::size_t alignment)
+    {
+#ifdef _MSC_VER
+        return _aligned_malloc(size ? size : 1, alignment);
+#else
+        // aligned_alloc wants a multiple of the alignment
+        const std::size_t rounded = ((size ? size : 1) + alignment - 1) / alignment * alignment;
+        return std::aligned_alloc(alignment, rounded);
+#endif
+    }
+
+    void AlignedFree(void* pointer)
+    {
+#ifdef _MSC_VER
+        _aligned_free(pointer);
+#else
+        std::free(pointer);
+#endif
+    }
+}
+
+void* operator new(std::size_t size)
+{
+    jgw::CountAllocation(size);
+    if (void* pointer = std::malloc(size ? size : 1))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    jgw::CountAllocation(size);
+    return std::malloc(size ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    jgw::CountAllocation(size);
+    if (void* pointer = AlignedAlloc(size, static_cast<std::size_t>(alignment)))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    jgw::CountAllocation(size);
+    return AlignedAlloc(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t& tag) noexcept
+{
+    return operator new(size, alignment, tag);
+}
+
+void operator delete(void* pointer) noexcept
+{
+    jgw::CountFree(pointer);
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+    operator delete(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+    operator delete(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept
+{
+    operator delete(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept
+{
+    operator delete(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept
+{
+    operator delete(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept
+{
+    jgw::CountFree(pointer);
+    AlignedFree(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t alignment) noexcept
+{
+    operator delete(pointer, alignment);
+}
+
+void operator delete(void* pointer, std::size_t, std::align_val_t alignment) noexcept
+{
+    operator delete(pointer, alignment);
+}
+
+void operator delete[](void* pointer, std::size_t, std::align_val_t alignment) noexcept
+{
+    operator delete(pointer, alignment);
+}
+
+void operator delete(void* pointer, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    operator delete(pointer, alignment);
+}
+
+void operator delete[](void* pointer, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    operator delete(pointer, alignment);
+}
+
+#endif
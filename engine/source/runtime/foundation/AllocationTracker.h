@@ -0,0 +1,80 @@
+#pragma once
+
+#include "Macro.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace jgw
+{
+    // Part of the frame heap allocations are attributed to, set per thread by AllocationScope
+    enum class EAllocationSubsystem : uint32_t
+    {
+        Other,
+        Update,
+        UI,
+        Render,
+        Submit,
+        Streaming,
+        Jobs,
+        Count
+    };
+
+    const char* ToString(EAllocationSubsystem subsystem);
+
+    struct AllocationCounters
+    {
+        uint64_t allocations = 0;
+        uint64_t bytes = 0;
+        uint64_t frees = 0;
+    };
+
+    struct AllocationFrameStats
+    {
+        static constexpr size_t kSubsystemCount = static_cast<size_t>(EAllocationSubsystem::Count);
+
+        std::array<AllocationCounters, kSubsystemCount> subsystems{};
+        AllocationCounters total{};
+    };
+
+    // Counts heap allocations per frame through replacements of the global operator new and delete.
+    // The replacements are only compiled with ENGINE_TRACK_ALLOCATIONS, without it nothing is counted
+    // and the allocator is left alone.
+    class AllocationTracker final
+    {
+    public:
+        static bool IsAvailable();
+
+        static void SetEnabled(bool enabled);
+        static bool IsEnabled();
+
+        // Latches the counters of the frame that just ended and starts counting the next one
+        static void EndFrame();
+
+        static const AllocationFrameStats& GetLastFrame();
+        static const AllocationFrameStats& GetPeakFrame();
+
+        // Frames counted so far and how many of them allocated at all
+        static uint64_t GetFrameCount();
+        static uint64_t GetAllocatingFrameCount();
+
+        static bool DumpJson(const char* filename);
+    };
+
+    // Attributes the allocations of the calling thread to a subsystem for its lifetime
+    class AllocationScope final
+    {
+    public:
+        CLASS_COPY_MOVE_DELETE(AllocationScope)
+
+        explicit AllocationScope(EAllocationSubsystem subsystem);
+        ~AllocationScope();
+
+        // Default subsystem of the calling thread outside of any scope
+        static void SetThreadSubsystem(EAllocationSubsystem subsystem);
+
+    private:
+        EAllocationSubsystem previous;
+    };
+}
@@ -0,0 +1,35 @@
+#include "FrameLimiter.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace jgw
+{
+    void FrameLimiter::Wait(double framesPerSecond)
+    {
+        const Clock::time_point start = Clock::now();
+        if (framesPerSecond <= 0.0)
+        {
+            deadline = start;
+            waitMs = 0.0f;
+            return;
+        }
+
+        // A frame that overran its period is not made up for, catching up would only produce a burst
+        deadline = std::max(deadline + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / framesPerSecond)), start);
+
+        const Clock::time_point wakeup = deadline - spinMargin;
+        if (wakeup > start)
+        {
+            std::this_thread::sleep_until(wakeup);
+
+            const Clock::duration oversleep = Clock::now() - wakeup;
+            spinMargin = std::clamp<Clock::duration>(std::max<Clock::duration>(oversleep + oversleep / 4, spinMargin - kSpinMarginDecay), kMinSpinMargin, kMaxSpinMargin);
+        }
+
+        while (Clock::now() < deadline)
+            std::this_thread::yield();
+
+        waitMs = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "Macro.h"
+
+#include <chrono>
+
+namespace jgw
+{
+    // Holds the frame rate to a target. Sleeps until shortly before the deadline and spins the rest, the
+    // margin follows how far the OS oversleeps so frame times stay even without burning a core.
+    class FrameLimiter final
+    {
+    public:
+        CLASS_COPY_MOVE_DELETE(FrameLimiter)
+
+        FrameLimiter() = default;
+
+        // Blocks until the next frame may start, a rate of 0 returns immediately
+        void Wait(double framesPerSecond);
+
+        float GetWaitMs() const { return waitMs; }
+        float GetSpinMarginMs() const { return std::chrono::duration<float, std::milli>(spinMargin).count(); }
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        static constexpr std::chrono::microseconds kMinSpinMargin{ 200 };
+        static constexpr std::chrono::microseconds kMaxSpinMargin{ 4000 };
+
+        // Shrinks by this per frame, one late wakeup grows it at once
+        static constexpr std::chrono::microseconds kSpinMarginDecay{ 10 };
+
+        Clock::time_point deadline{};
+        Clock::duration spinMargin = std::chrono::microseconds(1000);
+        float waitMs = 0.0f;
+    };
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <type_traits>
+#include <utility>
+
+namespace jgw
+{
+    template<typename Signature>
+    class FunctionRef;
+
+    // Non-owning reference to a callable, unlike std::function it never allocates.
+    // Only valid while the referenced callable lives, so it is meant for parameters of synchronous calls.
+    template<typename R, typename... Args>
+    class FunctionRef<R(Args...)> final
+    {
+    public:
+        template<typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, FunctionRef>>>
+        FunctionRef(F&& callable)
+            : object(const_cast<void*>(static_cast<const void*>(&callable)))
+            , callback([](void* object, Args... args) -> R {
+                return (*static_cast<std::remove_reference_t<F>*>(object))(std::forward<Args>(args)...);
+            })
+        { }
+
+        R operator()(Args... args) const { return callback(object, std::forward<Args>(args)...); }
+
+    private:
+        void* object;
+        R (*callback)(void*, Args...);
+    };
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <type_traits>
+
+namespace jgw
+{
+    constexpr uint64_t kHashSeed = 0xcbf29ce484222325ull;
+
+    // 64 bit FNV-1a
+    inline uint64_t HashBytes(const void* data, size_t size, uint64_t seed = kHashSeed)
+    {
+        const auto* bytes = static_cast<const uint8_t*>(data);
+        uint64_t hash = seed;
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= bytes[i];
+            hash *= 0x100000001b3ull;
+        }
+        return hash;
+    }
+
+    template<typename T>
+    inline void HashCombine(uint64_t& seed, const T& value)
+    {
+        seed ^= std::hash<T>{}(value) + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+    }
+
+    // Appends the bytes of a scalar to a key compared byte for byte, structs may carry padding or pointers
+    template<typename T>
+    inline void AppendKey(std::string& key, const T& value)
+    {
+        static_assert(std::is_scalar_v<T>);
+        key.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+}
@@ -0,0 +1,112 @@
+#include "JobQueue.h"
+#include "AllocationTracker.h"
+
+#include <algorithm>
+
+namespace jgw
+{
+    static thread_local const JobQueue* currentQueue = nullptr;
+    static thread_local uint32_t currentWorker = 0;
+
+    JobQueue::JobQueue(uint32_t threadCount)
+    {
+        if (threadCount == 0)
+            threadCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+
+        workers.reserve(threadCount);
+        for (uint32_t i = 0; i < threadCount; ++i)
+        {
+            workers.emplace_back(&JobQueue::WorkerLoop, this, i);
+        }
+    }
+
+    JobQueue::~JobQueue()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        jobAvailable.notify_all();
+
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    void JobQueue::Submit(std::function<void()> job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            PushJob(std::move(job));
+            ++pendingJobs;
+        }
+        jobAvailable.notify_one();
+    }
+
+    void JobQueue::Wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        jobsDone.wait(lock, [this] { return pendingJobs == 0; });
+    }
+
+    uint32_t JobQueue::WorkerIndex() const
+    {
+        return currentQueue == this ? currentWorker : ThreadCount();
+    }
+
+    void JobQueue::WorkerLoop(uint32_t index)
+    {
+        currentQueue = this;
+        currentWorker = index;
+        AllocationScope::SetThreadSubsystem(EAllocationSubsystem::Jobs);
+
+        while (true)
+        {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                jobAvailable.wait(lock, [this] { return stopping || jobCount > 0; });
+                if (stopping && jobCount == 0)
+                    return;
+
+                job = PopJob();
+            }
+
+            job();
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                --pendingJobs;
+            }
+            jobsDone.notify_all();
+        }
+    }
+
+    void JobQueue::PushJob(std::function<void()>&& job)
+    {
+        if (jobCount == jobs.size())
+        {
+            // Unwrap the ring into a larger one
+            std::vector<std::function<void()>> grown(std::max<size_t>(16, jobs.size() * 2));
+            for (size_t i = 0; i < jobCount; ++i)
+            {
+                grown[i] = std::move(jobs[(jobHead + i) % jobs.size()]);
+            }
+            jobs = std::move(grown);
+            jobHead = 0;
+        }
+
+        jobs[(jobHead + jobCount) % jobs.size()] = std::move(job);
+        ++jobCount;
+    }
+
+    std::function<void()> JobQueue::PopJob()
+    {
+        std::function<void()> job = std::move(jobs[jobHead]);
+        jobs[jobHead] = nullptr;
+        jobHead = (jobHead + 1) % jobs.size();
+        --jobCount;
+        return job;
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "Macro.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace jgw
+{
+    // Fixed pool of worker threads consuming jobs in submission order
+    class JobQueue final
+    {
+    public:
+        CLASS_COPY_MOVE_DELETE(JobQueue)
+
+        // 0 uses one worker per hardware thread except the calling one
+        explicit JobQueue(uint32_t threadCount = 0);
+        ~JobQueue();
+
+        void Submit(std::function<void()> job);
+
+        // Blocks until every submitted job has finished
+        void Wait();
+
+        inline uint32_t ThreadCount() const { return static_cast<uint32_t>(workers.size()); }
+
+        // Index of the calling worker thread of this queue, ThreadCount() for any other thread
+        uint32_t WorkerIndex() const;
+
+    private:
+        void WorkerLoop(uint32_t index);
+
+        // Called with the mutex held
+        void PushJob(std::function<void()>&& job);
+        std::function<void()> PopJob();
+
+        std::vector<std::thread> workers;
+
+        // Ring buffer that only grows, so a steady stream of jobs does not allocate
+        std::vector<std::function<void()>> jobs;
+        size_t jobHead = 0;
+        size_t jobCount = 0;
+
+        std::mutex mutex;
+        std::condition_variable jobAvailable;
+        std::condition_variable jobsDone;
+
+        uint32_t pendingJobs = 0;
+        bool stopping = false;
+    };
+}
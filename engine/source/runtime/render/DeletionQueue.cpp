@@ -0,0 +1,86 @@
+#include "DeletionQueue.h"
+
+namespace jgw
+{
+    DeletionQueue::DeletionQueue(vk::Device device, vma::Allocator vmaAllocator, MemoryTracker& tracker)
+        : device(device)
+        , vmaAllocator(vmaAllocator)
+        , tracker(tracker)
+    {
+    }
+
+    DeletionQueue::~DeletionQueue()
+    {
+        Flush();
+    }
+
+    void DeletionQueue::Push(uint64_t frame, DeferredObject&& object)
+    {
+        if (count == entries.size())
+        {
+            // Unwrap into a larger ring
+            std::vector<Entry> grown(std::max<size_t>(16, entries.size() * 2));
+            for (size_t i = 0; i < count; ++i)
+                grown[i] = std::move(entries[(head + i) % entries.size()]);
+            entries = std::move(grown);
+            head = 0;
+        }
+
+        Entry& entry = entries[(head + count) % entries.size()];
+        entry.frame = frame;
+        entry.object = std::move(object);
+        ++count;
+    }
+
+    uint32_t DeletionQueue::Collect(FunctionRef<bool(uint64_t)> isFrameComplete)
+    {
+        uint32_t destroyed = 0;
+        while (count > 0)
+        {
+            Entry& entry = entries[head];
+            if (!isFrameComplete(entry.frame))
+                break;
+
+            Destroy(entry.object);
+            head = (head + 1) % entries.size();
+            --count;
+            ++destroyed;
+        }
+        return destroyed;
+    }
+
+    void DeletionQueue::Flush()
+    {
+        Collect([](uint64_t) { return true; });
+    }
+
+    void DeletionQueue::Destroy(DeferredObject& object)
+    {
+        struct Destroyer
+        {
+            vk::Device device;
+            vma::Allocator vmaAllocator;
+            MemoryTracker& tracker;
+
+            void operator()(std::unique_ptr<VulkanBuffer>& buffer) const { buffer.reset(); }
+            void operator()(std::unique_ptr<VulkanTexture>& texture) const { texture.reset(); }
+            void operator()(std::shared_ptr<VulkanPipeline>& pipeline) const { pipeline.reset(); }
+            void operator()(vk::Image image) const { device.destroyImage(image); }
+            void operator()(vk::ImageView view) const { device.destroyImageView(view); }
+            void operator()(vk::Pipeline pipeline) const { device.destroyPipeline(pipeline); }
+            void operator()(vk::PipelineLayout layout) const { device.destroyPipelineLayout(layout); }
+            void operator()(vk::DescriptorPool pool) const { device.destroyDescriptorPool(pool); }
+            void operator()(vk::SwapchainKHR swapchain) const { device.destroySwapchainKHR(swapchain); }
+            void operator()(vma::Allocation allocation) const
+            {
+                if (!allocation)
+                    return;
+
+                tracker.Remove(EMemoryCategory::RenderTarget, vmaAllocator.getAllocationInfo(allocation).size);
+                vmaAllocator.freeMemory(allocation);
+            }
+        };
+
+        std::visit(Destroyer{ device, vmaAllocator, tracker }, object);
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Common.h"
+#include "FunctionRef.h"
+#include "VulkanBuffer.h"
+#include "VulkanTexture.h"
+#include "VulkanPipeline.h"
+#include "VulkanMemoryStats.h"
+
+#include <variant>
+
+namespace jgw
+{
+    // Anything the GPU may still reference from a frame in flight
+    using DeferredObject = std::variant<
+        std::unique_ptr<VulkanBuffer>,
+        std::unique_ptr<VulkanTexture>,
+        std::shared_ptr<VulkanPipeline>,
+        vk::Image,
+        vk::ImageView,
+        vk::Pipeline,
+        vk::PipelineLayout,
+        vk::DescriptorPool,
+        vk::SwapchainKHR,
+        vma::Allocation
+    >;
+
+    // Objects tagged with the last frame that may use them, destroyed once that frame has completed.
+    // Frames complete in order and objects are pushed with increasing frames, so collection stops at the
+    // first object whose frame is still in flight.
+    class DeletionQueue final
+    {
+    public:
+        CLASS_COPY_MOVE_DELETE(DeletionQueue)
+
+        // Raw allocations are render target memory, freed from the tracker as in VulkanContext::FreeImageMemory
+        DeletionQueue(vk::Device device, vma::Allocator vmaAllocator, MemoryTracker& tracker);
+        ~DeletionQueue();
+
+        void Push(uint64_t frame, DeferredObject&& object);
+
+        // Destroys the objects of every frame isFrameComplete accepts, returns how many were destroyed
+        uint32_t Collect(FunctionRef<bool(uint64_t)> isFrameComplete);
+
+        // Destroys everything, the device has to be idle
+        void Flush();
+
+        size_t GetPendingCount() const { return count; }
+
+    private:
+        struct Entry
+        {
+            uint64_t frame = 0;
+            DeferredObject object;
+        };
+
+        void Destroy(DeferredObject& object);
+
+        vk::Device device;
+        vma::Allocator vmaAllocator;
+        MemoryTracker& tracker;
+
+        // Ring buffer, only grows so steady state pushes do not allocate
+        std::vector<Entry> entries;
+        size_t head = 0;
+        size_t count = 0;
+    };
+}
@@ -0,0 +1,77 @@
+#include "FrameAllocator.h"
+#include "VulkanContext.h"
+
+#include <algorithm>
+
+namespace jgw
+{
+    FrameAllocator::FrameAllocator(VulkanContext& context, uint32_t frameInFlight, const FrameAllocatorConfig& config)
+        : config(config)
+    {
+        // Host visible memory, device local where the hardware allows it (ReBAR or UMA)
+        buffer = context.CreateBuffer(
+            config.capacityPerFrame * frameInFlight,
+            vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress,
+            vma::AllocationCreateFlagBits::eMapped | vma::AllocationCreateFlagBits::eHostAccessSequentialWrite,
+            vma::MemoryUsage::eAutoPreferDevice
+        );
+        buffer->Map();
+        mapped = static_cast<uint8_t*>(buffer->Data());
+
+        vk::BufferDeviceAddressInfo addrInfo{
+            .buffer = buffer->Handle()
+        };
+        baseAddress = context.GetDevice().getBufferAddress(addrInfo);
+    }
+
+    FrameAllocator::~FrameAllocator() = default;
+
+    void FrameAllocator::BeginFrame(uint32_t frame)
+    {
+        currentFrame = frame;
+        head = 0;
+        allocations = 0;
+        failedAllocations = 0;
+    }
+
+    void FrameAllocator::Flush()
+    {
+        if (head > 0)
+            buffer->Flush();
+    }
+
+    FrameAllocation FrameAllocator::Allocate(vk::DeviceSize size, vk::DeviceSize alignment)
+    {
+        const vk::DeviceSize begin = (head + alignment - 1) / alignment * alignment;
+        if (begin + size > config.capacityPerFrame)
+        {
+            if (failedAllocations++ == 0)
+                spdlog::error("Frame allocator exhausted: {} of {} bytes requested", begin + size, config.capacityPerFrame);
+            return {};
+        }
+
+        head = begin + size;
+        peak = std::max(peak, head);
+        ++allocations;
+
+        const vk::DeviceSize offset = config.capacityPerFrame * currentFrame + begin;
+        return {
+            .data = mapped + offset,
+            .address = baseAddress + offset,
+            .buffer = buffer->Handle(),
+            .offset = offset,
+            .size = size
+        };
+    }
+
+    FrameAllocatorStats FrameAllocator::GetStats() const
+    {
+        return {
+            .capacityPerFrame = config.capacityPerFrame,
+            .usedBytes = head,
+            .peakBytes = peak,
+            .allocations = allocations,
+            .failedAllocations = failedAllocations
+        };
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "Common.h"
+
+namespace jgw
+{
+    class VulkanContext;
+    class VulkanBuffer;
+
+    struct FrameAllocatorConfig
+    {
+        // Bytes available to each frame in flight, allocations beyond that fail for the rest of the frame
+        vk::DeviceSize capacityPerFrame = 4 * 1024 * 1024;
+    };
+
+    struct FrameAllocation
+    {
+        void* data = nullptr;
+        vk::DeviceAddress address = 0;
+        vk::Buffer buffer{};
+        vk::DeviceSize offset = 0;
+        vk::DeviceSize size = 0;
+
+        explicit operator bool() const { return data != nullptr; }
+    };
+
+    // Camera and timing data shared by all draws of a frame, mirrors FrameConstants in the shaders
+    struct FrameConstants
+    {
+        glm::mat4 view;
+        glm::mat4 proj;
+        glm::mat4 viewProj;
+        glm::vec4 cameraPos;
+        glm::vec2 viewportSize;
+        float time;
+        uint32_t frameIndex;
+    };
+
+    struct FrameAllocatorStats
+    {
+        vk::DeviceSize capacityPerFrame = 0;
+        vk::DeviceSize usedBytes = 0;
+        vk::DeviceSize peakBytes = 0;
+        uint32_t allocations = 0;
+        uint32_t failedAllocations = 0;
+    };
+
+    // Linear allocator over one persistently mapped buffer split into a region per frame in flight.
+    // A region is reset in BeginRender after the timeline semaphore has reached the value signaled by the
+    // last frame of its slot, so data written through it is never overwritten while the GPU may still read it.
+    class FrameAllocator final
+    {
+    public:
+        CLASS_COPY_MOVE_DELETE(FrameAllocator)
+
+        FrameAllocator(VulkanContext& context, uint32_t frameInFlight, const FrameAllocatorConfig& config);
+        ~FrameAllocator();
+
+        void BeginFrame(uint32_t frame);
+
+        // Makes host writes of the current frame visible to the device
+        void Flush();
+
+        // Empty allocation when the region of the current frame is exhausted
+        FrameAllocation Allocate(vk::DeviceSize size, vk::DeviceSize alignment = 16);
+
+        template<typename T>
+        FrameAllocation Push(const T& value)
+        {
+            FrameAllocation allocation = Allocate(sizeof(T), alignof(T) > 16 ? alignof(T) : 16);
+            if (allocation)
+                memcpy(allocation.data, &value, sizeof(T));
+            return allocation;
+        }
+
+        FrameAllocatorStats GetStats() const;
+
+    private:
+        FrameAllocatorConfig config;
+        uint32_t currentFrame = 0;
+
+        std::unique_ptr<VulkanBuffer> buffer;
+        vk::DeviceAddress baseAddress = 0;
+        uint8_t* mapped = nullptr;
+
+        vk::DeviceSize head = 0;
+        vk::DeviceSize peak = 0;
+        uint32_t allocations = 0;
+        uint32_t failedAllocations = 0;
+    };
+}
@@ -0,0 +1,168 @@
+#include "FramePacing.h"
+
+namespace jgw
+{
+    static float Smooth(float average, double sampleSeconds, float smoothing)
+    {
+        const float sampleMs = static_cast<float>(sampleSeconds * 1000.0);
+        return average == 0.0f ? sampleMs : average + (sampleMs - average) * smoothing;
+    }
+
+    void LatencyTracker::OnSubmit(double time)
+    {
+        submitTime = time;
+        stats.inputToSubmitMs = Smooth(stats.inputToSubmitMs, submitTime - inputTime, kSmoothing);
+    }
+
+    void LatencyTracker::OnPresentQueued(uint64_t presentId)
+    {
+        // The oldest present is dropped when the swapchain falls too far behind
+        if (pendingCount == kMaxPending)
+        {
+            pendingBegin = (pendingBegin + 1) % kMaxPending;
+            --pendingCount;
+        }
+
+        pending[(pendingBegin + pendingCount) % kMaxPending] = {
+            .presentId = presentId,
+            .inputTime = inputTime,
+            .submitTime = submitTime
+        };
+        ++pendingCount;
+    }
+
+    void LatencyTracker::OnPresented(double time)
+    {
+        if (pendingCount == 0)
+            return;
+
+        const PendingPresent& present = pending[pendingBegin];
+        stats.submitToPresentMs = Smooth(stats.submitToPresentMs, time - present.submitTime, kSmoothing);
+        stats.inputToPresentMs = Smooth(stats.inputToPresentMs, time - present.inputTime, kSmoothing);
+
+        pendingBegin = (pendingBegin + 1) % kMaxPending;
+        --pendingCount;
+    }
+
+    void LatencyTracker::OnPresentCall(double time)
+    {
+        stats.submitToPresentMs = Smooth(stats.submitToPresentMs, time - submitTime, kSmoothing);
+        stats.inputToPresentMs = Smooth(stats.inputToPresentMs, time - inputTime, kSmoothing);
+    }
+
+    void LatencyTracker::Reset()
+    {
+        pendingBegin = 0;
+        pendingCount = 0;
+    }
+
+    PresentWaiter::PresentWaiter(vk::Device device)
+        : device(device)
+    {
+        thread = std::thread(&PresentWaiter::WaitLoop, this);
+    }
+
+    PresentWaiter::~PresentWaiter()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        presentQueued.notify_all();
+        thread.join();
+    }
+
+    void PresentWaiter::Queue(vk::SwapchainKHR swapchain, uint64_t presentId)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            // The oldest present is dropped when the swapchain falls too far behind, like in the tracker
+            if (queuedCount == kMaxQueued)
+            {
+                queuedBegin = (queuedBegin + 1) % kMaxQueued;
+                --queuedCount;
+            }
+
+            queued[(queuedBegin + queuedCount) % kMaxQueued] = {
+                .swapchain = swapchain,
+                .presentId = presentId
+            };
+            ++queuedCount;
+        }
+        presentQueued.notify_one();
+    }
+
+    void PresentWaiter::Collect(LatencyTracker& latency)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t i = 0; i < completedCount; ++i)
+        {
+            if (completed[i] < 0.0)
+            {
+                latency.Reset();
+                break;
+            }
+            latency.OnPresented(completed[i]);
+        }
+        completedCount = 0;
+    }
+
+    void PresentWaiter::Reset()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        queuedBegin = 0;
+        queuedCount = 0;
+        completedCount = 0;
+        ++generation;
+        waitDone.wait(lock, [this] { return !waiting; });
+    }
+
+    void PresentWaiter::WaitLoop()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true)
+        {
+            presentQueued.wait(lock, [this] { return stopping || queuedCount > 0; });
+            if (stopping)
+                return;
+
+            const Present present = queued[queuedBegin];
+            queuedBegin = (queuedBegin + 1) % kMaxQueued;
+            --queuedCount;
+
+            const uint64_t waitGeneration = generation;
+            waiting = true;
+            lock.unlock();
+
+            vk::Result result;
+            try
+            {
+                result = device.waitForPresentKHR(present.swapchain, present.presentId, kTimeoutNs);
+            }
+            catch (const vk::SystemError&)
+            {
+                result = vk::Result::eErrorUnknown;
+            }
+            const double time = glfwGetTime();
+
+            lock.lock();
+            waiting = false;
+            waitDone.notify_all();
+
+            // Presents queued before a reset belong to a retired swapchain
+            if (waitGeneration != generation)
+                continue;
+
+            // Nobody collected for a while, the tracker cannot tell which presents went missing
+            if (completedCount == kMaxQueued)
+            {
+                completed[kMaxQueued - 1] = -1.0;
+                continue;
+            }
+
+            const bool presented = result == vk::Result::eSuccess || result == vk::Result::eSuboptimalKHR;
+            completed[completedCount++] = presented ? time : -1.0;
+        }
+    }
+}
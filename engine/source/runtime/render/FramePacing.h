@@ -0,0 +1,140 @@
+#pragma once
+
+#include "Common.h"
+
+#include <array>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace jgw
+{
+    struct FramePacingConfig
+    {
+        // FIFO is used when the surface does not support the requested mode
+        vk::PresentModeKHR presentMode = vk::PresentModeKHR::eMailbox;
+
+        // 0 requests one image more than the surface minimum
+        uint32_t swapchainImageCount = 0;
+
+        // Frames recorded ahead of the GPU, lower values trade throughput for latency
+        uint32_t frameInFlight = 3;
+
+        // Caps the frame rate of the main loop, 0 leaves it to the present mode
+        float frameRateLimit = 0.0f;
+
+        // Rates while the window has no focus or saw no input for idleDelay seconds, 0 keeps rendering
+        // at full rate. A minimized window always blocks until an event arrives.
+        float unfocusedFrameRate = 15.0f;
+        float idleFrameRate = 0.0f;
+        float idleDelay = 2.0f;
+    };
+
+    struct LatencyStats
+    {
+        // Input polled to command buffer submitted
+        float inputToSubmitMs = 0.0f;
+
+        // Submitted to presented and input polled to presented. Without present wait the end is the return of
+        // the present call, which only queues the image.
+        float submitToPresentMs = 0.0f;
+        float inputToPresentMs = 0.0f;
+
+        bool presentWait = false;
+    };
+
+    // Smoothed latencies of the last frames. Presents are tracked by present id in submission order
+    // and completed once the swapchain reports them presented, or right away without present wait.
+    class LatencyTracker final
+    {
+    public:
+        CLASS_COPY_MOVE_DELETE(LatencyTracker)
+
+        LatencyTracker() = default;
+
+        void OnInput(double time) { inputTime = time; }
+        void OnSubmit(double time);
+        void OnPresentQueued(uint64_t presentId);
+        void OnPresented(double time);
+        void OnPresentCall(double time);
+
+        // Presents of a destroyed swapchain are never reported
+        void Reset();
+
+        bool HasPending() const { return pendingCount > 0; }
+        uint64_t OldestPending() const { return pending[pendingBegin].presentId; }
+
+        LatencyStats GetStats() const { return stats; }
+        void SetPresentWait(bool enabled) { stats.presentWait = enabled; }
+
+    private:
+        struct PendingPresent
+        {
+            uint64_t presentId = 0;
+            double inputTime = 0.0;
+            double submitTime = 0.0;
+        };
+
+        static constexpr size_t kMaxPending = 8;
+        static constexpr float kSmoothing = 0.1f;
+
+        std::array<PendingPresent, kMaxPending> pending{};
+        size_t pendingBegin = 0;
+        size_t pendingCount = 0;
+
+        double inputTime = 0.0;
+        double submitTime = 0.0;
+        LatencyStats stats{};
+    };
+
+    // Blocks in vkWaitForPresentKHR on a thread of its own, so each present is timed when the wait returns
+    // and not when the frame loop gets around to polling it
+    class PresentWaiter final
+    {
+    public:
+        CLASS_COPY_MOVE_DELETE(PresentWaiter)
+
+        explicit PresentWaiter(vk::Device device);
+        ~PresentWaiter();
+
+        void Queue(vk::SwapchainKHR swapchain, uint64_t presentId);
+
+        // Hands the presents that completed since the last call to the tracker, in present order
+        void Collect(LatencyTracker& latency);
+
+        // Drops every queued present and returns once no wait is running, the swapchain may be retired after
+        void Reset();
+
+    private:
+        struct Present
+        {
+            vk::SwapchainKHR swapchain;
+            uint64_t presentId = 0;
+        };
+
+        void WaitLoop();
+
+        // A present that has not reached the display by then is given up
+        static constexpr uint64_t kTimeoutNs = 1'000'000'000;
+        static constexpr size_t kMaxQueued = 8;
+
+        vk::Device device;
+        std::thread thread;
+
+        std::mutex mutex;
+        std::condition_variable presentQueued;
+        std::condition_variable waitDone;
+
+        std::array<Present, kMaxQueued> queued{};
+        size_t queuedBegin = 0;
+        size_t queuedCount = 0;
+
+        // Present times, negative for a present that failed
+        std::array<double, kMaxQueued> completed{};
+        size_t completedCount = 0;
+
+        uint64_t generation = 0;
+        bool waiting = false;
+        bool stopping = false;
+    };
+}
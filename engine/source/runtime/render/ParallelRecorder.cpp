@@ -0,0 +1,108 @@
+#include "ParallelRecorder.h"
+#include "JobQueue.h"
+
+namespace jgw
+{
+    ParallelRecorder::ParallelRecorder(vk::Device device, uint32_t queueFamilyIndex, uint32_t frameInFlight, uint32_t threadCount)
+        : device(device)
+        , threadCount(threadCount)
+    {
+        vk::CommandPoolCreateInfo commandPoolCI{
+            .flags = vk::CommandPoolCreateFlagBits::eTransient,
+            .queueFamilyIndex = queueFamilyIndex
+        };
+
+        pools.resize(static_cast<size_t>(frameInFlight) * threadCount);
+        for (auto& threadPool : pools)
+        {
+            threadPool.pool = device.createCommandPool(commandPoolCI);
+        }
+    }
+
+    ParallelRecorder::~ParallelRecorder()
+    {
+        for (auto& threadPool : pools)
+        {
+            device.destroyCommandPool(threadPool.pool);
+        }
+    }
+
+    void ParallelRecorder::BeginFrame(uint32_t frame)
+    {
+        currentFrame = frame;
+        for (uint32_t thread = 0; thread < threadCount; ++thread)
+        {
+            auto& threadPool = pools[currentFrame * threadCount + thread];
+            if (threadPool.used == 0)
+                continue;
+
+            device.resetCommandPool(threadPool.pool);
+            threadPool.used = 0;
+        }
+    }
+
+    vk::CommandBuffer ParallelRecorder::Acquire(ThreadPool& threadPool)
+    {
+        if (threadPool.used == threadPool.buffers.size())
+        {
+            vk::CommandBufferAllocateInfo commandBufferAI{
+                .commandPool = threadPool.pool,
+                .level = vk::CommandBufferLevel::eSecondary,
+                .commandBufferCount = 1
+            };
+            threadPool.buffers.push_back(device.allocateCommandBuffers(commandBufferAI)[0]);
+        }
+
+        return threadPool.buffers[threadPool.used++];
+    }
+
+    const std::vector<vk::CommandBuffer>& ParallelRecorder::Record(
+        JobQueue& jobQueue,
+        const vk::CommandBufferInheritanceInfo& inheritanceInfo,
+        uint32_t taskCount,
+        FunctionRef<void(vk::CommandBuffer, uint32_t)> record
+    )
+    {
+        recorded.resize(taskCount);
+        currentInheritance = &inheritanceInfo;
+        currentRecord = &record;
+        currentQueue = &jobQueue;
+        remainingTasks.store(taskCount, std::memory_order_relaxed);
+
+        for (uint32_t task = 0; task < taskCount; ++task)
+        {
+            jobQueue.Submit([this, task] { RecordTask(task); });
+        }
+
+        while (uint32_t remaining = remainingTasks.load(std::memory_order_acquire))
+        {
+            remainingTasks.wait(remaining, std::memory_order_acquire);
+        }
+
+        currentInheritance = nullptr;
+        currentRecord = nullptr;
+        currentQueue = nullptr;
+        return recorded;
+    }
+
+    void ParallelRecorder::RecordTask(uint32_t task)
+    {
+        // Jobs only run on the workers of the queue, each of which owns its pool
+        const uint32_t thread = currentQueue->WorkerIndex();
+        assert(thread < threadCount);
+        vk::CommandBuffer commandBuffer = Acquire(pools[currentFrame * threadCount + thread]);
+
+        vk::CommandBufferBeginInfo beginInfo{
+            .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit | vk::CommandBufferUsageFlagBits::eRenderPassContinue,
+            .pInheritanceInfo = currentInheritance
+        };
+        commandBuffer.begin(beginInfo);
+        (*currentRecord)(commandBuffer, task);
+        commandBuffer.end();
+
+        recorded[task] = commandBuffer;
+
+        if (remainingTasks.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            remainingTasks.notify_one();
+    }
+}
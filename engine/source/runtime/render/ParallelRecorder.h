@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Common.h"
+#include "FunctionRef.h"
+
+#include <atomic>
+
+namespace jgw
+{
+    class JobQueue;
+
+    // Records secondary command buffers on the worker threads of a job queue. Every thread owns one
+    // command pool per frame slot, so recording needs no locking and the pools of a slot are reset
+    // as a whole once the GPU is done with the frame that last used it.
+    class ParallelRecorder final
+    {
+    public:
+        CLASS_COPY_MOVE_DELETE(ParallelRecorder)
+
+        ParallelRecorder(vk::Device device, uint32_t queueFamilyIndex, uint32_t frameInFlight, uint32_t threadCount);
+        ~ParallelRecorder();
+
+        void BeginFrame(uint32_t frame);
+
+        // Runs record once per task on the job queue, each into its own secondary command buffer begun with
+        // the given inheritance info. The buffers are returned in task order. Only waits for its own tasks,
+        // other jobs of the queue keep running.
+        const std::vector<vk::CommandBuffer>& Record(
+            JobQueue& jobQueue,
+            const vk::CommandBufferInheritanceInfo& inheritanceInfo,
+            uint32_t taskCount,
+            FunctionRef<void(vk::CommandBuffer, uint32_t)> record
+        );
+
+    private:
+        struct ThreadPool
+        {
+            vk::CommandPool pool{};
+            std::vector<vk::CommandBuffer> buffers;
+            uint32_t used = 0;
+        };
+
+        vk::CommandBuffer Acquire(ThreadPool& threadPool);
+        void RecordTask(uint32_t task);
+
+        vk::Device device;
+        uint32_t threadCount;
+        uint32_t currentFrame = 0;
+
+        // Indexed by frame slot * threadCount + thread
+        std::vector<ThreadPool> pools;
+        std::vector<vk::CommandBuffer> recorded;
+
+        // Arguments of the running Record, jobs only capture the recorder and their task so they never allocate
+        JobQueue* currentQueue = nullptr;
+        const vk::CommandBufferInheritanceInfo* currentInheritance = nullptr;
+        const FunctionRef<void(vk::CommandBuffer, uint32_t)>* currentRecord = nullptr;
+        std::atomic<uint32_t> remainingTasks{ 0 };
+    };
+}
@@ -1,24 +1,8 @@
 #include "PipelineBuilder.h"
-
-#include <fstream>
+#include "Hash.h"
 
 namespace jgw
 {
-    std::vector<vk::PipelineShaderStageCreateInfo> PipelineBuilder::BuildShaderStages(const vk::Device& device)
-    {
-        std::vector<vk::PipelineShaderStageCreateInfo> shaderStages;
-        for (const auto& it : shaderFiles)
-        {
-            vk::PipelineShaderStageCreateInfo shaderStageCI{
-                .stage = it.first,
-                .module = LoadShader(it.second.c_str(), device),
-                .pName = "main"
-            };
-            shaderStages.emplace_back(shaderStageCI);
-        }
-        return shaderStages;
-    }
-
     void PipelineBuilder::SetVertexBindingDescriptions(std::vector<vk::VertexInputBindingDescription>& descriptions)
     {
         vertexInputStateCI.vertexBindingDescriptionCount = static_cast<uint32_t>(descriptions.size());
@@ -49,32 +33,136 @@ namespace jgw
         layoutCI.pPushConstantRanges = ranges.data();
     }
 
-    vk::ShaderModule PipelineBuilder::LoadShader(const char* filename, const vk::Device& device)
+    void PipelineBuilder::AppendStateKey(std::string& key) const
     {
-        std::ifstream is(filename, std::ios::binary | std::ios::in | std::ios::ate);
+        AppendKey(key, static_cast<uint32_t>(vertexInputStateCI.flags));
+        AppendKey(key, vertexInputStateCI.vertexBindingDescriptionCount);
+        for (uint32_t i = 0; i < vertexInputStateCI.vertexBindingDescriptionCount; ++i)
+        {
+            const auto& binding = vertexInputStateCI.pVertexBindingDescriptions[i];
+            AppendKey(key, binding.binding);
+            AppendKey(key, binding.stride);
+            AppendKey(key, static_cast<uint32_t>(binding.inputRate));
+        }
+        AppendKey(key, vertexInputStateCI.vertexAttributeDescriptionCount);
+        for (uint32_t i = 0; i < vertexInputStateCI.vertexAttributeDescriptionCount; ++i)
+        {
+            const auto& attribute = vertexInputStateCI.pVertexAttributeDescriptions[i];
+            AppendKey(key, attribute.location);
+            AppendKey(key, attribute.binding);
+            AppendKey(key, static_cast<uint32_t>(attribute.format));
+            AppendKey(key, attribute.offset);
+        }
+
+        AppendKey(key, static_cast<uint32_t>(inputAssemblyStateCI.topology));
+        AppendKey(key, inputAssemblyStateCI.primitiveRestartEnable);
 
-        if (is.is_open())
+        AppendKey(key, tessellationStateCI.patchControlPoints);
+        AppendKey(key, static_cast<uint32_t>(tessellationDomainOriginStateCI.domainOrigin));
+
+        AppendKey(key, viewportStateCI.viewportCount);
+        AppendKey(key, viewportStateCI.scissorCount);
+        for (uint32_t i = 0; viewportStateCI.pViewports && i < viewportStateCI.viewportCount; ++i)
+        {
+            const auto& viewport = viewportStateCI.pViewports[i];
+            for (float value : { viewport.x, viewport.y, viewport.width, viewport.height, viewport.minDepth, viewport.maxDepth })
+                AppendKey(key, value);
+        }
+        for (uint32_t i = 0; viewportStateCI.pScissors && i < viewportStateCI.scissorCount; ++i)
         {
-            size_t size = is.tellg();
-            is.seekg(0, std::ios::beg);
-            char* shaderCode = new char[size];
-            is.read(shaderCode, size);
-            is.close();
+            const auto& scissor = viewportStateCI.pScissors[i];
+            AppendKey(key, scissor.offset.x);
+            AppendKey(key, scissor.offset.y);
+            AppendKey(key, scissor.extent.width);
+            AppendKey(key, scissor.extent.height);
+        }
 
-            vk::ShaderModuleCreateInfo shaderModuleCI{
-                .codeSize = size,
-                .pCode = (uint32_t*)shaderCode
-            };
+        AppendKey(key, rasterizationStateCI.depthClampEnable);
+        AppendKey(key, rasterizationStateCI.rasterizerDiscardEnable);
+        AppendKey(key, static_cast<uint32_t>(rasterizationStateCI.polygonMode));
+        AppendKey(key, static_cast<uint32_t>(rasterizationStateCI.cullMode));
+        AppendKey(key, static_cast<uint32_t>(rasterizationStateCI.frontFace));
+        AppendKey(key, rasterizationStateCI.depthBiasEnable);
+        AppendKey(key, rasterizationStateCI.depthBiasConstantFactor);
+        AppendKey(key, rasterizationStateCI.depthBiasClamp);
+        AppendKey(key, rasterizationStateCI.depthBiasSlopeFactor);
+        AppendKey(key, rasterizationStateCI.lineWidth);
 
-            vk::ShaderModule shaderModule = device.createShaderModule(shaderModuleCI);
+        AppendKey(key, static_cast<uint32_t>(multisampleStateCI.rasterizationSamples));
+        AppendKey(key, multisampleStateCI.sampleShadingEnable);
+        AppendKey(key, multisampleStateCI.minSampleShading);
+        AppendKey(key, multisampleStateCI.pSampleMask != nullptr);
+        if (multisampleStateCI.pSampleMask)
+        {
+            const uint32_t words = (static_cast<uint32_t>(multisampleStateCI.rasterizationSamples) + 31) / 32;
+            for (uint32_t i = 0; i < words; ++i)
+                AppendKey(key, multisampleStateCI.pSampleMask[i]);
+        }
+        AppendKey(key, multisampleStateCI.alphaToCoverageEnable);
+        AppendKey(key, multisampleStateCI.alphaToOneEnable);
 
-            delete[] shaderCode;
-            return shaderModule;
+        AppendKey(key, depthStencilStateCI.depthTestEnable);
+        AppendKey(key, depthStencilStateCI.depthWriteEnable);
+        AppendKey(key, static_cast<uint32_t>(depthStencilStateCI.depthCompareOp));
+        AppendKey(key, depthStencilStateCI.depthBoundsTestEnable);
+        AppendKey(key, depthStencilStateCI.stencilTestEnable);
+        for (const auto& op : { depthStencilStateCI.front, depthStencilStateCI.back })
+        {
+            AppendKey(key, static_cast<uint32_t>(op.failOp));
+            AppendKey(key, static_cast<uint32_t>(op.passOp));
+            AppendKey(key, static_cast<uint32_t>(op.depthFailOp));
+            AppendKey(key, static_cast<uint32_t>(op.compareOp));
+            AppendKey(key, op.compareMask);
+            AppendKey(key, op.writeMask);
+            AppendKey(key, op.reference);
+        }
+        AppendKey(key, depthStencilStateCI.minDepthBounds);
+        AppendKey(key, depthStencilStateCI.maxDepthBounds);
+
+        AppendKey(key, colorBlendStateCI.logicOpEnable);
+        AppendKey(key, static_cast<uint32_t>(colorBlendStateCI.logicOp));
+        AppendKey(key, colorBlendStateCI.attachmentCount);
+        for (uint32_t i = 0; i < colorBlendStateCI.attachmentCount; ++i)
+        {
+            const auto& attachment = colorBlendStateCI.pAttachments[i];
+            AppendKey(key, attachment.blendEnable);
+            AppendKey(key, static_cast<uint32_t>(attachment.srcColorBlendFactor));
+            AppendKey(key, static_cast<uint32_t>(attachment.dstColorBlendFactor));
+            AppendKey(key, static_cast<uint32_t>(attachment.colorBlendOp));
+            AppendKey(key, static_cast<uint32_t>(attachment.srcAlphaBlendFactor));
+            AppendKey(key, static_cast<uint32_t>(attachment.dstAlphaBlendFactor));
+            AppendKey(key, static_cast<uint32_t>(attachment.alphaBlendOp));
+            AppendKey(key, static_cast<uint32_t>(attachment.colorWriteMask));
         }
-        else
+        for (float constant : colorBlendStateCI.blendConstants)
+            AppendKey(key, constant);
+
+        AppendKey(key, dynamicStateCI.dynamicStateCount);
+        for (uint32_t i = 0; i < dynamicStateCI.dynamicStateCount; ++i)
+            AppendKey(key, static_cast<uint32_t>(dynamicStateCI.pDynamicStates[i]));
+    }
+
+    void PipelineBuilder::AppendLayoutKey(std::string& key) const
+    {
+        AppendKey(key, static_cast<uint32_t>(layoutCI.flags));
+        AppendKey(key, layoutCI.setLayoutCount);
+        for (uint32_t i = 0; i < layoutCI.setLayoutCount; ++i)
+            AppendKey(key, static_cast<VkDescriptorSetLayout>(layoutCI.pSetLayouts[i]));
+        AppendKey(key, layoutCI.pushConstantRangeCount);
+        for (uint32_t i = 0; i < layoutCI.pushConstantRangeCount; ++i)
         {
-            spdlog::error("Could not open shader file {}", filename);
-            return nullptr;
+            const auto& range = layoutCI.pPushConstantRanges[i];
+            AppendKey(key, static_cast<uint32_t>(range.stageFlags));
+            AppendKey(key, range.offset);
+            AppendKey(key, range.size);
         }
     }
+
+    bool PipelineBuilder::HasExtensions() const
+    {
+        return vertexInputStateCI.pNext || inputAssemblyStateCI.pNext || tessellationDomainOriginStateCI.pNext
+            || tessellationStateCI.pNext != &tessellationDomainOriginStateCI || viewportStateCI.pNext
+            || rasterizationStateCI.pNext || multisampleStateCI.pNext || depthStencilStateCI.pNext
+            || colorBlendStateCI.pNext || dynamicStateCI.pNext || layoutCI.pNext;
+    }
 }
@@ -2,6 +2,8 @@
 
 #include "Common.h"
 
+#include <map>
+
 namespace jgw
 {
     class PipelineBuilder
@@ -11,8 +13,6 @@ namespace jgw
 
         PipelineBuilder() = default;
 
-        std::vector<vk::PipelineShaderStageCreateInfo> BuildShaderStages(const vk::Device& device);
-
         void AddShader(vk::ShaderStageFlagBits flag, std::string filename)
         {
             shaderFiles.emplace(flag, filename);
@@ -35,9 +35,19 @@ namespace jgw
         vk::PipelineDynamicStateCreateInfo& DynamicStateCI() { return dynamicStateCI; }
         vk::PipelineLayoutCreateInfo& PipelineLayoutCI() { return layoutCI; }
 
+        // Ordered by stage, so the stages of equal builders always come out the same
+        const std::map<vk::ShaderStageFlagBits, std::string>& ShaderFiles() const { return shaderFiles; }
+
+        // Canonical bytes of the fixed function state and of the layout, equal keys create identical objects.
+        // Shaders are keyed by the caller, which knows their code.
+        void AppendStateKey(std::string& key) const;
+        void AppendLayoutKey(std::string& key) const;
+
+        // Extension structs are not part of the keys, pipelines using them are never shared
+        bool HasExtensions() const;
+
     private:
-        std::unordered_map<vk::ShaderStageFlagBits, std::string> shaderFiles;
-        vk::ShaderModule LoadShader(const char* filename, const vk::Device& device);
+        std::map<vk::ShaderStageFlagBits, std::string> shaderFiles;
 
         vk::PipelineVertexInputStateCreateInfo vertexInputStateCI{
             .vertexBindingDescriptionCount = 0,
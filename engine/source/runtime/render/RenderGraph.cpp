@@ -0,0 +1,610 @@
+#include "RenderGraph.h"
+#include "VulkanContext.h"
+#include "Hash.h"
+
+#include <algorithm>
+#include <array>
+
+namespace jgw
+{
+    static constexpr uint32_t kMaxColorAttachments = 8;
+
+    static constexpr vk::AccessFlags2 kWriteAccess =
+        vk::AccessFlagBits2::eColorAttachmentWrite |
+        vk::AccessFlagBits2::eDepthStencilAttachmentWrite |
+        vk::AccessFlagBits2::eShaderWrite |
+        vk::AccessFlagBits2::eShaderStorageWrite |
+        vk::AccessFlagBits2::eTransferWrite |
+        vk::AccessFlagBits2::eHostWrite |
+        vk::AccessFlagBits2::eMemoryWrite;
+
+    static vk::ImageAspectFlags GetAspectMask(vk::Format format)
+    {
+        switch (format)
+        {
+        case vk::Format::eD16Unorm:
+        case vk::Format::eX8D24UnormPack32:
+        case vk::Format::eD32Sfloat:
+            return vk::ImageAspectFlagBits::eDepth;
+        case vk::Format::eD16UnormS8Uint:
+        case vk::Format::eD24UnormS8Uint:
+        case vk::Format::eD32SfloatS8Uint:
+            return vk::ImageAspectFlagBits::eDepth | vk::ImageAspectFlagBits::eStencil;
+        case vk::Format::eS8Uint:
+            return vk::ImageAspectFlagBits::eStencil;
+        default:
+            return vk::ImageAspectFlagBits::eColor;
+        }
+    }
+
+    RenderGraphPass& RenderGraphPass::WriteColor(RenderResource resource, std::optional<vk::ClearColorValue> clearValue)
+    {
+        vk::ClearValue value{};
+        if (clearValue)
+            value.color = *clearValue;
+
+        accesses.push_back({
+            .resource = resource,
+            .type = EAccess::ColorAttachment,
+            .stageMask = vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+            .clear = clearValue.has_value(),
+            .clearValue = value
+        });
+        return *this;
+    }
+
+    RenderGraphPass& RenderGraphPass::WriteDepth(RenderResource resource, std::optional<vk::ClearDepthStencilValue> clearValue)
+    {
+        vk::ClearValue value{};
+        if (clearValue)
+            value.depthStencil = *clearValue;
+
+        accesses.push_back({
+            .resource = resource,
+            .type = EAccess::DepthAttachment,
+            .stageMask = vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests,
+            .clear = clearValue.has_value(),
+            .clearValue = value
+        });
+        return *this;
+    }
+
+    RenderGraphPass& RenderGraphPass::Sample(RenderResource resource, vk::PipelineStageFlags2 stageMask)
+    {
+        accesses.push_back({
+            .resource = resource,
+            .type = EAccess::Sampled,
+            .stageMask = stageMask
+        });
+        return *this;
+    }
+
+    RenderGraphPass& RenderGraphPass::SetRenderingFlags(vk::RenderingFlags flags)
+    {
+        renderingFlags = flags;
+        return *this;
+    }
+
+    RenderGraphPass& RenderGraphPass::SetSideEffect()
+    {
+        sideEffect = true;
+        return *this;
+    }
+
+    RenderGraphPass& RenderGraphPass::SetExecute(std::function<void(vk::CommandBuffer)> callback)
+    {
+        execute = std::move(callback);
+        return *this;
+    }
+
+    RenderGraph::RenderGraph(VulkanContext& context)
+        : context(context)
+    {
+    }
+
+    RenderGraph::~RenderGraph()
+    {
+        DestroyTransients();
+    }
+
+    void RenderGraph::Reset()
+    {
+        resources.clear();
+        for (uint32_t i = 0; i < passCount; ++i)
+        {
+            passes[i].execute = nullptr;
+        }
+        passCount = 0;
+    }
+
+    RenderResource RenderGraph::Import(const char* name, const ImportedImageDesc& desc)
+    {
+        resources.push_back({
+            .name = name,
+            .image = desc.image,
+            .view = desc.view,
+            .format = desc.format,
+            .extent = desc.extent,
+            .aspectMask = desc.aspectMask,
+            .state = desc.initialState,
+            .finalLayout = desc.finalLayout,
+            .imported = true,
+            .defined = desc.initialState.layout != vk::ImageLayout::eUndefined
+        });
+        return static_cast<RenderResource>(resources.size() - 1);
+    }
+
+    RenderResource RenderGraph::CreateTransient(const char* name, const TransientImageDesc& desc)
+    {
+        resources.push_back({
+            .name = name,
+            .format = desc.format,
+            .extent = desc.extent,
+            .aspectMask = GetAspectMask(desc.format),
+            .usageFlags = desc.usageFlags
+        });
+        return static_cast<RenderResource>(resources.size() - 1);
+    }
+
+    RenderGraphPass& RenderGraph::AddPass(const char* name)
+    {
+        if (passCount == passes.size())
+            passes.emplace_back();
+
+        RenderGraphPass& pass = passes[passCount++];
+        pass.name = name;
+        pass.accesses.clear();
+        pass.renderingFlags = {};
+        pass.execute = nullptr;
+        pass.sideEffect = false;
+        pass.culled = false;
+        return pass;
+    }
+
+    void RenderGraph::Execute(vk::CommandBuffer commandBuffer)
+    {
+        Cull();
+        ComputeLifetimes();
+
+        stats.passes = passCount;
+        stats.culledPasses = 0;
+        stats.barrierBatches = 0;
+        stats.imageBarriers = 0;
+
+        if (AllocateTransients())
+        {
+            for (uint32_t i = 0; i < passCount; ++i)
+            {
+                if (passes[i].culled)
+                {
+                    ++stats.culledPasses;
+                    continue;
+                }
+                RecordPass(commandBuffer, i);
+            }
+        }
+
+        // Hand imported images back in the layout their owner expects
+        for (auto& resource : resources)
+        {
+            if (resource.imported && resource.finalLayout != vk::ImageLayout::eUndefined && resource.state.layout != resource.finalLayout)
+                AddBarrier(resource, resource.finalLayout, vk::PipelineStageFlagBits2::eNone, vk::AccessFlagBits2::eNone, false);
+        }
+        FlushBarriers(commandBuffer);
+    }
+
+    void RenderGraph::Cull()
+    {
+        // Walk backwards from the imported images whose contents outlive the graph
+        for (auto& resource : resources)
+        {
+            resource.needed = resource.imported && resource.finalLayout != vk::ImageLayout::eUndefined;
+        }
+
+        for (uint32_t i = passCount; i-- > 0;)
+        {
+            RenderGraphPass& pass = passes[i];
+
+            bool alive = pass.sideEffect;
+            for (const auto& access : pass.accesses)
+            {
+                if (pass.IsWrite(access) && resources[access.resource].needed)
+                    alive = true;
+            }
+
+            pass.culled = !alive;
+            if (!alive)
+                continue;
+
+            for (auto& access : pass.accesses)
+            {
+                if (!pass.IsWrite(access))
+                    continue;
+
+                access.store = resources[access.resource].needed;
+
+                // A clear overwrites everything earlier passes wrote
+                if (access.clear)
+                    resources[access.resource].needed = false;
+            }
+
+            for (const auto& access : pass.accesses)
+            {
+                if (!pass.IsWrite(access) || !access.clear)
+                    resources[access.resource].needed = true;
+            }
+        }
+    }
+
+    void RenderGraph::ComputeLifetimes()
+    {
+        for (auto& resource : resources)
+        {
+            resource.firstPass = UINT32_MAX;
+            resource.lastPass = 0;
+            resource.transient = UINT32_MAX;
+        }
+
+        for (uint32_t i = 0; i < passCount; ++i)
+        {
+            const RenderGraphPass& pass = passes[i];
+            if (pass.culled)
+                continue;
+
+            for (const auto& access : pass.accesses)
+            {
+                Resource& resource = resources[access.resource];
+                if (resource.imported)
+                    continue;
+
+                resource.firstPass = std::min(resource.firstPass, i);
+                resource.lastPass = std::max(resource.lastPass, i);
+
+                switch (access.type)
+                {
+                case RenderGraphPass::EAccess::ColorAttachment:
+                    resource.usageFlags |= vk::ImageUsageFlagBits::eColorAttachment;
+                    break;
+                case RenderGraphPass::EAccess::DepthAttachment:
+                    resource.usageFlags |= vk::ImageUsageFlagBits::eDepthStencilAttachment;
+                    break;
+                case RenderGraphPass::EAccess::Sampled:
+                    resource.usageFlags |= vk::ImageUsageFlagBits::eSampled;
+                    break;
+                }
+            }
+        }
+    }
+
+    bool RenderGraph::AllocateTransients()
+    {
+        transientOrder.clear();
+        for (uint32_t i = 0; i < resources.size(); ++i)
+        {
+            if (!resources[i].imported && resources[i].firstPass != UINT32_MAX)
+                transientOrder.push_back(i);
+        }
+
+        std::stable_sort(transientOrder.begin(), transientOrder.end(), [&](uint32_t a, uint32_t b) {
+            return resources[a].firstPass < resources[b].firstPass;
+        });
+
+        uint64_t key = kHashSeed;
+        for (uint32_t index : transientOrder)
+        {
+            const Resource& resource = resources[index];
+            HashCombine(key, static_cast<uint32_t>(resource.format));
+            HashCombine(key, resource.extent.width);
+            HashCombine(key, resource.extent.height);
+            HashCombine(key, static_cast<uint32_t>(resource.usageFlags));
+            HashCombine(key, resource.firstPass);
+            HashCombine(key, resource.lastPass);
+        }
+
+        // The aliasing only changes with the frame graph itself, usually on resize
+        if (key != transientKey || transientImages.size() != transientOrder.size())
+        {
+            DestroyTransients();
+
+            try
+            {
+                stats.unaliasedBytes = 0;
+                for (uint32_t index : transientOrder)
+                {
+                    const Resource& resource = resources[index];
+                    const TextureDesc desc{
+                        .usageFlags = resource.usageFlags,
+                        .format = resource.format,
+                        .extent = { .width = resource.extent.width, .height = resource.extent.height, .depth = 1 }
+                    };
+
+                    TransientImage transient{
+                        .image = context.GetDevice().createImage(VulkanTexture::BuildImageCI(desc))
+                    };
+                    const vk::MemoryRequirements requirements = context.GetDevice().getImageMemoryRequirements(transient.image);
+                    stats.unaliasedBytes += requirements.size;
+
+                    // Among the slots whose last user is done before this image is first used, take the
+                    // smallest one that already fits, or else the largest one to grow
+                    auto better = [&](const MemorySlot& a, const MemorySlot& b) {
+                        const bool aFits = a.requirements.size >= requirements.size;
+                        const bool bFits = b.requirements.size >= requirements.size;
+                        if (aFits != bFits)
+                            return aFits;
+                        return aFits ? a.requirements.size < b.requirements.size : a.requirements.size > b.requirements.size;
+                    };
+
+                    uint32_t best = UINT32_MAX;
+                    for (uint32_t slot = 0; slot < memorySlots.size(); ++slot)
+                    {
+                        const MemorySlot& candidate = memorySlots[slot];
+                        if (candidate.lastPass >= resource.firstPass || !(candidate.requirements.memoryTypeBits & requirements.memoryTypeBits))
+                            continue;
+
+                        if (best == UINT32_MAX || better(candidate, memorySlots[best]))
+                            best = slot;
+                    }
+
+                    if (best == UINT32_MAX)
+                    {
+                        best = static_cast<uint32_t>(memorySlots.size());
+                        memorySlots.push_back({ .requirements = requirements });
+                    }
+                    else
+                    {
+                        MemorySlot& slot = memorySlots[best];
+                        slot.requirements.size = std::max(slot.requirements.size, requirements.size);
+                        slot.requirements.alignment = std::max(slot.requirements.alignment, requirements.alignment);
+                        slot.requirements.memoryTypeBits &= requirements.memoryTypeBits;
+                    }
+
+                    memorySlots[best].lastPass = resource.lastPass;
+                    transient.slot = best;
+                    transientImages.push_back(transient);
+                }
+
+                for (auto& slot : memorySlots)
+                {
+                    slot.allocation = context.AllocateImageMemory(slot.requirements);
+                    if (!slot.allocation)
+                        throw std::runtime_error("Failed to allocate transient image memory");
+                }
+
+                for (uint32_t i = 0; i < transientOrder.size(); ++i)
+                {
+                    const Resource& resource = resources[transientOrder[i]];
+                    TransientImage& transient = transientImages[i];
+                    context.BindImageMemory(memorySlots[transient.slot].allocation, transient.image);
+
+                    vk::ImageViewCreateInfo imageViewCI{
+                        .image = transient.image,
+                        .viewType = vk::ImageViewType::e2D,
+                        .format = resource.format,
+                        .subresourceRange = {
+                            .aspectMask = resource.aspectMask,
+                            .baseMipLevel = 0,
+                            .levelCount = 1,
+                            .baseArrayLayer = 0,
+                            .layerCount = 1
+                        }
+                    };
+                    transient.view = context.GetDevice().createImageView(imageViewCI);
+                }
+            }
+            catch (const std::exception& err)
+            {
+                spdlog::error("Render graph: {}", err.what());
+                DestroyTransients();
+                return false;
+            }
+
+            transientKey = key;
+            stats.transientImages = static_cast<uint32_t>(transientImages.size());
+            stats.transientAllocations = static_cast<uint32_t>(memorySlots.size());
+            stats.transientBytes = 0;
+            for (const auto& slot : memorySlots)
+            {
+                stats.transientBytes += slot.requirements.size;
+            }
+        }
+
+        for (uint32_t i = 0; i < transientOrder.size(); ++i)
+        {
+            Resource& resource = resources[transientOrder[i]];
+            resource.image = transientImages[i].image;
+            resource.view = transientImages[i].view;
+            resource.transient = i;
+        }
+
+        return true;
+    }
+
+    void RenderGraph::DestroyTransients()
+    {
+        if (transientImages.empty() && memorySlots.empty())
+            return;
+
+        // Frames in flight may still use the images, they are destroyed once the current frame has completed
+        for (auto& transient : transientImages)
+        {
+            context.DeferDestroy(transient.view);
+            context.DeferDestroy(transient.image);
+        }
+        for (auto& slot : memorySlots)
+        {
+            if (slot.allocation)
+                context.DeferDestroy(slot.allocation);
+        }
+
+        transientImages.clear();
+        memorySlots.clear();
+        transientKey = 0;
+    }
+
+    void RenderGraph::RecordPass(vk::CommandBuffer commandBuffer, uint32_t passIndex)
+    {
+        RenderGraphPass& pass = passes[passIndex];
+
+        std::array<vk::RenderingAttachmentInfo, kMaxColorAttachments> colorAttachments{};
+        uint32_t colorAttachmentCount = 0;
+        vk::RenderingAttachmentInfo depthAttachment{};
+        bool hasDepth = false;
+        bool hasStencil = false;
+        vk::Extent2D extent{};
+
+        for (const auto& access : pass.accesses)
+        {
+            Resource& resource = resources[access.resource];
+
+            // Aliased memory keeps nothing of the previous image but its accesses still have to complete
+            if (resource.transient != UINT32_MAX && resource.firstPass == passIndex && !resource.defined)
+            {
+                const MemorySlot& slot = memorySlots[transientImages[resource.transient].slot];
+                resource.state = {
+                    .layout = vk::ImageLayout::eUndefined,
+                    .stageMask = slot.state.stageMask,
+                    .accessMask = slot.state.accessMask
+                };
+            }
+
+            const vk::AttachmentLoadOp loadOp = access.clear ? vk::AttachmentLoadOp::eClear :
+                resource.defined ? vk::AttachmentLoadOp::eLoad : vk::AttachmentLoadOp::eDontCare;
+            const vk::AttachmentStoreOp storeOp = access.store ? vk::AttachmentStoreOp::eStore : vk::AttachmentStoreOp::eDontCare;
+            const bool discard = loadOp != vk::AttachmentLoadOp::eLoad;
+
+            switch (access.type)
+            {
+            case RenderGraphPass::EAccess::ColorAttachment:
+            {
+                assert(colorAttachmentCount < kMaxColorAttachments);
+                vk::AccessFlags2 accessMask = vk::AccessFlagBits2::eColorAttachmentWrite;
+                if (loadOp == vk::AttachmentLoadOp::eLoad)
+                    accessMask |= vk::AccessFlagBits2::eColorAttachmentRead;
+                AddBarrier(resource, vk::ImageLayout::eColorAttachmentOptimal, access.stageMask, accessMask, discard);
+
+                colorAttachments[colorAttachmentCount++] = {
+                    .imageView = resource.view,
+                    .imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
+                    .loadOp = loadOp,
+                    .storeOp = storeOp,
+                    .clearValue = access.clearValue
+                };
+                extent = resource.extent;
+                break;
+            }
+            case RenderGraphPass::EAccess::DepthAttachment:
+            {
+                hasStencil = static_cast<bool>(resource.aspectMask & vk::ImageAspectFlagBits::eStencil);
+                const vk::ImageLayout layout = hasStencil ? vk::ImageLayout::eDepthStencilAttachmentOptimal : vk::ImageLayout::eDepthAttachmentOptimal;
+                AddBarrier(resource, layout, access.stageMask,
+                    vk::AccessFlagBits2::eDepthStencilAttachmentRead | vk::AccessFlagBits2::eDepthStencilAttachmentWrite, discard);
+
+                depthAttachment = {
+                    .imageView = resource.view,
+                    .imageLayout = layout,
+                    .loadOp = loadOp,
+                    .storeOp = storeOp,
+                    .clearValue = access.clearValue
+                };
+                hasDepth = true;
+                extent = resource.extent;
+                break;
+            }
+            case RenderGraphPass::EAccess::Sampled:
+                AddBarrier(resource, vk::ImageLayout::eShaderReadOnlyOptimal, access.stageMask, vk::AccessFlagBits2::eShaderSampledRead, false);
+                break;
+            }
+        }
+
+        FlushBarriers(commandBuffer);
+
+        for (const auto& access : pass.accesses)
+        {
+            if (pass.IsWrite(access))
+                resources[access.resource].defined = access.store;
+        }
+
+        if (colorAttachmentCount > 0 || hasDepth)
+        {
+            vk::RenderingInfo renderInfo{
+                .flags = pass.renderingFlags,
+                .renderArea = { .offset = { 0, 0 }, .extent = extent },
+                .layerCount = 1,
+                .colorAttachmentCount = colorAttachmentCount,
+                .pColorAttachments = colorAttachments.data(),
+                .pDepthAttachment = hasDepth ? &depthAttachment : nullptr,
+                .pStencilAttachment = hasStencil ? &depthAttachment : nullptr
+            };
+
+            commandBuffer.beginRendering(renderInfo);
+            if (pass.execute)
+                pass.execute(commandBuffer);
+            commandBuffer.endRendering();
+        }
+        else if (pass.execute)
+        {
+            pass.execute(commandBuffer);
+        }
+
+        // The next image placed in the same memory waits for the last accesses of this one
+        for (const auto& access : pass.accesses)
+        {
+            const Resource& resource = resources[access.resource];
+            if (resource.transient != UINT32_MAX && resource.lastPass == passIndex)
+                memorySlots[transientImages[resource.transient].slot].state = resource.state;
+        }
+    }
+
+    void RenderGraph::AddBarrier(Resource& resource, vk::ImageLayout layout, vk::PipelineStageFlags2 stageMask, vk::AccessFlags2 accessMask, bool discard)
+    {
+        const bool layoutChange = resource.state.layout != layout;
+        const bool hazard = (resource.state.accessMask & kWriteAccess) || (accessMask & kWriteAccess);
+
+        // Reads in the same layout only widen the scope later writes have to wait for
+        if (!layoutChange && (!hazard || !resource.state.stageMask))
+        {
+            resource.state.stageMask |= stageMask;
+            resource.state.accessMask |= accessMask;
+            return;
+        }
+
+        barriers.push_back({
+            .srcStageMask = resource.state.stageMask,
+            .srcAccessMask = resource.state.accessMask & kWriteAccess,
+            .dstStageMask = stageMask,
+            .dstAccessMask = accessMask,
+            .oldLayout = discard ? vk::ImageLayout::eUndefined : resource.state.layout,
+            .newLayout = layout,
+            .image = resource.image,
+            .subresourceRange = {
+                .aspectMask = resource.aspectMask,
+                .baseMipLevel = 0,
+                .levelCount = VK_REMAINING_MIP_LEVELS,
+                .baseArrayLayer = 0,
+                .layerCount = VK_REMAINING_ARRAY_LAYERS
+            }
+        });
+
+        resource.state = {
+            .layout = layout,
+            .stageMask = stageMask,
+            .accessMask = accessMask
+        };
+    }
+
+    void RenderGraph::FlushBarriers(vk::CommandBuffer commandBuffer)
+    {
+        if (barriers.empty())
+            return;
+
+        vk::DependencyInfo dependencyInfo{
+            .imageMemoryBarrierCount = static_cast<uint32_t>(barriers.size()),
+            .pImageMemoryBarriers = barriers.data()
+        };
+        commandBuffer.pipelineBarrier2(dependencyInfo);
+
+        ++stats.barrierBatches;
+        stats.imageBarriers += static_cast<uint32_t>(barriers.size());
+        barriers.clear();
+    }
+}
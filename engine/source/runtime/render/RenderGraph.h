@@ -0,0 +1,202 @@
+#pragma once
+
+#include "Common.h"
+
+#include <functional>
+#include <optional>
+
+namespace jgw
+{
+    class VulkanContext;
+
+    using RenderResource = uint32_t;
+    constexpr RenderResource kInvalidRenderResource = UINT32_MAX;
+
+    // Layout of an image and the accesses that have to complete before the graph may touch it
+    struct RenderResourceState
+    {
+        vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+        vk::PipelineStageFlags2 stageMask = vk::PipelineStageFlagBits2::eNone;
+        vk::AccessFlags2 accessMask = vk::AccessFlagBits2::eNone;
+    };
+
+    // Image owned outside of the graph, such as a swapchain image
+    struct ImportedImageDesc
+    {
+        vk::Image image{};
+        vk::ImageView view{};
+        vk::Format format = vk::Format::eUndefined;
+        vk::Extent2D extent{};
+        vk::ImageAspectFlags aspectMask = vk::ImageAspectFlagBits::eColor;
+        RenderResourceState initialState{};
+
+        // Layout once the graph has executed, eUndefined if the contents are not needed afterwards
+        vk::ImageLayout finalLayout = vk::ImageLayout::eUndefined;
+    };
+
+    // Image that only lives while the graph executes, its memory may be shared with other transient images
+    struct TransientImageDesc
+    {
+        vk::Format format = vk::Format::eUndefined;
+        vk::Extent2D extent{};
+
+        // Attachment and sampled usage is derived from the passes
+        vk::ImageUsageFlags usageFlags = {};
+    };
+
+    struct RenderGraphStats
+    {
+        uint32_t passes = 0;
+        uint32_t culledPasses = 0;
+        uint32_t barrierBatches = 0;
+        uint32_t imageBarriers = 0;
+        uint32_t transientImages = 0;
+        uint32_t transientAllocations = 0;
+
+        // Memory of the transient images with and without aliasing
+        vk::DeviceSize transientBytes = 0;
+        vk::DeviceSize unaliasedBytes = 0;
+    };
+
+    class RenderGraphPass final
+    {
+        friend class RenderGraph;
+
+    public:
+        // Without a clear value the previous contents are loaded, or left undefined if there are none
+        RenderGraphPass& WriteColor(RenderResource resource, std::optional<vk::ClearColorValue> clearValue = std::nullopt);
+        RenderGraphPass& WriteDepth(RenderResource resource, std::optional<vk::ClearDepthStencilValue> clearValue = std::nullopt);
+        RenderGraphPass& Sample(RenderResource resource, vk::PipelineStageFlags2 stageMask = vk::PipelineStageFlagBits2::eFragmentShader);
+
+        RenderGraphPass& SetRenderingFlags(vk::RenderingFlags flags);
+
+        // Passes whose results are consumed outside of the graph are never culled
+        RenderGraphPass& SetSideEffect();
+
+        // Recorded inside dynamic rendering when the pass writes attachments
+        RenderGraphPass& SetExecute(std::function<void(vk::CommandBuffer)> execute);
+
+    private:
+        enum class EAccess : uint32_t
+        {
+            ColorAttachment,
+            DepthAttachment,
+            Sampled
+        };
+
+        struct Access
+        {
+            RenderResource resource = kInvalidRenderResource;
+            EAccess type = EAccess::Sampled;
+            vk::PipelineStageFlags2 stageMask = {};
+            bool clear = false;
+            vk::ClearValue clearValue{};
+
+            // Set by the graph, a later pass or the owner of an imported image reads the contents
+            bool store = false;
+        };
+
+        bool IsWrite(const Access& access) const { return access.type != EAccess::Sampled; }
+
+        const char* name = nullptr;
+        std::vector<Access> accesses;
+        vk::RenderingFlags renderingFlags = {};
+        std::function<void(vk::CommandBuffer)> execute;
+        bool sideEffect = false;
+        bool culled = false;
+    };
+
+    // Frame graph rebuilt every frame. Passes declare the images they write and sample, from which the graph
+    // culls passes nobody consumes, picks load and store ops, batches the synchronization2 barriers in front
+    // of each pass and lets transient images with disjoint lifetimes share memory.
+    class RenderGraph final
+    {
+    public:
+        CLASS_COPY_MOVE_DELETE(RenderGraph)
+
+        explicit RenderGraph(VulkanContext& context);
+        ~RenderGraph();
+
+        // Drops the passes and resources of the last frame, transient images are kept for reuse
+        void Reset();
+
+        RenderResource Import(const char* name, const ImportedImageDesc& desc);
+        RenderResource CreateTransient(const char* name, const TransientImageDesc& desc);
+
+        // The reference is valid until the next AddPass
+        RenderGraphPass& AddPass(const char* name);
+
+        void Execute(vk::CommandBuffer commandBuffer);
+
+        // Transient images only exist once Execute has started, so these are meant for pass callbacks
+        vk::Image GetImage(RenderResource resource) const { return resources[resource].image; }
+        vk::ImageView GetView(RenderResource resource) const { return resources[resource].view; }
+        vk::Format GetFormat(RenderResource resource) const { return resources[resource].format; }
+        vk::Extent2D GetExtent(RenderResource resource) const { return resources[resource].extent; }
+
+        RenderGraphStats GetStats() const { return stats; }
+
+    private:
+        struct Resource
+        {
+            const char* name = nullptr;
+            vk::Image image{};
+            vk::ImageView view{};
+            vk::Format format = vk::Format::eUndefined;
+            vk::Extent2D extent{};
+            vk::ImageAspectFlags aspectMask = {};
+            vk::ImageUsageFlags usageFlags = {};
+            RenderResourceState state{};
+            vk::ImageLayout finalLayout = vk::ImageLayout::eUndefined;
+            bool imported = false;
+
+            // Contents are valid at this point of the graph, and needed by a later pass while culling
+            bool defined = false;
+            bool needed = false;
+
+            // Lifetime over the passes that survive culling, transient images only
+            uint32_t firstPass = UINT32_MAX;
+            uint32_t lastPass = 0;
+            uint32_t transient = UINT32_MAX;
+        };
+
+        struct TransientImage
+        {
+            vk::Image image{};
+            vk::ImageView view{};
+            uint32_t slot = 0;
+        };
+
+        // Memory shared by transient images, the state is the last access of whichever image used it
+        struct MemorySlot
+        {
+            vma::Allocation allocation{};
+            vk::MemoryRequirements requirements{};
+            uint32_t lastPass = 0;
+            RenderResourceState state{};
+        };
+
+        void Cull();
+        void ComputeLifetimes();
+        bool AllocateTransients();
+        void DestroyTransients();
+        void RecordPass(vk::CommandBuffer commandBuffer, uint32_t passIndex);
+        void AddBarrier(Resource& resource, vk::ImageLayout layout, vk::PipelineStageFlags2 stageMask, vk::AccessFlags2 accessMask, bool discard);
+        void FlushBarriers(vk::CommandBuffer commandBuffer);
+
+        VulkanContext& context;
+
+        std::vector<Resource> resources;
+        std::vector<RenderGraphPass> passes;
+        uint32_t passCount = 0;
+
+        // Aliased images of the last allocation, reused while the transient descs and lifetimes stay the same
+        std::vector<TransientImage> transientImages;
+        std::vector<MemorySlot> memorySlots;
+        std::vector<uint32_t> transientOrder;
+        uint64_t transientKey = 0;
+
+        std::vector<vk::ImageMemoryBarrier2> barriers;
+        RenderGraphStats stats{};
+    };
+}
@@ -0,0 +1,539 @@
+#include "ResidencyManager.h"
+#include "VulkanContext.h"
+
+#include <algorithm>
+
+namespace jgw
+{
+    static void ImageBarrier(
+        vk::CommandBuffer commandBuffer,
+        vk::Image image,
+        const TextureDesc& desc,
+        vk::ImageLayout oldLayout,
+        vk::ImageLayout newLayout
+    )
+    {
+        vk::ImageMemoryBarrier barrier{
+            .srcAccessMask = vk::AccessFlagBits::eMemoryWrite,
+            .dstAccessMask = vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eMemoryWrite,
+            .oldLayout = oldLayout,
+            .newLayout = newLayout,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = image,
+            .subresourceRange = {
+                .aspectMask = desc.aspectMask,
+                .baseMipLevel = 0,
+                .levelCount = desc.mipLevels,
+                .baseArrayLayer = 0,
+                .layerCount = desc.arrayLayers
+            }
+        };
+
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eAllCommands, {}, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+
+    // Host buffer layout of the evicted mips, each level aligned to 16 bytes
+    static std::vector<vk::BufferImageCopy> EvictedMipRegions(const TextureDesc& desc, uint32_t mipCount, vk::DeviceSize& totalSize)
+    {
+        const uint32_t texelSize = VulkanTexture::GetTexelSize(desc.format);
+
+        std::vector<vk::BufferImageCopy> regions;
+        totalSize = 0;
+        for (uint32_t level = 0; level < mipCount; ++level)
+        {
+            const vk::Extent3D extent = VulkanTexture::GetMipExtent(desc.extent, level);
+            regions.push_back({
+                .bufferOffset = totalSize,
+                .bufferRowLength = 0,
+                .bufferImageHeight = 0,
+                .imageSubresource = {
+                    .aspectMask = desc.aspectMask,
+                    .mipLevel = level,
+                    .baseArrayLayer = 0,
+                    .layerCount = desc.arrayLayers
+                },
+                .imageOffset = { 0, 0, 0 },
+                .imageExtent = extent
+            });
+
+            const vk::DeviceSize levelSize = static_cast<vk::DeviceSize>(extent.width) * extent.height * extent.depth * desc.arrayLayers * texelSize;
+            totalSize += (levelSize + 15) & ~vk::DeviceSize(15);
+        }
+        return regions;
+    }
+
+    // Copies the mips shared by a full resolution image and its reduced copy
+    static std::vector<vk::ImageCopy> SharedMipRegions(const TextureDesc& fullDesc, uint32_t droppedMips)
+    {
+        std::vector<vk::ImageCopy> regions;
+        for (uint32_t level = droppedMips; level < fullDesc.mipLevels; ++level)
+        {
+            regions.push_back({
+                .srcSubresource = {
+                    .aspectMask = fullDesc.aspectMask,
+                    .mipLevel = level,
+                    .baseArrayLayer = 0,
+                    .layerCount = fullDesc.arrayLayers
+                },
+                .srcOffset = { 0, 0, 0 },
+                .dstSubresource = {
+                    .aspectMask = fullDesc.aspectMask,
+                    .mipLevel = level - droppedMips,
+                    .baseArrayLayer = 0,
+                    .layerCount = fullDesc.arrayLayers
+                },
+                .dstOffset = { 0, 0, 0 },
+                .extent = VulkanTexture::GetMipExtent(fullDesc.extent, level)
+            });
+        }
+        return regions;
+    }
+
+    // Makes the copies of a batch visible to everything recorded after it
+    static void TransferBarrier(vk::CommandBuffer commandBuffer)
+    {
+        vk::MemoryBarrier barrier{
+            .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+            .dstAccessMask = vk::AccessFlagBits::eMemoryRead
+        };
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAllCommands, {}, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    ResidencyManager::ResidencyManager(VulkanContext& context)
+        : context(context)
+    {
+    }
+
+    void ResidencyManager::Register(VulkanBuffer* buffer)
+    {
+        // Temporary resources created while moving storage around are not tracked
+        if (busy)
+            buffer->residency = nullptr;
+        else
+            buffers.push_back(buffer);
+    }
+
+    void ResidencyManager::Register(VulkanTexture* texture)
+    {
+        if (busy)
+            texture->residency = nullptr;
+        else
+            textures.push_back(texture);
+    }
+
+    void ResidencyManager::Unregister(VulkanBuffer* buffer)
+    {
+        std::erase(buffers, buffer);
+        std::erase(pendingBuffers, buffer);
+
+        // The copy may still be running, the new storage goes away with the move once its frame has completed
+        for (auto& move : moves)
+        {
+            if (move.buffer == buffer)
+                move.buffer = nullptr;
+        }
+    }
+
+    void ResidencyManager::Unregister(VulkanTexture* texture)
+    {
+        std::erase(textures, texture);
+        std::erase(pendingTextures, texture);
+        std::erase(viewChanges, texture);
+
+        for (auto& move : moves)
+        {
+            if (move.texture == texture)
+                move.texture = nullptr;
+        }
+    }
+
+    void ResidencyManager::MarkUsed(VulkanBuffer* buffer, uint64_t frameIndex)
+    {
+        buffer->lastUsedFrame = frameIndex;
+        if (buffer->evicted && std::find(pendingBuffers.begin(), pendingBuffers.end(), buffer) == pendingBuffers.end())
+            pendingBuffers.push_back(buffer);
+    }
+
+    void ResidencyManager::MarkUsed(VulkanTexture* texture, uint64_t frameIndex)
+    {
+        texture->lastUsedFrame = frameIndex;
+        if (texture->evictedMips > 0 && std::find(pendingTextures.begin(), pendingTextures.end(), texture) == pendingTextures.end())
+            pendingTextures.push_back(texture);
+    }
+
+    void ResidencyManager::Update(vk::CommandBuffer commandBuffer, uint64_t frameIndex)
+    {
+        // Textures evicted while the last frame was recorded
+        for (auto* texture : viewChanges)
+            texture->onViewChanged(texture);
+        viewChanges.clear();
+
+        std::erase_if(moves, [&](Move& move) {
+            if (!context.IsFrameComplete(move.frame))
+                return false;
+
+            Complete(move, false);
+            return true;
+        });
+
+        // Usage does not reflect moves in flight yet, wait for them before deciding on more
+        if (!moves.empty())
+            return;
+
+        vk::DeviceSize usage = 0, budget = 0;
+        context.GetDeviceLocalBudget(usage, budget);
+        if (budget == 0)
+            return;
+
+        const vk::DeviceSize high = static_cast<vk::DeviceSize>(budget * config.highWatermark);
+        const vk::DeviceSize low = static_cast<vk::DeviceSize>(budget * config.lowWatermark);
+
+        if (usage > high)
+        {
+            SelectEvictions(usage - low, frameIndex, config.coldFrames, moves);
+        }
+        else
+        {
+            // Bring back what was used recently, as long as the budget allows it
+            try
+            {
+                for (uint32_t restores = 0; restores < config.maxRestoresPerFrame; ++restores)
+                {
+                    if (!pendingBuffers.empty())
+                    {
+                        VulkanBuffer* buffer = pendingBuffers.back();
+                        if (usage + buffer->size > low || buffer->defragmenting)
+                            break;
+
+                        moves.push_back(PrepareRestore(buffer));
+                        pendingBuffers.pop_back();
+                        usage += moves.back().newBuffer->vmaAllocationInfo.size;
+                    }
+                    else if (!pendingTextures.empty())
+                    {
+                        VulkanTexture* texture = pendingTextures.back();
+                        if (usage + texture->evictedData->size > low)
+                            break;
+
+                        moves.push_back(PrepareRestore(texture));
+                        pendingTextures.pop_back();
+                        usage += moves.back().newTexture->vmaAllocationInfo.size - texture->vmaAllocationInfo.size;
+                    }
+                    else
+                    {
+                        break;
+                    }
+                }
+            }
+            catch (const std::runtime_error& err)
+            {
+                // Stays pending, the budget is probably off
+                busy = false;
+                spdlog::warn("Residency: {}", err.what());
+            }
+        }
+
+        if (moves.empty())
+            return;
+
+        for (auto& move : moves)
+        {
+            Record(commandBuffer, move);
+            move.frame = frameIndex;
+        }
+        TransferBarrier(commandBuffer);
+    }
+
+    vk::DeviceSize ResidencyManager::EvictNow(vk::DeviceSize bytes, uint64_t frameIndex, uint64_t frameInFlight)
+    {
+        // Creating the smaller copies ran out of memory as well
+        if (busy)
+            return 0;
+
+        std::vector<Move> batch;
+        const vk::DeviceSize released = SelectEvictions(bytes, frameIndex, frameInFlight, batch);
+        if (batch.empty())
+            return 0;
+
+        context.ImmediateSubmit([&](vk::CommandBuffer commandBuffer) {
+            for (const auto& move : batch)
+                Record(commandBuffer, move);
+        });
+
+        // Everything submitted so far has completed and the frame being recorded does not use these,
+        // the old storage is released when the batch goes out of scope
+        for (auto& move : batch)
+            Complete(move, true);
+
+        return released;
+    }
+
+    bool ResidencyManager::IsMoving(const VulkanBuffer* buffer) const
+    {
+        return std::any_of(moves.begin(), moves.end(), [buffer](const Move& move) { return move.buffer == buffer; });
+    }
+
+    bool ResidencyManager::IsMoving(const VulkanTexture* texture) const
+    {
+        return std::any_of(moves.begin(), moves.end(), [texture](const Move& move) { return move.texture == texture; });
+    }
+
+    ResidencyStats ResidencyManager::GetStats() const
+    {
+        ResidencyStats stats{};
+        for (const auto* buffer : buffers)
+        {
+            if (buffer->evicted)
+            {
+                ++stats.evictedBuffers;
+                stats.hostBytes += buffer->size;
+            }
+        }
+        for (const auto* texture : textures)
+        {
+            if (texture->evictedMips > 0)
+            {
+                ++stats.evictedTextures;
+                stats.hostBytes += texture->evictedData->size;
+            }
+        }
+        return stats;
+    }
+
+    vk::DeviceSize ResidencyManager::SelectEvictions(vk::DeviceSize bytes, uint64_t frameIndex, uint64_t coldFrames, std::vector<Move>& selected)
+    {
+        struct Candidate
+        {
+            uint64_t lastUsedFrame;
+            VulkanBuffer* buffer;
+            VulkanTexture* texture;
+        };
+
+        std::vector<Candidate> candidates;
+        for (auto* buffer : buffers)
+        {
+            if (!buffer->evicted && CanEvict(buffer) && !IsMoving(buffer) && buffer->lastUsedFrame + coldFrames <= frameIndex)
+                candidates.push_back({ buffer->lastUsedFrame, buffer, nullptr });
+        }
+        for (auto* texture : textures)
+        {
+            if (texture->evictedMips == 0 && CanEvict(texture) && !IsMoving(texture) && texture->lastUsedFrame + coldFrames <= frameIndex)
+                candidates.push_back({ texture->lastUsedFrame, nullptr, texture });
+        }
+
+        // Coldest first
+        std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+            return a.lastUsedFrame < b.lastUsedFrame;
+        });
+
+        vk::DeviceSize released = 0;
+        for (const auto& candidate : candidates)
+        {
+            if (released >= bytes)
+                break;
+
+            try
+            {
+                selected.push_back(candidate.buffer ? PrepareEvict(candidate.buffer) : PrepareEvict(candidate.texture));
+                released += selected.back().released;
+            }
+            catch (const std::runtime_error& err)
+            {
+                busy = false;
+                spdlog::warn("Residency: {}", err.what());
+                break;
+            }
+        }
+
+        if (released > 0)
+            spdlog::info("Residency: releasing {} bytes of device memory", released);
+
+        return released;
+    }
+
+    ResidencyManager::Move ResidencyManager::PrepareEvict(VulkanBuffer* buffer)
+    {
+        busy = true;
+        Move move{
+            .buffer = buffer,
+            .newBuffer = context.CreateBuffer(buffer->size, buffer->bufferUsage, {}, vma::MemoryUsage::eAutoPreferHost),
+            .evict = true,
+            .released = buffer->vmaAllocationInfo.size
+        };
+        busy = false;
+
+        return move;
+    }
+
+    ResidencyManager::Move ResidencyManager::PrepareEvict(VulkanTexture* texture)
+    {
+        const TextureDesc& fullDesc = texture->desc;
+        const uint32_t droppedMips = config.evictedMipLevels;
+
+        TextureDesc reducedDesc = fullDesc;
+        reducedDesc.extent = VulkanTexture::GetMipExtent(fullDesc.extent, droppedMips);
+        reducedDesc.mipLevels = fullDesc.mipLevels - droppedMips;
+
+        vk::DeviceSize hostSize = 0;
+        EvictedMipRegions(fullDesc, droppedMips, hostSize);
+
+        busy = true;
+        Move move{
+            .texture = texture,
+            .newTexture = context.CreateTexture(reducedDesc),
+            .evictedData = context.CreateBuffer(
+                hostSize,
+                vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst,
+                vma::AllocationCreateFlagBits::eHostAccessRandom,
+                vma::MemoryUsage::eAutoPreferHost
+            ),
+            .droppedMips = droppedMips,
+            .evict = true
+        };
+        busy = false;
+
+        move.released = texture->vmaAllocationInfo.size - move.newTexture->vmaAllocationInfo.size;
+        return move;
+    }
+
+    ResidencyManager::Move ResidencyManager::PrepareRestore(VulkanBuffer* buffer)
+    {
+        busy = true;
+        Move move{
+            .buffer = buffer,
+            .newBuffer = context.CreateBuffer(buffer->size, buffer->bufferUsage)
+        };
+        busy = false;
+
+        return move;
+    }
+
+    ResidencyManager::Move ResidencyManager::PrepareRestore(VulkanTexture* texture)
+    {
+        busy = true;
+        Move move{
+            .texture = texture,
+            .newTexture = context.CreateTexture(texture->evictedDesc),
+            .droppedMips = texture->evictedMips
+        };
+        busy = false;
+
+        return move;
+    }
+
+    void ResidencyManager::Record(vk::CommandBuffer commandBuffer, const Move& move)
+    {
+        if (move.buffer)
+        {
+            // Evicted buffers keep being read by the GPU, just over the bus instead of from local memory
+            vk::BufferCopy region{
+                .srcOffset = 0,
+                .dstOffset = 0,
+                .size = move.buffer->size
+            };
+            commandBuffer.copyBuffer(move.buffer->buffer, move.newBuffer->buffer, region);
+            return;
+        }
+
+        VulkanTexture* texture = move.texture;
+        const TextureDesc& fullDesc = move.evict ? texture->desc : texture->evictedDesc;
+        const TextureDesc& currentDesc = texture->desc;
+        const TextureDesc& newDesc = move.newTexture->desc;
+
+        vk::DeviceSize hostSize = 0;
+        auto hostRegions = EvictedMipRegions(fullDesc, move.droppedMips, hostSize);
+
+        // Shared mips go the other way round when restoring
+        auto copyRegions = SharedMipRegions(fullDesc, move.droppedMips);
+        if (!move.evict)
+        {
+            for (auto& region : copyRegions)
+                std::swap(region.srcSubresource, region.dstSubresource);
+        }
+
+        ImageBarrier(commandBuffer, texture->image, currentDesc, vk::ImageLayout::eShaderReadOnlyOptimal, vk::ImageLayout::eTransferSrcOptimal);
+        ImageBarrier(commandBuffer, move.newTexture->image, newDesc, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
+
+        if (move.evict)
+        {
+            commandBuffer.copyImageToBuffer(texture->image, vk::ImageLayout::eTransferSrcOptimal, move.evictedData->buffer,
+                static_cast<uint32_t>(hostRegions.size()), hostRegions.data());
+        }
+        else
+        {
+            commandBuffer.copyBufferToImage(texture->evictedData->buffer, move.newTexture->image, vk::ImageLayout::eTransferDstOptimal,
+                static_cast<uint32_t>(hostRegions.size()), hostRegions.data());
+        }
+        commandBuffer.copyImage(texture->image, vk::ImageLayout::eTransferSrcOptimal, move.newTexture->image, vk::ImageLayout::eTransferDstOptimal,
+            static_cast<uint32_t>(copyRegions.size()), copyRegions.data());
+
+        // The current image is sampled until the new one is swapped in
+        ImageBarrier(commandBuffer, move.newTexture->image, newDesc, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
+        ImageBarrier(commandBuffer, texture->image, currentDesc, vk::ImageLayout::eTransferSrcOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
+    }
+
+    void ResidencyManager::Complete(Move& move, bool waited)
+    {
+        if (move.buffer)
+        {
+            move.buffer->SwapStorage(*move.newBuffer);
+            move.buffer->evicted = move.evict;
+
+            // Used again while the restore was in flight
+            if (!move.evict)
+                std::erase(pendingBuffers, move.buffer);
+        }
+        else if (move.texture)
+        {
+            VulkanTexture* texture = move.texture;
+            texture->SwapStorage(*move.newTexture);
+            if (move.evict)
+            {
+                texture->evictedMips = move.droppedMips;
+                texture->evictedDesc = move.newTexture->desc;
+                texture->evictedData = std::move(move.evictedData);
+            }
+            else
+            {
+                texture->evictedMips = 0;
+                texture->evictedData.reset();
+                std::erase(pendingTextures, texture);
+            }
+
+            // Descriptors bound by the frame being recorded are left alone
+            if (waited)
+                viewChanges.push_back(texture);
+            else
+                texture->onViewChanged(texture);
+        }
+
+        if (waited)
+            return;
+
+        if (move.newBuffer)
+            context.DeferDestroy(std::move(move.newBuffer));
+        if (move.newTexture)
+            context.DeferDestroy(std::move(move.newTexture));
+    }
+
+    bool ResidencyManager::CanEvict(const VulkanBuffer* buffer) const
+    {
+        // Same constraints as the defragmenter, plus the buffer has to accept the copy back
+        return buffer->IsMovable() && (buffer->bufferUsage & vk::BufferUsageFlagBits::eTransferDst);
+    }
+
+    bool ResidencyManager::CanEvict(const VulkanTexture* texture) const
+    {
+        const auto& desc = texture->desc;
+
+        // Only textures whose owner can rebuild its descriptors are candidates, streamed textures manage their own mips
+        return texture->onViewChanged
+            && texture->streamer == nullptr
+            && desc.imageType == vk::ImageType::e2D
+            && desc.mipLevels > config.evictedMipLevels
+            && (desc.usageFlags & vk::ImageUsageFlagBits::eTransferSrc)
+            && (desc.usageFlags & vk::ImageUsageFlagBits::eTransferDst)
+            && VulkanTexture::GetTexelSize(desc.format) > 0;
+    }
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "Common.h"
+#include "VulkanTexture.h"
+
+namespace jgw
+{
+    class VulkanContext;
+
+    struct ResidencyConfig
+    {
+        // Start evicting when device local usage exceeds this fraction of the budget
+        float highWatermark = 0.9f;
+
+        // Evict until usage drops below this fraction, restore only while staying below it
+        float lowWatermark = 0.8f;
+
+        // Resources not used for this many frames are considered cold
+        uint64_t coldFrames = 120;
+
+        // Number of finest mips dropped from an evicted texture
+        uint32_t evictedMipLevels = 2;
+
+        uint32_t maxRestoresPerFrame = 4;
+    };
+
+    struct ResidencyStats
+    {
+        uint32_t evictedTextures = 0;
+        uint32_t evictedBuffers = 0;
+        vk::DeviceSize hostBytes = 0;
+    };
+
+    // Keeps device local usage inside the memory budget by moving cold geometry to host memory
+    // and dropping the finest mips of cold textures, restoring them once they are used again
+    class ResidencyManager final
+    {
+    public:
+        CLASS_COPY_MOVE_DELETE(ResidencyManager)
+
+        explicit ResidencyManager(VulkanContext& context);
+
+        void Register(VulkanBuffer* buffer);
+        void Register(VulkanTexture* texture);
+        void Unregister(VulkanBuffer* buffer);
+        void Unregister(VulkanTexture* texture);
+
+        void MarkUsed(VulkanBuffer* buffer, uint64_t frameIndex);
+        void MarkUsed(VulkanTexture* texture, uint64_t frameIndex);
+
+        // Completes the moves whose frame has finished, then records this frame's evictions or restores into its
+        // command buffer. Resources keep their storage until the copies have completed.
+        void Update(vk::CommandBuffer commandBuffer, uint64_t frameIndex);
+
+        // Out of memory fallback while a frame is recorded, releases device memory right away. Only resources last
+        // used at or before frameIndex - frameInFlight are evicted, the copies go out in a single submission and
+        // descriptors are rewritten at the start of the next frame.
+        vk::DeviceSize EvictNow(vk::DeviceSize bytes, uint64_t frameIndex, uint64_t frameInFlight);
+
+        // A copy into new storage has been recorded but not swapped in yet
+        bool IsMoving(const VulkanBuffer* buffer) const;
+        bool IsMoving(const VulkanTexture* texture) const;
+
+        ResidencyConfig& Config() { return config; }
+        ResidencyStats GetStats() const;
+
+    private:
+        // Storage a resource moves into once the frame that recorded the copy has completed. After the swap it
+        // holds the old storage, which frames still in flight may use.
+        struct Move
+        {
+            VulkanBuffer* buffer = nullptr;
+            VulkanTexture* texture = nullptr;
+            std::unique_ptr<VulkanBuffer> newBuffer;
+            std::unique_ptr<VulkanTexture> newTexture;
+
+            // Dropped mips read back from an evicted texture
+            std::unique_ptr<VulkanBuffer> evictedData;
+            uint32_t droppedMips = 0;
+
+            bool evict = false;
+            vk::DeviceSize released = 0;
+            uint64_t frame = 0;
+        };
+
+        // Coldest resources last used at least coldFrames ago, until the requested amount of memory is covered
+        vk::DeviceSize SelectEvictions(vk::DeviceSize bytes, uint64_t frameIndex, uint64_t coldFrames, std::vector<Move>& selected);
+
+        Move PrepareEvict(VulkanBuffer* buffer);
+        Move PrepareEvict(VulkanTexture* texture);
+        Move PrepareRestore(VulkanBuffer* buffer);
+        Move PrepareRestore(VulkanTexture* texture);
+        void Record(vk::CommandBuffer commandBuffer, const Move& move);
+
+        // Swaps in the new storage, frames in flight may still use the old one unless everything was waited on
+        void Complete(Move& move, bool waited);
+
+        bool CanEvict(const VulkanBuffer* buffer) const;
+        bool CanEvict(const VulkanTexture* texture) const;
+
+        VulkanContext& context;
+        ResidencyConfig config{};
+
+        std::vector<VulkanBuffer*> buffers;
+        std::vector<VulkanTexture*> textures;
+        std::vector<VulkanBuffer*> pendingBuffers;
+        std::vector<VulkanTexture*> pendingTextures;
+
+        std::vector<Move> moves;
+        std::vector<VulkanTexture*> viewChanges;
+
+        bool busy = false;
+    };
+}
@@ -0,0 +1,435 @@
+#include "TextureStreamer.h"
+#include "VulkanContext.h"
+#include "JobQueue.h"
+
+#include <algorithm>
+
+namespace jgw
+{
+    // Rows smaller than this are not worth a job of their own
+    static constexpr uint32_t kMinRowsPerJob = 64;
+
+    static bool IsFilterable(vk::Format format)
+    {
+        return format == vk::Format::eR8G8B8A8Unorm || format == vk::Format::eR8G8B8A8Srgb
+            || format == vk::Format::eB8G8R8A8Unorm || format == vk::Format::eB8G8R8A8Srgb;
+    }
+
+    // 2x2 box filter of a 4 byte per texel image, rows [rowBegin, rowEnd) of the destination
+    static void Downsample(const uint8_t* src, const vk::Extent3D& srcExtent, uint8_t* dst, const vk::Extent3D& dstExtent, uint32_t rowBegin, uint32_t rowEnd)
+    {
+        for (uint32_t y = rowBegin; y < rowEnd; ++y)
+        {
+            const uint32_t y0 = std::min(y * 2, srcExtent.height - 1);
+            const uint32_t y1 = std::min(y * 2 + 1, srcExtent.height - 1);
+            for (uint32_t x = 0; x < dstExtent.width; ++x)
+            {
+                const uint32_t x0 = std::min(x * 2, srcExtent.width - 1);
+                const uint32_t x1 = std::min(x * 2 + 1, srcExtent.width - 1);
+                for (uint32_t c = 0; c < 4; ++c)
+                {
+                    const uint32_t sum =
+                        src[(y0 * srcExtent.width + x0) * 4 + c] + src[(y0 * srcExtent.width + x1) * 4 + c] +
+                        src[(y1 * srcExtent.width + x0) * 4 + c] + src[(y1 * srcExtent.width + x1) * 4 + c];
+                    dst[(y * dstExtent.width + x) * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+                }
+            }
+        }
+    }
+
+    static void ImageBarrier(
+        vk::CommandBuffer commandBuffer,
+        const VulkanTexture& texture,
+        vk::ImageLayout oldLayout,
+        vk::ImageLayout newLayout,
+        vk::PipelineStageFlags srcStage,
+        vk::AccessFlags srcAccess,
+        vk::PipelineStageFlags dstStage,
+        vk::AccessFlags dstAccess,
+        uint32_t mipLevels
+    )
+    {
+        vk::ImageMemoryBarrier barrier{
+            .srcAccessMask = srcAccess,
+            .dstAccessMask = dstAccess,
+            .oldLayout = oldLayout,
+            .newLayout = newLayout,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = texture.GetImage(),
+            .subresourceRange = {
+                .aspectMask = vk::ImageAspectFlagBits::eColor,
+                .baseMipLevel = 0,
+                .levelCount = mipLevels,
+                .baseArrayLayer = 0,
+                .layerCount = 1
+            }
+        };
+
+        commandBuffer.pipelineBarrier(srcStage, dstStage, {}, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+
+    TextureStreamer::TextureStreamer(VulkanContext& context, uint32_t frameInFlight, const TextureStreamingConfig& config)
+        : context(context)
+        , config(config)
+        , frameInFlight(frameInFlight)
+    {
+        const vk::DeviceSize alignment = context.GetPhysicalDevice().getProperties().limits.minStorageBufferOffsetAlignment;
+        feedbackRange = (config.maxTextures * sizeof(uint32_t) + alignment - 1) / alignment * alignment;
+
+        // Written by the GPU and read back on the host, one range per frame in flight
+        feedbackBuffer = context.CreateBuffer(
+            feedbackRange * frameInFlight,
+            vk::BufferUsageFlagBits::eStorageBuffer,
+            vma::AllocationCreateFlagBits::eMapped | vma::AllocationCreateFlagBits::eHostAccessRandom,
+            vma::MemoryUsage::eAutoPreferHost
+        );
+        feedbackBuffer->Map();
+        memset(feedbackBuffer->Data(), 0xff, feedbackRange * frameInFlight);
+        feedbackBuffer->Flush();
+
+        slots.resize(config.maxTextures);
+    }
+
+    TextureStreamer::~TextureStreamer()
+    {
+        for (auto& entry : slots)
+        {
+            if (entry.texture)
+                entry.texture->streamer = nullptr;
+        }
+    }
+
+    std::unique_ptr<VulkanTexture> TextureStreamer::CreateTexture(const uint8_t* pixels, uint32_t width, uint32_t height, vk::Format format, JobQueue* jobQueue)
+    {
+        if (!IsFilterable(format))
+        {
+            spdlog::error("Texture streaming does not support {}", vk::to_string(format));
+            return nullptr;
+        }
+
+        auto it = std::find_if(slots.begin(), slots.end(), [](const StreamedTexture& entry) { return entry.texture == nullptr; });
+        if (it == slots.end())
+        {
+            spdlog::error("No free texture streaming slot");
+            return nullptr;
+        }
+
+        StreamedTexture entry{
+            .fullExtent = { .width = width, .height = height, .depth = 1 },
+            .fullMipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1,
+            .texelSize = VulkanTexture::GetTexelSize(format)
+        };
+
+        // Coarsest mips are resident from the start
+        entry.residentMip = 0;
+        while (entry.residentMip + 1 < entry.fullMipLevels)
+        {
+            const vk::Extent3D extent = VulkanTexture::GetMipExtent(entry.fullExtent, entry.residentMip);
+            if (std::max(extent.width, extent.height) <= config.residentTailSize)
+                break;
+            ++entry.residentMip;
+        }
+
+        const TextureDesc desc{
+            .usageFlags = vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled,
+            .format = format,
+            .extent = VulkanTexture::GetMipExtent(entry.fullExtent, entry.residentMip),
+            .mipLevels = entry.fullMipLevels - entry.residentMip,
+            .mipmapped = true
+        };
+
+        auto texture = context.CreateTexture(desc);
+
+        // Each level is filtered from the previous one, once
+        std::vector<std::vector<uint8_t>> chain(entry.fullMipLevels);
+        chain[0].assign(pixels, pixels + static_cast<size_t>(width) * height * entry.texelSize);
+        for (uint32_t level = 1; level < entry.fullMipLevels; ++level)
+        {
+            const vk::Extent3D srcExtent = VulkanTexture::GetMipExtent(entry.fullExtent, level - 1);
+            const vk::Extent3D dstExtent = VulkanTexture::GetMipExtent(entry.fullExtent, level);
+            chain[level].resize(static_cast<size_t>(dstExtent.width) * dstExtent.height * entry.texelSize);
+
+            const uint8_t* src = chain[level - 1].data();
+            uint8_t* dst = chain[level].data();
+            const uint32_t jobCount = jobQueue ? std::min(jobQueue->ThreadCount(), dstExtent.height / kMinRowsPerJob) : 0;
+            if (jobCount < 2)
+            {
+                Downsample(src, srcExtent, dst, dstExtent, 0, dstExtent.height);
+                continue;
+            }
+
+            const uint32_t rowsPerJob = (dstExtent.height + jobCount - 1) / jobCount;
+            for (uint32_t job = 0; job < jobCount; ++job)
+            {
+                const uint32_t rowBegin = job * rowsPerJob;
+                const uint32_t rowEnd = std::min(rowBegin + rowsPerJob, dstExtent.height);
+                jobQueue->Submit([=] { Downsample(src, srcExtent, dst, dstExtent, rowBegin, rowEnd); });
+            }
+            jobQueue->Wait();
+        }
+
+        // The tail is uploaded now, finer levels wait for feedback
+        std::vector<std::vector<uint8_t>> tail(std::make_move_iterator(chain.begin() + entry.residentMip), std::make_move_iterator(chain.end()));
+        chain.resize(entry.residentMip);
+        entry.mips = std::move(chain);
+
+        std::vector<vk::BufferImageCopy> regions;
+        vk::DeviceSize stagingSize = 0;
+        for (uint32_t level = entry.residentMip; level < entry.fullMipLevels; ++level)
+        {
+            regions.push_back({
+                .bufferOffset = stagingSize,
+                .imageSubresource = {
+                    .aspectMask = desc.aspectMask,
+                    .mipLevel = level - entry.residentMip,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1
+                },
+                .imageOffset = { 0, 0, 0 },
+                .imageExtent = VulkanTexture::GetMipExtent(entry.fullExtent, level)
+            });
+            stagingSize += (tail[level - entry.residentMip].size() + 15) & ~size_t(15);
+        }
+
+        auto stagingBuffer = context.CreateBuffer(
+            stagingSize,
+            vk::BufferUsageFlagBits::eTransferSrc,
+            vma::AllocationCreateFlagBits::eMapped | vma::AllocationCreateFlagBits::eHostAccessSequentialWrite
+        );
+
+        auto* dst = static_cast<uint8_t*>(stagingBuffer->Data());
+        for (size_t i = 0; i < regions.size(); ++i)
+            memcpy(dst + regions[i].bufferOffset, tail[i].data(), tail[i].size());
+
+        context.ImmediateSubmit([&](vk::CommandBuffer commandBuffer) {
+            texture->TransitionLayout(commandBuffer, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
+            commandBuffer.copyBufferToImage(stagingBuffer->Handle(), texture->image, vk::ImageLayout::eTransferDstOptimal,
+                static_cast<uint32_t>(regions.size()), regions.data());
+            texture->TransitionLayout(commandBuffer, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
+        });
+
+        entry.texture = texture.get();
+        texture->streamer = this;
+        *it = std::move(entry);
+
+        return texture;
+    }
+
+    void TextureStreamer::Unregister(VulkanTexture* texture)
+    {
+        for (auto& entry : slots)
+        {
+            if (entry.texture == texture)
+                entry = {};
+        }
+
+        // The upload may still be running, its resources go away once its frame has completed
+        for (auto& promotion : promotions)
+        {
+            if (promotion.texture == texture)
+                promotion.texture = nullptr;
+        }
+    }
+
+    void TextureStreamer::Update(vk::CommandBuffer commandBuffer, uint32_t frame, uint64_t frameIndex)
+    {
+        currentFrame = frame;
+
+        std::erase_if(promotions, [&](Promotion& promotion) {
+            if (!context.IsFrameComplete(promotion.frame))
+                return false;
+
+            if (promotion.texture)
+            {
+                auto& entry = slots[promotion.slot];
+                promotion.texture->SwapStorage(*promotion.promoted);
+                --entry.residentMip;
+                entry.lastChangeFrame = frameIndex;
+                entry.promoting = false;
+                if (entry.residentMip == 0)
+                    entry.mips = {};
+
+                // Frames in flight may still sample the old image
+                context.DeferDestroy(std::move(promotion.promoted));
+                promotion.texture->onViewChanged(promotion.texture);
+            }
+            return true;
+        });
+
+        // The timeline value of the last frame of this slot has been reached, its feedback is complete
+        feedbackBuffer->Invalidate();
+        auto* feedback = reinterpret_cast<uint32_t*>(static_cast<uint8_t*>(feedbackBuffer->Data()) + GetFeedbackOffset());
+
+        candidates.clear();
+        for (uint32_t i = 0; i < slots.size(); ++i)
+        {
+            auto& entry = slots[i];
+            const uint32_t lod = feedback[i];
+            feedback[i] = kNoRequest;
+
+            if (entry.texture == nullptr)
+                continue;
+
+            // Feedback recorded before the last promotion refers to a different resident image
+            if (lod != kNoRequest && frameIndex >= entry.lastChangeFrame + frameInFlight)
+                entry.requestedMip = std::min(lod + entry.residentMip, entry.fullMipLevels - 1);
+
+            if (entry.requestedMip < entry.residentMip && !entry.promoting && entry.texture->onViewChanged)
+                candidates.push_back(&entry);
+        }
+
+        feedbackBuffer->Flush();
+
+        // Largest gap between requested and resident mip first
+        std::sort(candidates.begin(), candidates.end(), [](const StreamedTexture* a, const StreamedTexture* b) {
+            return a->residentMip - a->requestedMip > b->residentMip - b->requestedMip;
+        });
+
+        uint32_t promoted = 0;
+        for (auto* entry : candidates)
+        {
+            if (promoted >= config.maxPromotionsPerFrame)
+                break;
+
+            if (Promote(commandBuffer, static_cast<uint32_t>(entry - slots.data()), frameIndex))
+                ++promoted;
+        }
+    }
+
+    void TextureStreamer::EndFrame(vk::CommandBuffer commandBuffer)
+    {
+        vk::MemoryBarrier2 barrier{
+            .srcStageMask = vk::PipelineStageFlagBits2::eFragmentShader,
+            .srcAccessMask = vk::AccessFlagBits2::eShaderStorageWrite,
+            .dstStageMask = vk::PipelineStageFlagBits2::eHost,
+            .dstAccessMask = vk::AccessFlagBits2::eHostRead
+        };
+
+        vk::DependencyInfo dependencyInfo{
+            .memoryBarrierCount = 1,
+            .pMemoryBarriers = &barrier
+        };
+        commandBuffer.pipelineBarrier2(dependencyInfo);
+    }
+
+    vk::Buffer TextureStreamer::GetFeedbackBuffer() const
+    {
+        return feedbackBuffer->Handle();
+    }
+
+    uint32_t TextureStreamer::GetSlot(const VulkanTexture* texture) const
+    {
+        for (uint32_t i = 0; i < slots.size(); ++i)
+        {
+            if (slots[i].texture == texture)
+                return i;
+        }
+        return kNoRequest;
+    }
+
+    TextureStreamingStats TextureStreamer::GetStats() const
+    {
+        TextureStreamingStats stats{};
+        for (const auto& entry : slots)
+        {
+            if (entry.texture == nullptr)
+                continue;
+
+            ++stats.textures;
+            if (entry.requestedMip < entry.residentMip)
+                ++stats.pendingTextures;
+
+            stats.residentBytes += entry.texture->vmaAllocationInfo.size;
+            for (uint32_t level = 0; level < entry.fullMipLevels; ++level)
+            {
+                const vk::Extent3D extent = VulkanTexture::GetMipExtent(entry.fullExtent, level);
+                stats.fullBytes += static_cast<vk::DeviceSize>(extent.width) * extent.height * entry.texelSize;
+            }
+        }
+        return stats;
+    }
+
+    bool TextureStreamer::Promote(vk::CommandBuffer commandBuffer, uint32_t slot, uint64_t frameIndex)
+    {
+        StreamedTexture& entry = slots[slot];
+
+        // Stay below the level the residency manager restores to
+        vk::DeviceSize usage = 0, budget = 0;
+        context.GetDeviceLocalBudget(usage, budget);
+
+        const uint32_t target = entry.residentMip - 1;
+        const vk::Extent3D targetExtent = VulkanTexture::GetMipExtent(entry.fullExtent, target);
+        const vk::DeviceSize targetSize = static_cast<vk::DeviceSize>(targetExtent.width) * targetExtent.height * VulkanTexture::GetTexelSize(entry.texture->desc.format);
+        if (budget > 0 && usage + targetSize > budget * context.GetResidencyManager()->Config().lowWatermark)
+            return false;
+
+        VulkanTexture* texture = entry.texture;
+
+        TextureDesc desc = texture->desc;
+        desc.extent = targetExtent;
+        desc.mipLevels = entry.fullMipLevels - target;
+
+        Promotion promotion{
+            .slot = slot,
+            .texture = texture,
+            .promoted = context.CreateTexture(desc),
+            .stagingBuffer = context.CreateBuffer(
+                targetSize,
+                vk::BufferUsageFlagBits::eTransferSrc,
+                vma::AllocationCreateFlagBits::eMapped | vma::AllocationCreateFlagBits::eHostAccessSequentialWrite
+            ),
+            .frame = frameIndex
+        };
+
+        // The staging buffer holds the only copy from now on
+        std::vector<uint8_t>& mip = entry.mips[target];
+        memcpy(promotion.stagingBuffer->Data(), mip.data(), targetSize);
+        std::vector<uint8_t>().swap(mip);
+
+        vk::BufferImageCopy uploadRegion{
+            .bufferOffset = 0,
+            .imageSubresource = {
+                .aspectMask = desc.aspectMask,
+                .mipLevel = 0,
+                .baseArrayLayer = 0,
+                .layerCount = 1
+            },
+            .imageOffset = { 0, 0, 0 },
+            .imageExtent = desc.extent
+        };
+
+        std::vector<vk::ImageCopy> copyRegions;
+        for (uint32_t level = 0; level < texture->desc.mipLevels; ++level)
+        {
+            copyRegions.push_back({
+                .srcSubresource = { .aspectMask = desc.aspectMask, .mipLevel = level, .baseArrayLayer = 0, .layerCount = 1 },
+                .srcOffset = { 0, 0, 0 },
+                .dstSubresource = { .aspectMask = desc.aspectMask, .mipLevel = level + 1, .baseArrayLayer = 0, .layerCount = 1 },
+                .dstOffset = { 0, 0, 0 },
+                .extent = VulkanTexture::GetMipExtent(texture->desc.extent, level)
+            });
+        }
+
+        // Earlier frames sample the current image in fragment shaders, this frame keeps sampling it after the copy
+        VulkanTexture& promoted = *promotion.promoted;
+        ImageBarrier(commandBuffer, *texture, vk::ImageLayout::eShaderReadOnlyOptimal, vk::ImageLayout::eTransferSrcOptimal,
+            vk::PipelineStageFlagBits::eFragmentShader, {}, vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferRead, texture->desc.mipLevels);
+        ImageBarrier(commandBuffer, promoted, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal,
+            vk::PipelineStageFlagBits::eTopOfPipe, {}, vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferWrite, desc.mipLevels);
+
+        commandBuffer.copyBufferToImage(promotion.stagingBuffer->Handle(), promoted.image, vk::ImageLayout::eTransferDstOptimal, 1, &uploadRegion);
+        commandBuffer.copyImage(texture->image, vk::ImageLayout::eTransferSrcOptimal, promoted.image, vk::ImageLayout::eTransferDstOptimal,
+            static_cast<uint32_t>(copyRegions.size()), copyRegions.data());
+
+        ImageBarrier(commandBuffer, promoted, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal,
+            vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferWrite, vk::PipelineStageFlagBits::eFragmentShader, vk::AccessFlagBits::eShaderRead, desc.mipLevels);
+        ImageBarrier(commandBuffer, *texture, vk::ImageLayout::eTransferSrcOptimal, vk::ImageLayout::eShaderReadOnlyOptimal,
+            vk::PipelineStageFlagBits::eTransfer, {}, vk::PipelineStageFlagBits::eFragmentShader, vk::AccessFlagBits::eShaderRead, texture->desc.mipLevels);
+
+        entry.promoting = true;
+        promotions.push_back(std::move(promotion));
+
+        return true;
+    }
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "Common.h"
+
+namespace jgw
+{
+    class VulkanContext;
+    class VulkanBuffer;
+    class VulkanTexture;
+    class JobQueue;
+
+    struct TextureStreamingConfig
+    {
+        // Maximum number of streamed textures, one feedback slot each
+        uint32_t maxTextures = 256;
+
+        // Mips up to this size are uploaded when the texture is created
+        uint32_t residentTailSize = 64;
+
+        uint32_t maxPromotionsPerFrame = 2;
+    };
+
+    struct TextureStreamingStats
+    {
+        uint32_t textures = 0;
+        uint32_t pendingTextures = 0;
+        vk::DeviceSize residentBytes = 0;
+        vk::DeviceSize fullBytes = 0;
+    };
+
+    // Textures start resident with their coarsest mips only. Fragment shaders write the finest mip they
+    // would sample into a feedback buffer, which is read back once the frame has completed and used to
+    // upload finer mips one level at a time, largest gap first.
+    class TextureStreamer final
+    {
+    public:
+        CLASS_COPY_MOVE_DELETE(TextureStreamer)
+
+        static constexpr uint32_t kNoRequest = UINT32_MAX;
+
+        TextureStreamer(VulkanContext& context, uint32_t frameInFlight, const TextureStreamingConfig& config);
+        ~TextureStreamer();
+
+        // Builds the mip chain of an 8 bit RGBA or BGRA image once and uploads its tail, nullptr when all slots are
+        // taken. Rows of each level are filtered on the job queue when one is given, which must not be called from
+        // one of its workers. Levels finer than the tail are kept on the host until they are uploaded.
+        std::unique_ptr<VulkanTexture> CreateTexture(const uint8_t* pixels, uint32_t width, uint32_t height, vk::Format format, JobQueue* jobQueue = nullptr);
+        void Unregister(VulkanTexture* texture);
+
+        // Swaps in the promotions whose frame has completed, reads back the feedback written by the last use of this
+        // frame slot and records the uploads of requested mips into the command buffer
+        void Update(vk::CommandBuffer commandBuffer, uint32_t frame, uint64_t frameIndex);
+
+        // Makes the feedback written by this frame visible to the host read at the start of its slot's next frame
+        void EndFrame(vk::CommandBuffer commandBuffer);
+
+        // Bound as a dynamic storage buffer, indexed by GetSlot in the shader
+        vk::Buffer GetFeedbackBuffer() const;
+        vk::DeviceSize GetFeedbackRange() const { return feedbackRange; }
+        uint32_t GetFeedbackOffset() const { return static_cast<uint32_t>(feedbackRange * currentFrame); }
+        uint32_t GetSlot(const VulkanTexture* texture) const;
+
+        TextureStreamingStats GetStats() const;
+
+    private:
+        struct StreamedTexture
+        {
+            VulkanTexture* texture = nullptr;
+            vk::Extent3D fullExtent = {};
+            uint32_t fullMipLevels = 0;
+            uint32_t texelSize = 0;
+            uint32_t residentMip = 0;
+            uint32_t requestedMip = kNoRequest;
+            uint64_t lastChangeFrame = 0;
+            bool promoting = false;
+
+            // Levels finer than the resident ones, each freed once its upload has been recorded
+            std::vector<std::vector<uint8_t>> mips;
+        };
+
+        // Image with one more mip than the texture, swapped in once the frame that recorded the upload has completed
+        struct Promotion
+        {
+            uint32_t slot = 0;
+            VulkanTexture* texture = nullptr;
+            std::unique_ptr<VulkanTexture> promoted;
+            std::unique_ptr<VulkanBuffer> stagingBuffer;
+            uint64_t frame = 0;
+        };
+
+        bool Promote(vk::CommandBuffer commandBuffer, uint32_t slot, uint64_t frameIndex);
+
+        VulkanContext& context;
+        TextureStreamingConfig config;
+        uint32_t frameInFlight;
+        uint32_t currentFrame = 0;
+
+        vk::DeviceSize feedbackRange = 0;
+        std::unique_ptr<VulkanBuffer> feedbackBuffer;
+
+        std::vector<StreamedTexture> slots;
+        std::vector<Promotion> promotions;
+
+        // Reused every frame
+        std::vector<StreamedTexture*> candidates;
+    };
+}
@@ -1,4 +1,7 @@
 #include "VulkanBuffer.h"
+#include "ResidencyManager.h"
+
+#include <algorithm>
 
 namespace jgw
 {
@@ -30,7 +33,10 @@ namespace jgw
             throw std::runtime_error("Failed to create Vulkan buffer: " + vk::to_string(result));
         }
 
-        if (bufferUsage & vk::BufferUsageFlagBits::eTransferSrc)
+        vmaAllocator.setAllocationUserData(vmaAllocation, this);
+
+        const bool hostVisible = static_cast<bool>(vmaAllocator.getAllocationMemoryProperties(vmaAllocation) & vk::MemoryPropertyFlagBits::eHostVisible);
+        if ((bufferUsage & vk::BufferUsageFlagBits::eTransferSrc) && hostVisible)
         {
             mappedMemory = vmaAllocator.mapMemory(vmaAllocation);
         }
@@ -38,15 +44,103 @@ namespace jgw
 
     VulkanBuffer::~VulkanBuffer()
     {
+        if (residency)
+            residency->Unregister(this);
+
+        if (tracker)
+            tracker->Remove(category, vmaAllocationInfo.size);
+
         if (mappedMemory)
         {
             vmaAllocator.unmapMemory(vmaAllocation);
             mappedMemory = nullptr;
         }
 
+        // A pending defragmentation pass frees the allocation once it sees the cleared user data
+        if (defragmenting)
+        {
+            vmaAllocator.setAllocationUserData(vmaAllocation, nullptr);
+            vmaAllocator.destroyBuffer(buffer, vma::Allocation{});
+            return;
+        }
+
         vmaAllocator.destroyBuffer(buffer, vmaAllocation);
     }
 
+    bool VulkanBuffer::IsMovable() const
+    {
+        return category == EMemoryCategory::Geometry
+            && mappedMemory == nullptr
+            && (bufferUsage & vk::BufferUsageFlagBits::eTransferSrc)
+            && !(bufferUsage & (vk::BufferUsageFlagBits::eShaderDeviceAddress | vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eUniformBuffer))
+            && !defragmenting;
+    }
+
+    void VulkanBuffer::SwapStorage(VulkanBuffer& other)
+    {
+        std::swap(buffer, other.buffer);
+        std::swap(vmaAllocation, other.vmaAllocation);
+        std::swap(vmaAllocationInfo, other.vmaAllocationInfo);
+        std::swap(memoryUsage, other.memoryUsage);
+        std::swap(mappedMemory, other.mappedMemory);
+
+        vmaAllocator.setAllocationUserData(vmaAllocation, this);
+        vmaAllocator.setAllocationUserData(other.vmaAllocation, &other);
+    }
+
+    bool VulkanBuffer::IsHostVisible() const
+    {
+        return static_cast<bool>(vmaAllocator.getAllocationMemoryProperties(vmaAllocation) & vk::MemoryPropertyFlagBits::eHostVisible);
+    }
+
+    void VulkanBuffer::Write(uint32_t frame, const void* data, vk::DeviceSize size, vk::DeviceSize offset)
+    {
+        offset += GetFrameOffset(frame);
+
+        VulkanBuffer* target = staging ? staging.get() : this;
+        memcpy(static_cast<uint8_t*>(target->mappedMemory) + offset, data, size);
+        vmaAllocator.flushAllocation(target->vmaAllocation, offset, size);
+
+        if (staging)
+        {
+            dirtyBegin = std::min(dirtyBegin, offset);
+            dirtyEnd = std::max(dirtyEnd, offset + size);
+        }
+    }
+
+    void VulkanBuffer::Upload(vk::CommandBuffer commandBuffer, uint32_t frame)
+    {
+        if (!staging || dirtyBegin >= dirtyEnd)
+            return;
+
+        // Writes for another frame slot were never uploaded, their frame has been recorded already
+        const vk::DeviceSize regionBegin = GetFrameOffset(frame);
+        dirtyBegin = std::max(dirtyBegin, regionBegin);
+        dirtyEnd = std::min(dirtyEnd, regionBegin + regionSize);
+        if (dirtyBegin >= dirtyEnd)
+        {
+            dirtyBegin = VK_WHOLE_SIZE;
+            dirtyEnd = 0;
+            return;
+        }
+
+        vk::BufferCopy region{
+            .srcOffset = dirtyBegin,
+            .dstOffset = dirtyBegin,
+            .size = dirtyEnd - dirtyBegin
+        };
+        commandBuffer.copyBuffer(staging->buffer, buffer, region);
+
+        vk::MemoryBarrier barrier{
+            .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+            .dstAccessMask = vk::AccessFlagBits::eMemoryRead
+        };
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAllGraphics, {}, 1, &barrier, 0, nullptr, 0, nullptr);
+
+        dirtyBegin = VK_WHOLE_SIZE;
+        dirtyEnd = 0;
+    }
+
     void VulkanBuffer::Map()
     {
         mappedMemory = vmaAllocator.mapMemory(vmaAllocation);
@@ -56,4 +150,14 @@ namespace jgw
     {
         memcpy(mappedMemory, data, size);
     }
+
+    void VulkanBuffer::Flush()
+    {
+        vmaAllocator.flushAllocation(vmaAllocation, 0, VK_WHOLE_SIZE);
+    }
+
+    void VulkanBuffer::Invalidate()
+    {
+        vmaAllocator.invalidateAllocation(vmaAllocation, 0, VK_WHOLE_SIZE);
+    }
 }
@@ -1,12 +1,16 @@
 #pragma once
 
 #include "Common.h"
+#include "VulkanMemoryStats.h"
 
 namespace jgw
 {
+    class ResidencyManager;
+
     class VulkanBuffer final
     {
         friend class VulkanContext;
+        friend class ResidencyManager;
 
     public:
         CLASS_COPY_MOVE_DELETE(VulkanBuffer)
@@ -24,9 +28,36 @@ namespace jgw
         void Map();
         void CopyFromHost(void* data, vk::DeviceSize size);
 
+        // Make host writes visible to the device and device writes visible to the host for non-coherent memory
+        void Flush();
+        void Invalidate();
+
+        void* Data() { return mappedMemory; }
+
         vk::Buffer Handle() { return buffer; }
         vk::DeviceSize TotalSize() { return size; }
 
+        // Buffers that are re-bound by handle every frame may be relocated by the defragmenter,
+        // anything a descriptor may point at keeps its handle
+        bool IsMovable() const;
+
+        // Exchange the underlying buffer and allocation, used to move contents between memory types
+        void SwapStorage(VulkanBuffer& other);
+
+        // Dynamic buffers are written by the host directly when they landed in host visible device local
+        // memory (ReBAR or UMA), otherwise writes go to a staging buffer and Upload records the copy.
+        // Each frame slot owns a region of both, so a frame only writes memory whose last reader has completed.
+        bool IsDynamic() const { return category == EMemoryCategory::Dynamic; }
+        bool IsHostVisible() const;
+        void Write(uint32_t frame, const void* data, vk::DeviceSize size, vk::DeviceSize offset = 0);
+
+        // Copies the range of the frame's region written since the last upload, has to be recorded outside of rendering
+        void Upload(vk::CommandBuffer commandBuffer, uint32_t frame);
+
+        // Offset to bind the region of a frame slot at
+        vk::DeviceSize GetFrameOffset(uint32_t frame) const { return frame * regionSize; }
+        vk::DeviceSize RegionSize() const { return regionSize; }
+
     private:
         vk::DeviceSize size;
         vk::Buffer buffer;
@@ -38,5 +69,20 @@ namespace jgw
         vma::MemoryUsage memoryUsage;
 
         mutable void* mappedMemory{ nullptr };
+
+        MemoryTracker* tracker{ nullptr };
+        EMemoryCategory category{ EMemoryCategory::Other };
+
+        std::unique_ptr<VulkanBuffer> staging;
+        vk::DeviceSize regionSize{ 0 };
+        vk::DeviceSize dirtyBegin{ VK_WHOLE_SIZE };
+        vk::DeviceSize dirtyEnd{ 0 };
+
+        ResidencyManager* residency{ nullptr };
+        uint64_t lastUsedFrame{ 0 };
+        bool evicted{ false };
+
+        // Bound to the destination of a defragmentation move whose pass has not ended, the pass owns the allocation
+        bool defragmenting{ false };
     };
 }
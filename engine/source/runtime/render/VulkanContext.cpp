@@ -1,4 +1,11 @@
 #include "VulkanContext.h"
+#include "Hash.h"
+#include "JobQueue.h"
+#include "AllocationTracker.h"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
 
 VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
 
@@ -10,16 +17,40 @@ namespace jgw
 
     VulkanContext::~VulkanContext()
     {
+        if (defragContext)
+        {
+            // The device is idle, the copies of a pending pass have completed
+            if (defragPassPending)
+                EndDefragmentationPass();
+            vmaAllocator.endDefragmentation(defragContext, nullptr);
+        }
+
+        SavePipelineCache();
+        pipelineCache.reset();
+
+        // Stops waiting on the swapchain before it is destroyed
+        presentWaiter.reset();
+
+        // Everything still queued was referenced by frames the device has finished by now
+        deletionQueue.reset();
         depthBuffer.reset();
+        offscreenTargets.clear();
+        parallelRecorder.reset();
+        frameAllocator.reset();
+        textureStreamer.reset();
+        residency.reset();
+        texturePools.clear();
         vmaAllocator.destroy();
 
         if (device)
         {
-            for (auto& fence : fences) device.destroy(fence);
+            device.destroy(timelineSemaphore);
+            device.destroyQueryPool(timestampPool);
             for (auto& semaphore : imageAvailableSemaphores) device.destroy(semaphore);
             for (auto& semaphore : renderFinishedSemaphores) device.destroy(semaphore);
 
-            swapchainPtr->Destroy();
+            if (swapchainPtr)
+                swapchainPtr->Destroy();
 
             device.destroyCommandPool(commandPool);
             device.destroy();
@@ -33,7 +64,6 @@ namespace jgw
         }
 
         commandBuffers.clear();
-        fences.clear();
         imageAvailableSemaphores.clear();
         renderFinishedSemaphores.clear();
     }
@@ -47,6 +77,7 @@ namespace jgw
     )
     {
         this->apiVersion = apiVersion;
+        windowHandle = handle;
 
         try
         {
@@ -79,46 +110,83 @@ namespace jgw
             VULKAN_HPP_DEFAULT_DISPATCHER.init(instance);
 
             // Create surface
-            VkSurfaceKHR sur;
-            auto result = glfwCreateWindowSurface(static_cast<VkInstance>(instance), handle, nullptr, &sur);
-            if (result != VK_SUCCESS)
+            if (!headless)
             {
-                spdlog::error("Failed to create window surface: {}", vk::to_string(static_cast<vk::Result>(result)));
-                return false;
+                VkSurfaceKHR sur;
+                auto result = glfwCreateWindowSurface(static_cast<VkInstance>(instance), handle, nullptr, &sur);
+                if (result != VK_SUCCESS)
+                {
+                    spdlog::error("Failed to create window surface: {}", vk::to_string(static_cast<vk::Result>(result)));
+                    return false;
+                }
+                surface = vk::SurfaceKHR(sur);
             }
-            surface = vk::SurfaceKHR(sur);
 
-            // Create physical device
-            auto physicalDevices = instance.enumeratePhysicalDevices();
-            for (const auto& pd : physicalDevices)
+            // Pick physical device
+            if (!SelectPhysicalDevice(requestDeviceExtensions))
+                return false;
+
+            if (!CheckDeviceExtensionSupport(requestDeviceExtensions))
+                return false;
+
+            // Software implementations may lag behind the requested version, the device version caps what is used
+            const uint32_t deviceApiVersion = physicalDevice.getProperties().apiVersion;
+            this->apiVersion = std::min(this->apiVersion, VK_MAKE_API_VERSION(0, VK_API_VERSION_MAJOR(deviceApiVersion), VK_API_VERSION_MINOR(deviceApiVersion), 0));
+
+            // Block compressed formats are enabled whenever available, textures pick the format at load time
+            const vk::PhysicalDeviceFeatures supportedFeatures = physicalDevice.getFeatures();
+            deviceFeatures.textureCompressionBC |= supportedFeatures.textureCompressionBC;
+            deviceFeatures.textureCompressionETC2 |= supportedFeatures.textureCompressionETC2;
+            deviceFeatures.textureCompressionASTC_LDR |= supportedFeatures.textureCompressionASTC_LDR;
+
+            std::vector<const char*> deviceExtensions = requestDeviceExtensions;
+            const bool memoryBudgetSupported = IsDeviceExtensionSupported(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+            if (memoryBudgetSupported)
+                deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+            // Host image copy is only used when sampled images can be written in their final layout
+            if (IsDeviceExtensionSupported(VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME))
             {
-                auto properties = pd.getProperties();
-                if (properties.deviceType == vk::PhysicalDeviceType::eDiscreteGpu)
+                auto features = physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceHostImageCopyFeaturesEXT>();
+                if (features.get<vk::PhysicalDeviceHostImageCopyFeaturesEXT>().hostImageCopy)
                 {
-                    physicalDevice = pd;
-                    break;
+                    vk::PhysicalDeviceHostImageCopyPropertiesEXT hostImageCopyProperties{};
+                    vk::PhysicalDeviceProperties2 properties{ .pNext = &hostImageCopyProperties };
+                    physicalDevice.getProperties2(&properties);
+
+                    std::vector<vk::ImageLayout> copyDstLayouts(hostImageCopyProperties.copyDstLayoutCount);
+                    hostImageCopyProperties.pCopyDstLayouts = copyDstLayouts.data();
+                    physicalDevice.getProperties2(&properties);
+
+                    hostImageCopyEnabled = std::find(copyDstLayouts.begin(), copyDstLayouts.end(), vk::ImageLayout::eShaderReadOnlyOptimal) != copyDstLayouts.end();
+                    if (hostImageCopyEnabled)
+                        deviceExtensions.push_back(VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME);
                 }
             }
 
-            if (physicalDevice == nullptr)
+            // Present ids let the latency tracker wait for each present to reach the display. Without them the
+            // present is timed when the present call returns.
+            if (!headless && IsDeviceExtensionSupported(VK_KHR_PRESENT_ID_EXTENSION_NAME) && IsDeviceExtensionSupported(VK_KHR_PRESENT_WAIT_EXTENSION_NAME))
             {
-                spdlog::error("No discrete gpu found");
-                return false;
+                auto features = physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDevicePresentIdFeaturesKHR, vk::PhysicalDevicePresentWaitFeaturesKHR>();
+                presentWaitEnabled = features.get<vk::PhysicalDevicePresentIdFeaturesKHR>().presentId && features.get<vk::PhysicalDevicePresentWaitFeaturesKHR>().presentWait;
+                if (presentWaitEnabled)
+                {
+                    deviceExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+                    deviceExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+                }
             }
-
-            spdlog::info("Using physical device: {}", physicalDevice.getProperties().deviceName.data());
-
-            if (!CheckDeviceExtensionSupport(requestDeviceExtensions))
-                return false;
+            latency.SetPresentWait(presentWaitEnabled);
 
             // Create logical device
             std::vector<vk::DeviceQueueCreateInfo> queueCreateInfos;
 
             graphicsFamilyIndex = GetQueueFamilyIndex(vk::QueueFlagBits::eGraphics);
+            const float queuePriority = 1.0f; // Default priority
             vk::DeviceQueueCreateInfo deviceQueueCI{
                 .queueFamilyIndex = graphicsFamilyIndex,
                 .queueCount = 1,
-                .pQueuePriorities = new float[1] { 1.0f } // Default priority
+                .pQueuePriorities = &queuePriority
             };
             queueCreateInfos.push_back(deviceQueueCI);
 
@@ -134,14 +202,43 @@ namespace jgw
                 .dynamicRendering = vk::True
             };
 
-            vk::DeviceCreateInfo deviceCI{
+            vk::PhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeature{
                 .pNext = &dynamicRenderingFeature,
+                .timelineSemaphore = vk::True
+            };
+            vk::PhysicalDeviceSynchronization2Features synchronization2Feature{
+                .pNext = &timelineSemaphoreFeature,
+                .synchronization2 = vk::True
+            };
+
+            void* featureChain = &synchronization2Feature;
+
+            vk::PhysicalDeviceHostImageCopyFeaturesEXT hostImageCopyFeature{
+                .pNext = featureChain,
+                .hostImageCopy = vk::True
+            };
+            if (hostImageCopyEnabled)
+                featureChain = &hostImageCopyFeature;
+
+            vk::PhysicalDevicePresentIdFeaturesKHR presentIdFeature{
+                .pNext = featureChain,
+                .presentId = vk::True
+            };
+            vk::PhysicalDevicePresentWaitFeaturesKHR presentWaitFeature{
+                .pNext = &presentIdFeature,
+                .presentWait = vk::True
+            };
+            if (presentWaitEnabled)
+                featureChain = &presentWaitFeature;
+
+            vk::DeviceCreateInfo deviceCI{
+                .pNext = featureChain,
                 .queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size()),
                 .pQueueCreateInfos = queueCreateInfos.data(),
                 .enabledLayerCount = static_cast<uint32_t>(requestInstanceLayers.size()),
                 .ppEnabledLayerNames = requestInstanceLayers.data(),
-                .enabledExtensionCount = static_cast<uint32_t>(requestDeviceExtensions.size()),
-                .ppEnabledExtensionNames = requestDeviceExtensions.data(),
+                .enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size()),
+                .ppEnabledExtensionNames = deviceExtensions.data(),
                 .pEnabledFeatures = &deviceFeatures
             };
 
@@ -149,6 +246,9 @@ namespace jgw
 
             VULKAN_HPP_DEFAULT_DISPATCHER.init(device);
 
+            if (presentWaitEnabled)
+                presentWaiter = std::make_unique<PresentWaiter>(device);
+
             // Create command pool and command buffer
             graphicsQueue = device.getQueue(graphicsFamilyIndex, 0);
 
@@ -162,23 +262,51 @@ namespace jgw
             vk::CommandBufferAllocateInfo commandBufferAI{
                 .commandPool = commandPool,
                 .level = vk::CommandBufferLevel::ePrimary,
-                .commandBufferCount = frameInFlight
+                .commandBufferCount = kMaxFrameInFlight
             };
 
             commandBuffers = device.allocateCommandBuffers(commandBufferAI);
 
-            // Create swapchain
-            swapchainPtr = std::make_unique<VulkanSwapchain>(physicalDevice, device, surface);
-            swapchainPtr->Create(handle);
+            commandBufferAI.commandBufferCount = 1;
+            immediateCommandBuffer = device.allocateCommandBuffers(commandBufferAI)[0];
 
-            // Create synchronization objects
-            for (uint32_t i = 0; i < frameInFlight; ++i)
+            // Create swapchain, headless contexts create their offscreen targets once VMA exists
+            if (!headless)
             {
-                vk::FenceCreateInfo fenceCI{
-                    .flags = vk::FenceCreateFlagBits::eSignaled // Start with signaled state
+                swapchainPtr = std::make_unique<VulkanSwapchain>(physicalDevice, device, surface);
+                swapchainPtr->SetPresentMode(framePacingConfig.presentMode);
+                swapchainPtr->SetImageCount(framePacingConfig.swapchainImageCount);
+                swapchainPtr->Create(handle);
+            }
+
+            // All submits to the graphics queue signal the next value of one timeline semaphore
+            vk::SemaphoreTypeCreateInfo timelineCI{
+                .semaphoreType = vk::SemaphoreType::eTimeline,
+                .initialValue = 0
+            };
+            vk::SemaphoreCreateInfo timelineSemaphoreCI{
+                .pNext = &timelineCI
+            };
+            timelineSemaphore = device.createSemaphore(timelineSemaphoreCI);
+
+            // Two timestamps per frame slot bracket the frame command buffer
+            const uint32_t timestampBits = physicalDevice.getQueueFamilyProperties()[graphicsFamilyIndex].timestampValidBits;
+            if (timestampBits > 0)
+            {
+                vk::QueryPoolCreateInfo queryPoolCI{
+                    .queryType = vk::QueryType::eTimestamp,
+                    .queryCount = kMaxFrameInFlight * 2
                 };
-                fences.push_back(device.createFence(fenceCI));
+                timestampPool = device.createQueryPool(queryPoolCI);
+                timestampMask = timestampBits >= 64 ? UINT64_MAX : (uint64_t(1) << timestampBits) - 1;
+                timestampPeriod = physicalDevice.getProperties().limits.timestampPeriod;
+            }
 
+            // Per-frame objects exist for the largest frames in flight count, the active count can change at runtime
+            frameInFlight = std::clamp(framePacingConfig.frameInFlight, 1u, kMaxFrameInFlight);
+            for (uint32_t i = 0; i < kMaxFrameInFlight; ++i)
+            {
+                // Swapchain acquire and present only work with binary semaphores
                 vk::SemaphoreCreateInfo semaphoreCI{};
                 imageAvailableSemaphores.push_back(device.createSemaphore(semaphoreCI));
                 renderFinishedSemaphores.push_back(device.createSemaphore(semaphoreCI));
@@ -186,17 +314,32 @@ namespace jgw
 
             // Initialize VMA
             vulkanFuncs = vma::functionsFromDispatcher(VULKAN_HPP_DEFAULT_DISPATCHER);
+            vma::AllocatorCreateFlags allocatorFlags = vma::AllocatorCreateFlagBits::eBufferDeviceAddress;
+            if (memoryBudgetSupported)
+                allocatorFlags |= vma::AllocatorCreateFlagBits::eExtMemoryBudget;
+
             vma::AllocatorCreateInfo allocatorCI{
-                .flags = vma::AllocatorCreateFlagBits::eBufferDeviceAddress,
+                .flags = allocatorFlags,
                 .physicalDevice = physicalDevice,
                 .device = device,
                 .pVulkanFunctions = &vulkanFuncs,
                 .instance = instance,
-                .vulkanApiVersion = apiVersion
+                .vulkanApiVersion = this->apiVersion
             };
 
             vmaAllocator = vma::createAllocator(allocatorCI);
 
+            pipelineCache = std::make_unique<VulkanPipelineCache>(device, physicalDevice, kPipelineCacheFile);
+            CreateTexturePools();
+
+            deletionQueue = std::make_unique<DeletionQueue>(device, vmaAllocator, memoryTracker);
+            residency = std::make_unique<ResidencyManager>(*this);
+            textureStreamer = std::make_unique<TextureStreamer>(*this, kMaxFrameInFlight, textureStreamingConfig);
+            frameAllocator = std::make_unique<FrameAllocator>(*this, kMaxFrameInFlight, frameAllocatorConfig);
+
+            if (headless)
+                CreateOffscreenTargets();
+
             depthBuffer = CreateDepthTexture();
         }
         catch (const vk::SystemError& err)
@@ -205,39 +348,64 @@ namespace jgw
             return false;
         }   
 
-        windowHandle = handle;
         return true;
     }
 
     bool VulkanContext::BeginRender()
     {
-        auto extent = swapchainPtr->GetExtent();
+        auto extent = GetRenderExtent();
         if (extent.width <= 0 || extent.height <= 0)
         {
             return false;
         }
 
-        // Wait for the current frame to finish
-        auto result = device.waitForFences(fences[currentFrame], vk::True, UINT64_MAX);
-        if (result != vk::Result::eSuccess)
+        // Wait until the GPU is done with the last submit recorded in this frame slot
+        if (!WaitForValue(slotValues[currentFrame]))
         {
-            spdlog::warn("Failed to wait for fence: {}", vk::to_string(result));
+            spdlog::warn("Failed to wait for frame slot {}", currentFrame);
             return false;
         }
 
-        device.resetFences(fences[currentFrame]);
+        PollPresents();
+        ReadFrameTimestamps();
 
-        // Acquire the next image from the swapchain
-        result = swapchainPtr->AcquireImage(imageAvailableSemaphores[currentFrame]);
-        if (result == vk::Result::eErrorOutOfDateKHR)
+        // One semaphore read covers every frame the queue checks
+        const uint64_t completedValue = GetCompletedValue();
+        deletionQueue->Collect([&](uint64_t frame) {
+            const uint64_t value = GetFrameValue(frame);
+            return value != UINT64_MAX && completedValue >= value;
+        });
+
+        // Resize events of this frame are coalesced into a single recreation
+        if (swapchainDirty)
         {
-            WindowResize();
-            return false;
+            RecreateSwapchain();
+            extent = GetRenderExtent();
+            if (extent.width == 0 || extent.height == 0)
+                return false;
         }
-        else if (result != vk::Result::eSuccess && result != vk::Result::eSuboptimalKHR)
+
+        // The GPU is done with this frame's transient memory
+        frameAllocator->BeginFrame(currentFrame);
+        frameConstantsAddress = 0;
+        frameConstantsData = nullptr;
+        if (parallelRecorder)
+            parallelRecorder->BeginFrame(currentFrame);
+
+        // Acquire the next image from the swapchain, offscreen targets are indexed by the frame slot
+        if (!headless)
         {
-            spdlog::error("Failed to acquire swapchain image: {}", vk::to_string(result));
-            return false;
+            auto result = swapchainPtr->AcquireImage(imageAvailableSemaphores[currentFrame]);
+            if (result == vk::Result::eErrorOutOfDateKHR)
+            {
+                RecreateSwapchain();
+                return false;
+            }
+            else if (result != vk::Result::eSuccess && result != vk::Result::eSuboptimalKHR)
+            {
+                spdlog::error("Failed to acquire swapchain image: {}", vk::to_string(result));
+                return false;
+            }
         }
 
         // Begin command buffer recording
@@ -246,49 +414,132 @@ namespace jgw
         };
         commandBuffers[currentFrame].begin(beginInfo);
 
+        if (timestampPool)
+        {
+            commandBuffers[currentFrame].resetQueryPool(timestampPool, currentFrame * 2, 2);
+            commandBuffers[currentFrame].writeTimestamp2(vk::PipelineStageFlagBits2::eNone, timestampPool, currentFrame * 2);
+        }
+
+        // Copies into new storage go ahead of the draws of this frame, earlier frames keep reading the old storage
+        {
+            AllocationScope allocationScope(EAllocationSubsystem::Streaming);
+            textureStreamer->Update(commandBuffers[currentFrame], currentFrame, frameIndex);
+            residency->Update(commandBuffers[currentFrame], frameIndex);
+        }
+        DefragmentStep(commandBuffers[currentFrame]);
+
         return true;
     }
 
     void VulkanContext::EndRender()
     {
+        if (timestampPool)
+        {
+            commandBuffers[currentFrame].writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands, timestampPool, currentFrame * 2 + 1);
+            timestampsWritten[currentFrame] = true;
+        }
+
+        lastDrawStats = currentDrawStats;
+        currentDrawStats = {};
+
+        textureStreamer->EndFrame(commandBuffers[currentFrame]);
+
         // End command buffer recording
         commandBuffers[currentFrame].end();
 
-        // Submit the command buffer
-        vk::SubmitInfo submitInfo{
-            .waitSemaphoreCount = 1,
-            .pWaitSemaphores = &imageAvailableSemaphores[currentFrame],
-            .pWaitDstStageMask = new vk::PipelineStageFlags[1]{ vk::PipelineStageFlagBits::eColorAttachmentOutput },
-            .commandBufferCount = 1,
-            .pCommandBuffers = &commandBuffers[currentFrame],
-            .signalSemaphoreCount = 1,
-            .pSignalSemaphores = &renderFinishedSemaphores[currentFrame]
-        };
-        graphicsQueue.submit(submitInfo, fences[currentFrame]);
+        // Only written, the mapped memory may be write combined and slow to read back
+        if (lateLatch && frameConstantsData)
+        {
+            lateLatch(frameConstants);
+            memcpy(frameConstantsData, &frameConstants, sizeof(FrameConstants));
+        }
+        frameAllocator->Flush();
+
+        // Submit the command buffer, there is nothing to acquire or present without a swapchain
+        if (headless)
+            slotValues[currentFrame] = SubmitCommandBuffer(commandBuffers[currentFrame]);
+        else
+            slotValues[currentFrame] = SubmitCommandBuffer(commandBuffers[currentFrame], imageAvailableSemaphores[currentFrame], renderFinishedSemaphores[currentFrame]);
+        frameValues[frameIndex % kFrameHistory] = slotValues[currentFrame];
+        latency.OnSubmit(glfwGetTime());
+
+        if (headless)
+        {
+            currentFrame = (currentFrame + 1) % frameInFlight;
+            ++frameIndex;
+            return;
+        }
 
         // Present the swapchain image
+        const uint32_t imageIndex = swapchainPtr->GetImageIndex();
+        const uint64_t currentPresentId = ++presentId;
+        vk::PresentIdKHR presentIdInfo{
+            .swapchainCount = 1,
+            .pPresentIds = &currentPresentId
+        };
+
         vk::PresentInfoKHR presentInfo{
+            .pNext = presentWaitEnabled ? &presentIdInfo : nullptr,
             .waitSemaphoreCount = 1,
             .pWaitSemaphores = &renderFinishedSemaphores[currentFrame],
             .swapchainCount = 1,
             .pSwapchains = swapchainPtr->GetHandle(),
-            .pImageIndices = new uint32_t[1]{ swapchainPtr->GetImageIndex() }
+            .pImageIndices = &imageIndex
         };
         auto result = graphicsQueue.presentKHR(presentInfo);
+        const double presentCallTime = glfwGetTime();
         if (result == vk::Result::eErrorOutOfDateKHR || result == vk::Result::eSuboptimalKHR)
         {
-            WindowResize();
+            swapchainDirty = true;
         }
         else if (result != vk::Result::eSuccess)
         {
             spdlog::error("Failed to present swapchain image: {}", vk::to_string(result));
         }
+        else if (presentWaitEnabled)
+        {
+            latency.OnPresentQueued(currentPresentId);
+            presentWaiter->Queue(*swapchainPtr->GetHandle(), currentPresentId);
+        }
+        else
+        {
+            latency.OnPresentCall(presentCallTime);
+        }
 
         currentFrame = (currentFrame + 1) % frameInFlight;
+        ++frameIndex;
+    }
+
+    void VulkanContext::RecordParallel(JobQueue& jobQueue, uint32_t taskCount, FunctionRef<void(vk::CommandBuffer, uint32_t)> record)
+    {
+        // Pools are created on first use, one per worker thread of the queue and frame slot
+        if (!parallelRecorder)
+        {
+            parallelRecorder = std::make_unique<ParallelRecorder>(device, graphicsFamilyIndex, kMaxFrameInFlight, jobQueue.ThreadCount());
+            parallelRecorder->BeginFrame(currentFrame);
+        }
+
+        const vk::Format colorFormat = GetColorFormat();
+        vk::CommandBufferInheritanceRenderingInfo renderingInfo{
+            .colorAttachmentCount = 1,
+            .pColorAttachmentFormats = &colorFormat,
+            .depthAttachmentFormat = depthBuffer->GetFormat(),
+            .rasterizationSamples = vk::SampleCountFlagBits::e1
+        };
+
+        vk::CommandBufferInheritanceInfo inheritanceInfo{
+            .pNext = &renderingInfo
+        };
+
+        const auto& secondaryCommandBuffers = parallelRecorder->Record(jobQueue, inheritanceInfo, taskCount, record);
+        GetCommandBuffer().executeCommands(secondaryCommandBuffers);
     }
 
     void VulkanContext::BeginCommand()
     {
+        // The command buffer of this slot may still be executing a frame
+        WaitForValue(slotValues[currentFrame]);
+
         auto commandBuffer = GetCommandBuffer();
 
         vk::CommandBufferBeginInfo beginInfo{
@@ -302,20 +553,223 @@ namespace jgw
         auto commandBuffer = GetCommandBuffer();
         commandBuffer.end();
 
-        // Submit
-        vk::SubmitInfo submitInfo{
-            .commandBufferCount = 1,
-            .pCommandBuffers = &commandBuffer,
+        // Submits complete in order, waiting for this one covers everything submitted before
+        slotValues[currentFrame] = SubmitCommandBuffer(commandBuffer);
+        WaitForValue(slotValues[currentFrame]);
+    }
+
+    uint64_t VulkanContext::SubmitCommandBuffer(vk::CommandBuffer commandBuffer, vk::Semaphore waitSemaphore, vk::Semaphore signalSemaphore)
+    {
+        const vk::SemaphoreSubmitInfo waitInfo{
+            .semaphore = waitSemaphore,
+            .stageMask = vk::PipelineStageFlagBits2::eColorAttachmentOutput
         };
-        graphicsQueue.submit(submitInfo, nullptr);
-        graphicsQueue.waitIdle();
+
+        const std::array<vk::SemaphoreSubmitInfo, 2> signalInfos = { {
+            {
+                .semaphore = timelineSemaphore,
+                .value = ++timelineValue,
+                .stageMask = vk::PipelineStageFlagBits2::eAllCommands
+            },
+            {
+                .semaphore = signalSemaphore,
+                .stageMask = vk::PipelineStageFlagBits2::eAllCommands
+            }
+        } };
+
+        const vk::CommandBufferSubmitInfo commandBufferInfo{
+            .commandBuffer = commandBuffer
+        };
+
+        const vk::SubmitInfo2 submitInfo{
+            .waitSemaphoreInfoCount = waitSemaphore ? 1u : 0u,
+            .pWaitSemaphoreInfos = &waitInfo,
+            .commandBufferInfoCount = 1,
+            .pCommandBufferInfos = &commandBufferInfo,
+            .signalSemaphoreInfoCount = signalSemaphore ? 2u : 1u,
+            .pSignalSemaphoreInfos = signalInfos.data()
+        };
+        graphicsQueue.submit2(submitInfo);
+
+        return timelineValue;
     }
 
-    void VulkanContext::WindowResize()
+    uint64_t VulkanContext::GetCompletedValue() const
     {
-        device.waitIdle();
-        swapchainPtr->Create(windowHandle);
-        depthBuffer = CreateDepthTexture();
+        return device.getSemaphoreCounterValue(timelineSemaphore);
+    }
+
+    bool VulkanContext::WaitForValue(uint64_t value, uint64_t timeout) const
+    {
+        if (value == 0)
+            return true;
+
+        const vk::SemaphoreWaitInfo waitInfo{
+            .semaphoreCount = 1,
+            .pSemaphores = &timelineSemaphore,
+            .pValues = &value
+        };
+        return device.waitSemaphores(waitInfo, timeout) == vk::Result::eSuccess;
+    }
+
+    uint64_t VulkanContext::GetFrameValue(uint64_t frame) const
+    {
+        if (frame >= frameIndex)
+            return UINT64_MAX;
+
+        // Older frames were waited on before their slot was reused
+        if (frameIndex - frame > kFrameHistory)
+            return 0;
+
+        return frameValues[frame % kFrameHistory];
+    }
+
+    bool VulkanContext::IsFrameComplete(uint64_t frame) const
+    {
+        const uint64_t value = GetFrameValue(frame);
+        return value != UINT64_MAX && GetCompletedValue() >= value;
+    }
+
+    bool VulkanContext::WaitForFrame(uint64_t frame, uint64_t timeout) const
+    {
+        const uint64_t value = GetFrameValue(frame);
+        return value != UINT64_MAX && WaitForValue(value, timeout);
+    }
+
+    void VulkanContext::RecreateSwapchain()
+    {
+        swapchainDirty = false;
+        latency.Reset();
+        if (presentWaiter)
+            presentWaiter->Reset();
+
+        // Frames up to the current one may still render to or present from the old images
+        if (headless)
+        {
+            CreateOffscreenTargets();
+        }
+        else
+        {
+            RetiredSwapchain retired;
+            swapchainPtr->Create(windowHandle, &retired);
+            for (auto& imageView : retired.imageViews)
+                DeferDestroy(imageView);
+            DeferDestroy(retired.swapchain);
+        }
+
+        const vk::Format depthFormat = depthBuffer->GetFormat();
+        DeferDestroy(std::move(depthBuffer));
+        depthBuffer = CreateDepthTexture(depthFormat);
+    }
+
+    void VulkanContext::CreateOffscreenTargets()
+    {
+        int width, height;
+        glfwGetFramebufferSize(windowHandle, &width, &height);
+        offscreenExtent = vk::Extent2D{ static_cast<uint32_t>(std::max(width, 0)), static_cast<uint32_t>(std::max(height, 0)) };
+
+        for (auto& target : offscreenTargets)
+            DeferDestroy(std::move(target));
+        offscreenTargets.clear();
+
+        if (offscreenExtent.width == 0 || offscreenExtent.height == 0)
+            return;
+
+        // One target per frame slot, so a frame never renders into an image an earlier frame in flight still uses
+        const TextureDesc desc{
+            .usageFlags = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eSampled,
+            .format = kOffscreenFormat,
+            .extent = {
+                .width = offscreenExtent.width, .height = offscreenExtent.height, .depth = 1
+            }
+        };
+        for (uint32_t i = 0; i < kMaxFrameInFlight; ++i)
+            offscreenTargets.push_back(CreateTexture(desc));
+    }
+
+    vk::Extent2D VulkanContext::GetRenderExtent() const
+    {
+        return headless ? offscreenExtent : swapchainPtr->GetExtent();
+    }
+
+    vk::Format VulkanContext::GetColorFormat() const
+    {
+        return headless ? kOffscreenFormat : swapchainPtr->GetFormat();
+    }
+
+    vk::Image VulkanContext::GetColorImage() const
+    {
+        return headless ? offscreenTargets[currentFrame]->GetImage() : swapchainPtr->GetImage();
+    }
+
+    vk::ImageView VulkanContext::GetColorView() const
+    {
+        return headless ? offscreenTargets[currentFrame]->GetView() : swapchainPtr->GetImageView();
+    }
+
+    uint32_t VulkanContext::GetColorImageCount() const
+    {
+        return headless ? kMaxFrameInFlight : swapchainPtr->GetImageCount();
+    }
+
+    void VulkanContext::SetPresentMode(vk::PresentModeKHR mode)
+    {
+        framePacingConfig.presentMode = mode;
+        if (!swapchainPtr)
+            return;
+
+        swapchainPtr->SetPresentMode(mode);
+        swapchainDirty = true;
+    }
+
+    void VulkanContext::SetSwapchainImageCount(uint32_t count)
+    {
+        framePacingConfig.swapchainImageCount = count;
+        if (!swapchainPtr)
+            return;
+
+        swapchainPtr->SetImageCount(count);
+        swapchainDirty = true;
+    }
+
+    void VulkanContext::SetFrameInFlight(uint32_t count)
+    {
+        // Slots beyond the active count keep their last timeline value and are waited on when reused, so shrinking and growing needs no wait
+        framePacingConfig.frameInFlight = std::clamp(count, 1u, kMaxFrameInFlight);
+        frameInFlight = framePacingConfig.frameInFlight;
+    }
+
+    void VulkanContext::MarkInputSampled()
+    {
+        MarkInputSampled(glfwGetTime());
+    }
+
+    void VulkanContext::MarkInputSampled(double time)
+    {
+        latency.OnInput(time);
+    }
+
+    void VulkanContext::PollPresents()
+    {
+        // The waiter timed each present when its wait returned, only the bookkeeping happens here
+        if (presentWaiter)
+            presentWaiter->Collect(latency);
+    }
+
+    void VulkanContext::ReadFrameTimestamps()
+    {
+        // The slot has been waited on, so the queries of the frame it ran last are available
+        if (!timestampsWritten[currentFrame])
+            return;
+        timestampsWritten[currentFrame] = false;
+
+        std::array<uint64_t, 2> timestamps{};
+        const vk::Result result = device.getQueryPoolResults(timestampPool, currentFrame * 2, 2, sizeof(timestamps), timestamps.data(), sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+        if (result != vk::Result::eSuccess)
+            return;
+
+        const uint64_t ticks = ((timestamps[1] & timestampMask) - (timestamps[0] & timestampMask)) & timestampMask;
+        gpuFrameTimeMs = static_cast<float>(static_cast<double>(ticks) * timestampPeriod * 1e-6);
     }
 
     void VulkanContext::WaitDeviceIdle()
@@ -330,16 +784,61 @@ namespace jgw
             graphicsQueue.waitIdle();
     }
 
-    std::unique_ptr<VulkanPipeline> VulkanContext::CreateGraphicsPipeline(PipelineBuilder& pd)
+    std::shared_ptr<VulkanPipeline> VulkanContext::CreateGraphicsPipeline(PipelineBuilder& pd)
     {
-        auto shaderStages = pd.BuildShaderStages(device);
-        auto pipelineLayout = device.createPipelineLayout(pd.PipelineLayoutCI());
+        std::vector<std::shared_ptr<VulkanShaderModule>> shaderModules;
+        std::vector<vk::PipelineShaderStageCreateInfo> shaderStages;
+        std::vector<vk::Format> colorFormats = { GetColorFormat() };
+        const vk::Format depthFormat = depthBuffer->GetFormat();
+
+        // Shaders by code rather than path, the rest of the key is the builder state and the attachment formats
+        std::string key;
+        for (const auto& [stage, filename] : pd.ShaderFiles())
+        {
+            auto shaderModule = GetShaderModule(filename);
+            if (!shaderModule)
+                return nullptr;
+
+            AppendKey(key, static_cast<uint32_t>(stage));
+            AppendKey(key, shaderModule->CodeHash());
+            shaderStages.push_back({
+                .stage = stage,
+                .module = shaderModule->Handle(),
+                .pName = "main"
+            });
+            shaderModules.push_back(std::move(shaderModule));
+        }
+        for (vk::Format format : colorFormats)
+            AppendKey(key, static_cast<uint32_t>(format));
+        AppendKey(key, static_cast<uint32_t>(depthFormat));
+        pd.AppendStateKey(key);
+        pd.AppendLayoutKey(key);
+
+        // Extension structs are not part of the key
+        const bool shareable = !pd.HasExtensions();
+        std::weak_ptr<VulkanPipeline>* cached = nullptr;
+        if (shareable)
+        {
+            cached = &graphicsPipelineCache[HashBytes(key.data(), key.size())];
+            if (auto pipeline = cached->lock())
+            {
+                if (pipeline->Key() == key)
+                {
+                    ++pipelineStats.pipelinesShared;
+                    return pipeline;
+                }
+
+                // Hash collision, leave the cached one alone
+                cached = nullptr;
+            }
+        }
+
+        auto pipelineLayout = GetPipelineLayout(pd);
 
-        std::vector<vk::Format> colorFormats = { swapchainPtr->GetFormat() };
         vk::PipelineRenderingCreateInfo renderingCI{
             .colorAttachmentCount = static_cast<uint32_t>(colorFormats.size()),
             .pColorAttachmentFormats = colorFormats.data(),
-            .depthAttachmentFormat = depthBuffer->GetFormat()
+            .depthAttachmentFormat = depthFormat
         };
 
         vk::GraphicsPipelineCreateInfo pipelineCI{
@@ -355,23 +854,77 @@ namespace jgw
             .pDepthStencilState = &pd.DepthStencilStateCI(),
             .pColorBlendState = &pd.ColorBlendStateCI(),
             .pDynamicState = &pd.DynamicStateCI(),
-            .layout = pipelineLayout,
+            .layout = pipelineLayout->Handle(),
         };
 
-        auto ret = device.createGraphicsPipeline(nullptr, pipelineCI);
+        auto ret = device.createGraphicsPipeline(pipelineCache->Handle(), pipelineCI);
+        if (ret.result != vk::Result::eSuccess)
+        {
+            spdlog::error("Failed to create graphics pipeline: {}", vk::to_string(ret.result));
+            return nullptr;
+        }
+
+        ++pipelineStats.pipelinesCreated;
+        auto pipeline = std::make_shared<VulkanPipeline>(device, ret.value, std::move(pipelineLayout), std::move(shaderModules), std::move(key));
+        if (cached)
+            *cached = pipeline;
+        return pipeline;
+    }
 
-        for (auto& shaderStage : shaderStages)
+    std::shared_ptr<VulkanShaderModule> VulkanContext::GetShaderModule(const std::string& filename)
+    {
+        auto& cached = shaderModuleCache[filename];
+        if (auto shaderModule = cached.lock())
         {
-            device.destroyShaderModule(shaderStage.module);
+            ++pipelineStats.shaderModulesShared;
+            return shaderModule;
         }
 
-        if (ret.result != vk::Result::eSuccess)
+        std::ifstream is(filename, std::ios::binary | std::ios::ate);
+        if (!is.is_open())
         {
-            spdlog::error("Failed to create graphics pipeline: {}", vk::to_string(ret.result));
+            spdlog::error("Could not open shader file {}", filename);
             return nullptr;
         }
 
-        return std::make_unique<VulkanPipeline>(device, ret.value, pipelineLayout);
+        std::vector<char> code(static_cast<size_t>(is.tellg()));
+        is.seekg(0);
+        is.read(code.data(), code.size());
+
+        ++pipelineStats.shaderModulesCreated;
+        auto shaderModule = std::make_shared<VulkanShaderModule>(device, code);
+        cached = shaderModule;
+        return shaderModule;
+    }
+
+    std::shared_ptr<VulkanPipelineLayout> VulkanContext::GetPipelineLayout(PipelineBuilder& pd)
+    {
+        // Set layouts are keyed by handle, they outlive the pipelines built from them
+        std::string key;
+        pd.AppendLayoutKey(key);
+
+        std::weak_ptr<VulkanPipelineLayout>* cached = nullptr;
+        if (!pd.PipelineLayoutCI().pNext)
+        {
+            cached = &pipelineLayoutCache[HashBytes(key.data(), key.size())];
+            if (auto pipelineLayout = cached->lock())
+            {
+                if (pipelineLayout->Key() == key)
+                {
+                    ++pipelineStats.layoutsShared;
+                    return pipelineLayout;
+                }
+
+                // Hash collision, leave the cached one alone
+                cached = nullptr;
+            }
+        }
+
+        ++pipelineStats.layoutsCreated;
+        auto pipelineLayout = std::make_shared<VulkanPipelineLayout>(device, pd.PipelineLayoutCI(), std::move(key));
+        if (cached)
+            *cached = pipelineLayout;
+        return pipelineLayout;
     }
 
     std::unique_ptr<VulkanBuffer> VulkanContext::CreateBuffer(
@@ -381,17 +934,131 @@ namespace jgw
         vma::MemoryUsage memoryUsage
     )
     {
-        return std::make_unique<VulkanBuffer>(size, bufferUsage, vmaAllocator, flags, memoryUsage);
+        EMemoryCategory category = EMemoryCategory::Other;
+        if (flags & vma::AllocationCreateFlagBits::eHostAccessAllowTransferInstead)
+        {
+            // Dynamic data is rewritten every frame, never evicted or moved
+            category = EMemoryCategory::Dynamic;
+        }
+        else if (bufferUsage == vk::BufferUsageFlagBits::eTransferSrc)
+        {
+            category = EMemoryCategory::Staging;
+        }
+        else if (bufferUsage & (vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eIndirectBuffer))
+        {
+            // Allow the defragmenter to copy geometry out of its current allocation
+            category = EMemoryCategory::Geometry;
+            bufferUsage |= vk::BufferUsageFlagBits::eTransferSrc;
+        }
+
+        std::unique_ptr<VulkanBuffer> buffer;
+        try
+        {
+            buffer = std::make_unique<VulkanBuffer>(size, bufferUsage, vmaAllocator, flags, memoryUsage);
+        }
+        catch (const std::runtime_error& err)
+        {
+            // Out of device memory, make room with resources no frame in flight uses and retry once
+            spdlog::warn("{}, evicting cold resources", err.what());
+            if (!residency || residency->EvictNow(size, frameIndex, frameInFlight) == 0)
+                throw;
+
+            buffer = std::make_unique<VulkanBuffer>(size, bufferUsage, vmaAllocator, flags, memoryUsage);
+        }
+
+        buffer->tracker = &memoryTracker;
+        buffer->category = category;
+        memoryTracker.Add(category, buffer->vmaAllocationInfo.size);
+
+        if (category == EMemoryCategory::Geometry && residency)
+        {
+            buffer->residency = residency.get();
+            residency->Register(buffer.get());
+        }
+
+        return buffer;
+    }
+
+    void VulkanContext::SetFrameConstants(const FrameConstants& constants)
+    {
+        const FrameAllocation allocation = frameAllocator->Push(constants);
+        frameConstantsAddress = allocation.address;
+        frameConstantsData = static_cast<FrameConstants*>(allocation.data);
+        frameConstants = constants;
+    }
+
+    std::unique_ptr<VulkanBuffer> VulkanContext::CreateDynamicBuffer(vk::DeviceSize size, vk::BufferUsageFlags bufferUsage)
+    {
+        // One region per frame slot, aligned for any kind of binding
+        const auto& limits = physicalDevice.getProperties().limits;
+        const vk::DeviceSize alignment = std::max({ limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment, vk::DeviceSize(16) });
+        const vk::DeviceSize regionSize = (size + alignment - 1) / alignment * alignment;
+        size = regionSize * kMaxFrameInFlight;
+
+        auto buffer = CreateBuffer(
+            size,
+            bufferUsage | vk::BufferUsageFlagBits::eTransferDst,
+            vma::AllocationCreateFlagBits::eHostAccessSequentialWrite | vma::AllocationCreateFlagBits::eHostAccessAllowTransferInstead,
+            vma::MemoryUsage::eAutoPreferDevice
+        );
+
+        if (buffer->IsHostVisible())
+        {
+            buffer->Map();
+        }
+        else
+        {
+            buffer->staging = CreateBuffer(
+                size,
+                vk::BufferUsageFlagBits::eTransferSrc,
+                vma::AllocationCreateFlagBits::eMapped | vma::AllocationCreateFlagBits::eHostAccessSequentialWrite
+            );
+        }
+        buffer->regionSize = regionSize;
+
+        return buffer;
     }
 
     std::unique_ptr<VulkanTexture> VulkanContext::CreateTexture(const TextureDesc& desc, const VmaAllocationDesc& allocDesc)
     {
-        return std::make_unique<VulkanTexture>(device, vmaAllocator, desc, allocDesc);
+        const VmaAllocationDesc chosenAllocDesc = ChooseTextureAllocation(desc, allocDesc);
+
+        std::unique_ptr<VulkanTexture> texture;
+        try
+        {
+            texture = std::make_unique<VulkanTexture>(device, vmaAllocator, desc, chosenAllocDesc);
+        }
+        catch (const std::runtime_error& err)
+        {
+            spdlog::warn("{}, evicting cold resources", err.what());
+            const vk::ImageCreateInfo imageCI = VulkanTexture::BuildImageCI(desc);
+            vk::DeviceImageMemoryRequirements imageRequirements{
+                .pCreateInfo = &imageCI
+            };
+            const vk::DeviceSize size = device.getImageMemoryRequirements(imageRequirements).memoryRequirements.size;
+            if (!residency || residency->EvictNow(size, frameIndex, frameInFlight) == 0)
+                throw;
+
+            texture = std::make_unique<VulkanTexture>(device, vmaAllocator, desc, chosenAllocDesc);
+        }
+
+        const bool renderTarget = static_cast<bool>(desc.usageFlags & (vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eDepthStencilAttachment));
+        texture->tracker = &memoryTracker;
+        texture->category = renderTarget ? EMemoryCategory::RenderTarget : EMemoryCategory::Texture;
+        memoryTracker.Add(texture->category, texture->vmaAllocationInfo.size);
+
+        if (!renderTarget && residency)
+        {
+            texture->residency = residency.get();
+            residency->Register(texture.get());
+        }
+
+        return texture;
     }
 
     std::unique_ptr<VulkanTexture> VulkanContext::CreateDepthTexture(vk::Format depthFormat)
     {
-        auto extent = swapchainPtr->GetExtent();
+        auto extent = GetRenderExtent();
         const TextureDesc desc{
             .usageFlags = vk::ImageUsageFlagBits::eDepthStencilAttachment,
             .format = depthFormat,
@@ -401,16 +1068,357 @@ namespace jgw
             .aspectMask = vk::ImageAspectFlagBits::eDepth
         };
 
-        const VmaAllocationDesc allocDesc{
-            .flags = vma::AllocationCreateFlagBits::eDedicatedMemory,
-            .usage = vma::MemoryUsage::eAutoPreferDevice
+        return CreateTexture(desc);
+    }
+
+    vma::Allocation VulkanContext::AllocateImageMemory(const vk::MemoryRequirements& requirements)
+    {
+        vma::AllocationCreateInfo allocationCI{
+            .requiredFlags = vk::MemoryPropertyFlagBits::eDeviceLocal
+        };
+
+        vma::Allocation allocation{};
+        vma::AllocationInfo allocationInfo{};
+        auto result = vmaAllocator.allocateMemory(&requirements, &allocationCI, &allocation, &allocationInfo);
+        if (result != vk::Result::eSuccess)
+        {
+            spdlog::error("Failed to allocate image memory: {}", vk::to_string(result));
+            return {};
+        }
+
+        memoryTracker.Add(EMemoryCategory::RenderTarget, allocationInfo.size);
+        return allocation;
+    }
+
+    void VulkanContext::BindImageMemory(vma::Allocation allocation, vk::Image image)
+    {
+        vmaAllocator.bindImageMemory(allocation, image);
+    }
+
+    void VulkanContext::FreeImageMemory(vma::Allocation allocation)
+    {
+        memoryTracker.Remove(EMemoryCategory::RenderTarget, vmaAllocator.getAllocationInfo(allocation).size);
+        vmaAllocator.freeMemory(allocation);
+    }
+
+    std::shared_ptr<VulkanSampler> VulkanContext::GetSampler(const vk::SamplerCreateInfo& samplerCI)
+    {
+        // Extension structs are not part of the key
+        if (samplerCI.pNext)
+            return std::make_shared<VulkanSampler>(device, samplerCI);
+
+        uint64_t hash = kHashSeed;
+        HashCombine(hash, static_cast<uint32_t>(samplerCI.flags));
+        HashCombine(hash, static_cast<uint32_t>(samplerCI.magFilter));
+        HashCombine(hash, static_cast<uint32_t>(samplerCI.minFilter));
+        HashCombine(hash, static_cast<uint32_t>(samplerCI.mipmapMode));
+        HashCombine(hash, static_cast<uint32_t>(samplerCI.addressModeU));
+        HashCombine(hash, static_cast<uint32_t>(samplerCI.addressModeV));
+        HashCombine(hash, static_cast<uint32_t>(samplerCI.addressModeW));
+        HashCombine(hash, samplerCI.mipLodBias);
+        HashCombine(hash, samplerCI.anisotropyEnable);
+        HashCombine(hash, samplerCI.maxAnisotropy);
+        HashCombine(hash, samplerCI.compareEnable);
+        HashCombine(hash, static_cast<uint32_t>(samplerCI.compareOp));
+        HashCombine(hash, samplerCI.minLod);
+        HashCombine(hash, samplerCI.maxLod);
+        HashCombine(hash, static_cast<uint32_t>(samplerCI.borderColor));
+        HashCombine(hash, samplerCI.unnormalizedCoordinates);
+
+        auto& cached = samplerCache[hash];
+        if (auto sampler = cached.lock())
+        {
+            if (sampler->CreateInfo() == samplerCI)
+                return sampler;
+
+            // Hash collision, leave the cached one alone
+            return std::make_shared<VulkanSampler>(device, samplerCI);
+        }
+
+        auto sampler = std::make_shared<VulkanSampler>(device, samplerCI);
+        cached = sampler;
+        return sampler;
+    }
+
+    std::vector<MemoryPoolStats> VulkanContext::GetTexturePoolStats() const
+    {
+        std::vector<MemoryPoolStats> stats;
+        stats.reserve(texturePools.size());
+        for (const auto& pool : texturePools)
+        {
+            stats.push_back(pool->GetStats());
+        }
+        return stats;
+    }
+
+    std::vector<MemoryHeapStats> VulkanContext::GetHeapStats() const
+    {
+        const vk::PhysicalDeviceMemoryProperties* memoryProperties = vmaAllocator.getMemoryProperties();
+        std::vector<vma::Budget> budgets = vmaAllocator.getHeapBudgets();
+
+        std::vector<MemoryHeapStats> stats;
+        stats.reserve(budgets.size());
+        for (uint32_t i = 0; i < budgets.size(); ++i)
+        {
+            const auto& heap = memoryProperties->memoryHeaps[i];
+            stats.push_back({
+                .heapIndex = i,
+                .deviceLocal = static_cast<bool>(heap.flags & vk::MemoryHeapFlagBits::eDeviceLocal),
+                .size = heap.size,
+                .budget = budgets[i].budget,
+                .usage = budgets[i].usage,
+                .blockBytes = budgets[i].statistics.blockBytes,
+                .allocationBytes = budgets[i].statistics.allocationBytes,
+                .blockCount = budgets[i].statistics.blockCount,
+                .allocationCount = budgets[i].statistics.allocationCount
+            });
+        }
+        return stats;
+    }
+
+    bool VulkanContext::DumpMemoryStats(const char* filename) const
+    {
+        std::ofstream os(filename);
+        if (!os.is_open())
+        {
+            spdlog::error("Could not open memory stats file {}", filename);
+            return false;
+        }
+
+        os << "{\n  \"heaps\": [";
+        auto heaps = GetHeapStats();
+        for (size_t i = 0; i < heaps.size(); ++i)
+        {
+            const auto& h = heaps[i];
+            os << (i ? "," : "") << "\n    { \"index\": " << h.heapIndex
+               << ", \"deviceLocal\": " << (h.deviceLocal ? "true" : "false")
+               << ", \"size\": " << h.size
+               << ", \"budget\": " << h.budget
+               << ", \"usage\": " << h.usage
+               << ", \"blockBytes\": " << h.blockBytes
+               << ", \"allocationBytes\": " << h.allocationBytes
+               << ", \"blockCount\": " << h.blockCount
+               << ", \"allocationCount\": " << h.allocationCount << " }";
+        }
+
+        os << "\n  ],\n  \"categories\": {";
+        for (uint32_t i = 0; i < static_cast<uint32_t>(EMemoryCategory::Count); ++i)
+        {
+            const auto category = static_cast<EMemoryCategory>(i);
+            const auto stats = memoryTracker.Get(category);
+            os << (i ? "," : "") << "\n    \"" << ToString(category) << "\": { \"bytes\": " << stats.bytes << ", \"count\": " << stats.count << " }";
+        }
+
+        os << "\n  },\n  \"texturePools\": [";
+        auto pools = GetTexturePoolStats();
+        for (size_t i = 0; i < pools.size(); ++i)
+        {
+            const auto& p = pools[i];
+            os << (i ? "," : "") << "\n    { \"name\": \"" << p.name << "\""
+               << ", \"blockSize\": " << p.blockSize
+               << ", \"blockBytes\": " << p.blockBytes
+               << ", \"allocationBytes\": " << p.allocationBytes
+               << ", \"blockCount\": " << p.blockCount
+               << ", \"allocationCount\": " << p.allocationCount << " }";
+        }
+
+        // VMA emits its own detailed JSON, embed it as is
+        char* vmaStats = vmaAllocator.buildStatsString(vk::True);
+        os << "\n  ],\n  \"vma\": " << vmaStats << "\n}\n";
+        vmaAllocator.freeStatsString(vmaStats);
+
+        spdlog::info("Memory stats written to {}", filename);
+        return true;
+    }
+
+    void VulkanContext::GetDeviceLocalBudget(vk::DeviceSize& usage, vk::DeviceSize& budget) const
+    {
+        const vk::PhysicalDeviceMemoryProperties* memoryProperties = vmaAllocator.getMemoryProperties();
+
+        std::array<vma::Budget, VK_MAX_MEMORY_HEAPS> budgets{};
+        vmaAllocator.getHeapBudgets(budgets.data());
+
+        usage = 0;
+        budget = 0;
+        for (uint32_t i = 0; i < memoryProperties->memoryHeapCount; ++i)
+        {
+            if (memoryProperties->memoryHeaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal)
+            {
+                usage += budgets[i].usage;
+                budget += budgets[i].budget;
+            }
+        }
+    }
+
+    void VulkanContext::ImmediateSubmit(const std::function<void(vk::CommandBuffer)>& record)
+    {
+        vk::CommandBufferBeginInfo beginInfo{
+            .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit
+        };
+        immediateCommandBuffer.begin(beginInfo);
+
+        record(immediateCommandBuffer);
+
+        immediateCommandBuffer.end();
+
+        WaitForValue(SubmitCommandBuffer(immediateCommandBuffer));
+    }
+
+    void VulkanContext::StartDefragmentation()
+    {
+        if (defragContext)
+            return;
+
+        // Only the default pools are defragmented, the texture pools hold images referenced by descriptors
+        vma::DefragmentationInfo defragInfo{
+            .flags = vma::DefragmentationFlagBits::eFlagAlgorithmFast,
+            .maxBytesPerPass = 16ull << 20,
+            .maxAllocationsPerPass = 64
         };
 
-        return CreateTexture(desc, allocDesc);
+        auto result = vmaAllocator.beginDefragmentation(&defragInfo, &defragContext);
+        if (result != vk::Result::eSuccess)
+        {
+            spdlog::error("Failed to begin defragmentation: {}", vk::to_string(result));
+        }
+    }
+
+    void VulkanContext::DefragmentStep(vk::CommandBuffer commandBuffer)
+    {
+        if (!defragContext)
+            return;
+
+        vk::Result result = vk::Result::eIncomplete;
+        if (defragPassPending)
+        {
+            if (!IsFrameComplete(defragFrame))
+                return;
+
+            result = EndDefragmentationPass();
+        }
+
+        if (result == vk::Result::eIncomplete)
+        {
+            result = vmaAllocator.beginDefragmentationPass(defragContext, &defragPass);
+            if (result == vk::Result::eIncomplete)
+            {
+                defragOldBuffers.assign(defragPass.moveCount, vk::Buffer{});
+
+                bool copied = false;
+                for (uint32_t i = 0; i < defragPass.moveCount; ++i)
+                {
+                    auto& move = defragPass.pMoves[i];
+
+                    // Images, buffers referenced by address or descriptors and persistently mapped ones stay in place,
+                    // as do buffers the residency manager is moving
+                    auto* buffer = static_cast<VulkanBuffer*>(vmaAllocator.getAllocationInfo(move.srcAllocation).pUserData);
+                    if (buffer == nullptr || !buffer->IsMovable() || residency->IsMoving(buffer))
+                    {
+                        move.operation = vma::DefragmentationMoveOperation::eIgnore;
+                        continue;
+                    }
+
+                    vk::BufferCreateInfo bufferCI{
+                        .size = buffer->size,
+                        .usage = buffer->bufferUsage
+                    };
+                    vk::Buffer newBuffer = device.createBuffer(bufferCI);
+                    vmaAllocator.bindBufferMemory(move.dstTmpAllocation, newBuffer);
+
+                    vk::BufferCopy region{
+                        .srcOffset = 0,
+                        .dstOffset = 0,
+                        .size = buffer->size
+                    };
+                    commandBuffer.copyBuffer(buffer->buffer, newBuffer, region);
+
+                    // Draws from here on bind the new buffer, the old one lives until the copy has completed
+                    defragOldBuffers[i] = buffer->buffer;
+                    buffer->buffer = newBuffer;
+                    buffer->defragmenting = true;
+                    copied = true;
+                }
+
+                defragFrame = frameIndex;
+                defragPassPending = true;
+                if (copied)
+                {
+                    vk::MemoryBarrier barrier{
+                        .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+                        .dstAccessMask = vk::AccessFlagBits::eMemoryRead
+                    };
+                    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAllCommands, {}, 1, &barrier, 0, nullptr, 0, nullptr);
+                    return;
+                }
+
+                // Nothing to wait for when every move was ignored
+                result = EndDefragmentationPass();
+            }
+        }
+
+        if (result == vk::Result::eSuccess)
+        {
+            vma::DefragmentationStats stats{};
+            vmaAllocator.endDefragmentation(defragContext, &stats);
+            defragContext = nullptr;
+
+            spdlog::info("Defragmentation finished: {} bytes moved, {} bytes freed", stats.bytesMoved, stats.bytesFreed);
+        }
+        else if (result != vk::Result::eIncomplete)
+        {
+            spdlog::error("Defragmentation pass failed: {}", vk::to_string(result));
+        }
+    }
+
+    vk::Result VulkanContext::EndDefragmentationPass()
+    {
+        std::vector<VulkanBuffer*> moved;
+        for (uint32_t i = 0; i < defragPass.moveCount; ++i)
+        {
+            auto& move = defragPass.pMoves[i];
+            if (move.operation == vma::DefragmentationMoveOperation::eIgnore)
+                continue;
+
+            // No frame in flight uses the old buffer anymore
+            device.destroyBuffer(defragOldBuffers[i]);
+
+            // Destroyed while its copy was in flight, the pass frees both allocations
+            auto* buffer = static_cast<VulkanBuffer*>(vmaAllocator.getAllocationInfo(move.srcAllocation).pUserData);
+            if (buffer == nullptr)
+            {
+                move.operation = vma::DefragmentationMoveOperation::eDestroy;
+                continue;
+            }
+
+            moved.push_back(buffer);
+        }
+
+        auto result = vmaAllocator.endDefragmentationPass(defragContext, &defragPass);
+        defragPassPending = false;
+        defragOldBuffers.clear();
+
+        for (auto* buffer : moved)
+        {
+            buffer->defragmenting = false;
+            buffer->vmaAllocationInfo = vmaAllocator.getAllocationInfo(buffer->vmaAllocation);
+        }
+
+        return result;
     }
 
     void VulkanContext::UploadBuffer(const void* data, VulkanBuffer* srcBuffer, VulkanBuffer* dstBuffer)
     {
+        // Dynamic buffers bring their own staging when they need one, every frame slot starts with the same contents
+        if (dstBuffer->IsDynamic())
+        {
+            for (uint32_t frame = 0; frame < kMaxFrameInFlight; ++frame)
+            {
+                dstBuffer->Write(frame, data, srcBuffer->size);
+                dstBuffer->Upload(GetCommandBuffer(), frame);
+            }
+            return;
+        }
+
         memcpy(srcBuffer->mappedMemory, data, srcBuffer->size);
 
         auto commandBuffer = GetCommandBuffer();
@@ -425,13 +1433,36 @@ namespace jgw
 
     void VulkanContext::UploadTexture(const void* data, VulkanBuffer* srcBuffer, VulkanTexture* dstTexture)
     {
+        // Without mips to generate the pixels can be written by the host directly
+        if (dstTexture->desc.mipLevels == 1 && (dstTexture->desc.usageFlags & vk::ImageUsageFlagBits::eHostTransferEXT))
+        {
+            vk::MemoryToImageCopyEXT region{
+                .pHostPointer = data,
+                .imageSubresource = {
+                    .aspectMask = dstTexture->desc.aspectMask,
+                    .mipLevel = 0,
+                    .baseArrayLayer = 0,
+                    .layerCount = dstTexture->desc.arrayLayers
+                },
+                .imageExtent = dstTexture->desc.extent
+            };
+
+            if (HostCopyToTexture(dstTexture, { region }))
+                return;
+        }
+
         memcpy(srcBuffer->mappedMemory, data, srcBuffer->size);
 
+        CopyBufferToTexture(srcBuffer, 0, dstTexture);
+    }
+
+    void VulkanContext::CopyBufferToTexture(VulkanBuffer* srcBuffer, vk::DeviceSize srcOffset, VulkanTexture* dstTexture)
+    {
         auto commandBuffer = GetCommandBuffer();
         dstTexture->TransitionLayout(commandBuffer, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
 
         vk::BufferImageCopy region{
-            .bufferOffset = 0,
+            .bufferOffset = srcOffset,
             .bufferRowLength = 0,
             .bufferImageHeight = 0,
             .imageSubresource = {
@@ -449,43 +1480,39 @@ namespace jgw
         dstTexture->TransitionMipLayout(commandBuffer, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal, dstTexture->desc.mipLevels - 1);
     }
 
-    void VulkanContext::UploadCubeTexture(ktxTexture* data, VulkanBuffer* srcBuffer, VulkanTexture* dstTexture)
+    void VulkanContext::CopyKtxToTexture(ktxTexture* data, VulkanBuffer* srcBuffer, VulkanTexture* dstTexture)
     {
-        ktx_uint8_t* ktxTextureData = ktxTexture_GetData(data);
-        memcpy(srcBuffer->mappedMemory, ktxTextureData, srcBuffer->size);
-
         auto commandBuffer = GetCommandBuffer();
         dstTexture->TransitionLayout(commandBuffer, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
 
+        // One region per level, array layer and cube face, mips are taken from the file as is
         std::vector<vk::BufferImageCopy> bufferCopyRegions;
-        for (uint32_t face = 0; face < data->numFaces; ++face)
+        for (uint32_t layer = 0; layer < data->numLayers; ++layer)
         {
-            for (uint32_t level = 0; level < dstTexture->desc.mipLevels; ++level)
+            for (uint32_t face = 0; face < data->numFaces; ++face)
             {
-                ktx_size_t offset;
-                KTX_error_code ret = ktxTexture_GetImageOffset(data, level, 0, face, &offset);
-                assert(ret == KTX_SUCCESS);
-
-                vk::BufferImageCopy region{
-                    .bufferOffset = offset,
-                    .bufferRowLength = 0,
-                    .bufferImageHeight = 0,
-                    .imageSubresource = {
-                        .aspectMask = dstTexture->desc.aspectMask,
-                        .mipLevel = level,
-                        .baseArrayLayer = face,
-                        .layerCount = 1
-                    },
-                    .imageOffset = { 0, 0, 0 },
-                    .imageExtent = {
-                        .width = data->baseWidth >> level,
-                        .height = data->baseHeight >> level,
-                        .depth = data->baseDepth
-                    }
-                };
-                bufferCopyRegions.push_back(region);
+                for (uint32_t level = 0; level < dstTexture->desc.mipLevels; ++level)
+                {
+                    ktx_size_t offset;
+                    KTX_error_code ret = ktxTexture_GetImageOffset(data, level, layer, face, &offset);
+                    assert(ret == KTX_SUCCESS);
+
+                    vk::BufferImageCopy region{
+                        .bufferOffset = offset,
+                        .bufferRowLength = 0,
+                        .bufferImageHeight = 0,
+                        .imageSubresource = {
+                            .aspectMask = dstTexture->desc.aspectMask,
+                            .mipLevel = level,
+                            .baseArrayLayer = layer * data->numFaces + face,
+                            .layerCount = 1
+                        },
+                        .imageOffset = { 0, 0, 0 },
+                        .imageExtent = VulkanTexture::GetMipExtent(dstTexture->desc.extent, level)
+                    };
+                    bufferCopyRegions.push_back(region);
+                }
             }
-            
         }
         
         commandBuffer.copyBufferToImage(srcBuffer->buffer, dstTexture->image, vk::ImageLayout::eTransferDstOptimal,
@@ -494,6 +1521,92 @@ namespace jgw
         dstTexture->TransitionLayout(commandBuffer, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
     }
 
+    bool VulkanContext::HostCopyKtxToTexture(ktxTexture* data, VulkanTexture* dstTexture)
+    {
+        const auto* pixels = ktxTexture_GetData(data);
+
+        std::vector<vk::MemoryToImageCopyEXT> regions;
+        for (uint32_t layer = 0; layer < data->numLayers; ++layer)
+        {
+            for (uint32_t face = 0; face < data->numFaces; ++face)
+            {
+                for (uint32_t level = 0; level < dstTexture->desc.mipLevels; ++level)
+                {
+                    ktx_size_t offset;
+                    KTX_error_code ret = ktxTexture_GetImageOffset(data, level, layer, face, &offset);
+                    assert(ret == KTX_SUCCESS);
+
+                    vk::MemoryToImageCopyEXT region{
+                        .pHostPointer = pixels + offset,
+                        .memoryRowLength = 0,
+                        .memoryImageHeight = 0,
+                        .imageSubresource = {
+                            .aspectMask = dstTexture->desc.aspectMask,
+                            .mipLevel = level,
+                            .baseArrayLayer = layer * data->numFaces + face,
+                            .layerCount = 1
+                        },
+                        .imageOffset = { 0, 0, 0 },
+                        .imageExtent = VulkanTexture::GetMipExtent(dstTexture->desc.extent, level)
+                    };
+                    regions.push_back(region);
+                }
+            }
+        }
+
+        return HostCopyToTexture(dstTexture, regions);
+    }
+
+    bool VulkanContext::IsFormatSupported(vk::Format format, vk::FormatFeatureFlags features) const
+    {
+        const vk::FormatProperties properties = physicalDevice.getFormatProperties(format);
+        return (properties.optimalTilingFeatures & features) == features;
+    }
+
+    bool VulkanContext::SupportsHostImageCopy(vk::Format format) const
+    {
+        if (!hostImageCopyEnabled)
+            return false;
+
+        auto properties = physicalDevice.getFormatProperties2<vk::FormatProperties2, vk::FormatProperties3>(format);
+        return static_cast<bool>(properties.get<vk::FormatProperties3>().optimalTilingFeatures & vk::FormatFeatureFlagBits2::eHostImageTransferEXT);
+    }
+
+    bool VulkanContext::HostCopyToTexture(VulkanTexture* dstTexture, const std::vector<vk::MemoryToImageCopyEXT>& regions)
+    {
+        try
+        {
+            vk::HostImageLayoutTransitionInfoEXT transitionInfo{
+                .image = dstTexture->image,
+                .oldLayout = vk::ImageLayout::eUndefined,
+                .newLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+                .subresourceRange = {
+                    .aspectMask = dstTexture->desc.aspectMask,
+                    .baseMipLevel = 0,
+                    .levelCount = dstTexture->desc.mipLevels,
+                    .baseArrayLayer = 0,
+                    .layerCount = dstTexture->desc.arrayLayers
+                }
+            };
+            device.transitionImageLayoutEXT(transitionInfo);
+
+            vk::CopyMemoryToImageInfoEXT copyInfo{
+                .dstImage = dstTexture->image,
+                .dstImageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+                .regionCount = static_cast<uint32_t>(regions.size()),
+                .pRegions = regions.data()
+            };
+            device.copyMemoryToImageEXT(copyInfo);
+        }
+        catch (const vk::SystemError& err)
+        {
+            spdlog::error("Host image copy failed: {}", err.what());
+            return false;
+        }
+
+        return true;
+    }
+
     bool VulkanContext::CheckInstanceLayerSupport(const std::vector<const char*>& requestInstanceLayers) const
     {
         if (requestInstanceLayers.empty())
@@ -576,6 +1689,90 @@ namespace jgw
         return true;
     }
 
+    int64_t VulkanContext::ScorePhysicalDevice(vk::PhysicalDevice candidate, const std::vector<const char*>& requestDeviceExtensions) const
+    {
+        const auto properties = candidate.getProperties();
+
+        // Synchronization2, dynamic rendering and timeline semaphores are used unconditionally
+        if (VK_API_VERSION_MAJOR(properties.apiVersion) == 1 && VK_API_VERSION_MINOR(properties.apiVersion) < 3)
+            return -1;
+
+        int64_t score = -1;
+        switch (properties.deviceType)
+        {
+        case vk::PhysicalDeviceType::eDiscreteGpu: score = 4000; break;
+        case vk::PhysicalDeviceType::eIntegratedGpu: score = deviceSelectionConfig.allowIntegrated ? 3000 : -1; break;
+        case vk::PhysicalDeviceType::eVirtualGpu: score = 2000; break;
+        case vk::PhysicalDeviceType::eCpu: score = deviceSelectionConfig.allowCpu ? 1000 : -1; break;
+        default: break;
+        }
+        if (score < 0)
+            return -1;
+
+        const auto availableExtensions = candidate.enumerateDeviceExtensionProperties();
+        for (const auto& extension : requestDeviceExtensions)
+        {
+            auto found = std::find_if(availableExtensions.begin(), availableExtensions.end(), [extension](const vk::ExtensionProperties& available) {
+                return strcmp(extension, available.extensionName.data()) == 0;
+            });
+            if (found == availableExtensions.end())
+                return -1;
+        }
+
+        // The graphics queue has to present to the surface unless rendering offscreen
+        bool usableQueue = false;
+        const auto queueFamilies = candidate.getQueueFamilyProperties();
+        for (uint32_t i = 0; i < queueFamilies.size() && !usableQueue; ++i)
+        {
+            if (queueFamilies[i].queueFlags & vk::QueueFlagBits::eGraphics)
+                usableQueue = headless || candidate.getSurfaceSupportKHR(i, surface);
+        }
+        if (!usableQueue)
+            return -1;
+
+        if (!deviceSelectionConfig.preferredDevice.empty() && strstr(properties.deviceName.data(), deviceSelectionConfig.preferredDevice.c_str()))
+            score += 10000;
+
+        return score;
+    }
+
+    bool VulkanContext::SelectPhysicalDevice(const std::vector<const char*>& requestDeviceExtensions)
+    {
+        int64_t bestScore = -1;
+        for (const auto& candidate : instance.enumeratePhysicalDevices())
+        {
+            const int64_t score = ScorePhysicalDevice(candidate, requestDeviceExtensions);
+            spdlog::info("Physical device {} ({}): score {}", candidate.getProperties().deviceName.data(), vk::to_string(candidate.getProperties().deviceType), score);
+
+            // Ties keep the first device in enumeration order
+            if (score > bestScore)
+            {
+                bestScore = score;
+                physicalDevice = candidate;
+            }
+        }
+
+        if (physicalDevice == nullptr)
+        {
+            spdlog::error("No usable physical device found");
+            return false;
+        }
+
+        spdlog::info("Using physical device: {}", physicalDevice.getProperties().deviceName.data());
+        return true;
+    }
+
+    bool VulkanContext::IsDeviceExtensionSupported(const char* extension) const
+    {
+        auto availableExtensions = physicalDevice.enumerateDeviceExtensionProperties();
+        for (const auto& availableExtension : availableExtensions)
+        {
+            if (strcmp(extension, availableExtension.extensionName.data()) == 0)
+                return true;
+        }
+        return false;
+    }
+
     uint32_t VulkanContext::GetQueueFamilyIndex(vk::QueueFlags queueFlags) const
     {
         auto queueFamilies = physicalDevice.getQueueFamilyProperties();
@@ -626,4 +1823,62 @@ namespace jgw
 
         throw std::runtime_error("Could not find a matching queue family index");
     }
+
+    void VulkanContext::CreateTexturePools()
+    {
+        // Representative sampled image used to pick the memory type shared by all texture pools
+        const TextureDesc sampleDesc{
+            .usageFlags = vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled,
+            .extent = { .width = 1024, .height = 1024, .depth = 1 }
+        };
+        vk::ImageCreateInfo imageCI = VulkanTexture::BuildImageCI(sampleDesc);
+
+        vma::AllocationCreateInfo allocationCI{
+            .usage = vma::MemoryUsage::eAutoPreferDevice
+        };
+
+        uint32_t memoryTypeIndex = vmaAllocator.findMemoryTypeIndexForImageInfo(imageCI, allocationCI);
+
+        for (const auto& sizeClass : memoryPoolConfig.textureSizeClasses)
+        {
+            texturePools.push_back(std::make_unique<VulkanMemoryPool>(vmaAllocator, memoryTypeIndex, sizeClass));
+        }
+    }
+
+    VmaAllocationDesc VulkanContext::ChooseTextureAllocation(const TextureDesc& desc, const VmaAllocationDesc& allocDesc) const
+    {
+        // Respect explicit placement requests from the caller
+        if (allocDesc.pool || (allocDesc.flags & vma::AllocationCreateFlagBits::eDedicatedMemory))
+            return allocDesc;
+
+        if (desc.tiling != vk::ImageTiling::eOptimal || texturePools.empty())
+            return allocDesc;
+
+        vk::ImageCreateInfo imageCI = VulkanTexture::BuildImageCI(desc);
+        vk::DeviceImageMemoryRequirements imageRequirements{
+            .pCreateInfo = &imageCI
+        };
+        vk::MemoryRequirements requirements = device.getImageMemoryRequirements(imageRequirements).memoryRequirements;
+
+        VmaAllocationDesc result = allocDesc;
+
+        const bool renderTarget = static_cast<bool>(desc.usageFlags & (vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eDepthStencilAttachment));
+        if (renderTarget && requirements.size >= memoryPoolConfig.dedicatedThreshold)
+        {
+            result.flags |= vma::AllocationCreateFlagBits::eDedicatedMemory;
+            return result;
+        }
+
+        for (const auto& pool : texturePools)
+        {
+            if (pool->Accepts(requirements))
+            {
+                result.pool = pool->Handle();
+                return result;
+            }
+        }
+
+        // Too large for any size class, let VMA decide
+        return result;
+    }
 }
@@ -5,22 +5,60 @@
 #include "VulkanSwapchain.h"
 #include "VulkanBuffer.h"
 #include "VulkanTexture.h"
+#include "VulkanMemoryPool.h"
+#include "VulkanMemoryStats.h"
+#include "ResidencyManager.h"
+#include "TextureStreamer.h"
+#include "FrameAllocator.h"
+#include "FramePacing.h"
+#include "ParallelRecorder.h"
 #include "VulkanPipeline.h"
+#include "VulkanSampler.h"
 #include "PipelineBuilder.h"
+#include "DeletionQueue.h"
+#include "VulkanPipelineCache.h"
 
 #include <ktx.h>
 #include <ktxvulkan.h>
 
+#include <array>
+#include <functional>
+
 namespace jgw
 {
+    struct DeviceSelectionConfig
+    {
+        // Discrete GPUs score highest, then integrated, virtual and CPU implementations such as lavapipe
+        bool allowIntegrated = true;
+        bool allowCpu = false;
+
+        // Devices whose name contains this string win over any other usable device
+        std::string preferredDevice;
+    };
+
+    // Draws reported by the renderers while recording a frame
+    struct DrawStats
+    {
+        uint32_t draws = 0;
+        uint64_t triangles = 0;
+    };
+
     class VulkanContext final
     {
     public:
         CLASS_COPY_MOVE_DELETE(VulkanContext)
 
+        static constexpr uint32_t kMaxFrameInFlight = 4;
+        static constexpr const char* kPipelineCacheFile = "../cache/pipeline_cache.bin";
+
         VulkanContext();
         ~VulkanContext();
 
+        // Headless contexts create no surface and render into a chain of offscreen textures, one per frame
+        // in flight, sized like the framebuffer of the window. Has to be set before Initialize.
+        void SetHeadless(bool enabled) { headless = enabled; }
+        bool IsHeadless() const { return headless; }
+
         bool Initialize(
             GLFWwindow* handle,
             const std::vector<const char*>& requestInstanceLayers,
@@ -34,7 +72,43 @@ namespace jgw
         void BeginCommand();
         void EndCommand();
 
-        void WindowResize();
+        // Records taskCount secondary command buffers on the job queue and executes them in task order on the
+        // frame command buffer. Rendering has to be begun with eContentsSecondaryCommandBuffers, the swapchain
+        // and depth formats are inherited but dynamic state is not, so every task sets its viewport and scissor.
+        void RecordParallel(JobQueue& jobQueue, uint32_t taskCount, FunctionRef<void(vk::CommandBuffer, uint32_t)> record);
+
+        // Resize events only mark the swapchain, it is recreated at most once per frame at the start of BeginRender.
+        // RecreateSwapchain does it right away, in both cases without idling the device.
+        void RequestSwapchainRecreate() { swapchainDirty = true; }
+        void RecreateSwapchain();
+
+        // Every submit to the graphics queue signals the next value of one timeline semaphore
+        uint64_t GetCompletedValue() const;
+        uint64_t GetSubmittedValue() const { return timelineValue; }
+        bool WaitForValue(uint64_t value, uint64_t timeout = UINT64_MAX) const;
+
+        // Frames are numbered by GetFrameIndex(), a frame not submitted yet is never complete
+        bool IsFrameComplete(uint64_t frame) const;
+        bool WaitForFrame(uint64_t frame, uint64_t timeout = UINT64_MAX) const;
+
+        // Runtime frame pacing, the swapchain is recreated for present mode and image count changes
+        void SetPresentMode(vk::PresentModeKHR mode);
+        void SetSwapchainImageCount(uint32_t count);
+        void SetFrameInFlight(uint32_t count);
+        uint32_t GetFrameInFlight() const { return frameInFlight; }
+
+        // Called right after input is polled, the start of the input to submit and input to present latency
+        void MarkInputSampled();
+        void MarkInputSampled(double time);
+        LatencyStats GetLatencyStats() const { return latency.GetStats(); }
+
+        // Time between timestamps at the start and end of the frame command buffer. Read back once the slot
+        // is reused, so it lags the frame being recorded by the frames in flight. Negative without timestamps.
+        float GetGpuFrameTimeMs() const { return gpuFrameTimeMs; }
+
+        // Called by renderers from the recording thread, the totals of the last submitted frame are kept
+        void AddDrawStats(uint32_t draws, uint64_t triangles) { currentDrawStats.draws += draws; currentDrawStats.triangles += triangles; }
+        DrawStats GetDrawStats() const { return lastDrawStats; }
         void WaitDeviceIdle();
         void WaitQueueIdle();
 
@@ -43,13 +117,38 @@ namespace jgw
         vk::Instance GetInstance() const { return instance; }
         vk::PhysicalDevice GetPhysicalDevice() const { return physicalDevice; }
         vk::PhysicalDeviceFeatures& GetDeviceFeatures() { return deviceFeatures; }
+        DeviceSelectionConfig& GetDeviceSelectionConfig() { return deviceSelectionConfig; }
+        MemoryPoolConfig& GetMemoryPoolConfig() { return memoryPoolConfig; }
+        TextureStreamingConfig& GetTextureStreamingConfig() { return textureStreamingConfig; }
+        FrameAllocatorConfig& GetFrameAllocatorConfig() { return frameAllocatorConfig; }
+        FramePacingConfig& GetFramePacingConfig() { return framePacingConfig; }
         vk::Device GetDevice() const { return device; }
         vk::Queue GetQueue() const { return graphicsQueue; }
         vk::CommandBuffer GetCommandBuffer() const { return commandBuffers[currentFrame]; }
+        // Null in headless mode, the color target accessors cover both the swapchain and the offscreen chain
         VulkanSwapchain* GetSwapchain() const { return swapchainPtr.get(); }
         VulkanTexture* GetDepthTexture() const { return depthBuffer.get(); }
+        vk::Extent2D GetRenderExtent() const;
+        vk::Format GetColorFormat() const;
+        vk::Image GetColorImage() const;
+        vk::ImageView GetColorView() const;
+        uint32_t GetColorImageCount() const;
+        ResidencyManager* GetResidencyManager() const { return residency.get(); }
+        TextureStreamer* GetTextureStreamer() const { return textureStreamer.get(); }
+        FrameAllocator* GetFrameAllocator() const { return frameAllocator.get(); }
+        uint64_t GetFrameIndex() const { return frameIndex; }
 
-        std::unique_ptr<VulkanPipeline> CreateGraphicsPipeline(PipelineBuilder& pd);
+        // Slot of the frame being recorded, its previous use has completed once BeginRender returned
+        uint32_t GetCurrentFrame() const { return currentFrame; }
+
+        // Builders with the same shaders and state share one pipeline for as long as any user holds it,
+        // layouts and shader modules are shared between the pipelines that match in those alone
+        std::shared_ptr<VulkanPipeline> CreateGraphicsPipeline(PipelineBuilder& pd);
+        PipelineStats GetPipelineStats() const { return pipelineStats; }
+
+        // Loaded in Initialize and saved on destruction, saving earlier keeps it should the app crash
+        VulkanPipelineCache* GetPipelineCache() const { return pipelineCache.get(); }
+        bool SavePipelineCache() { return pipelineCache && pipelineCache->Save(kPipelineCacheFile); }
 
         std::unique_ptr<VulkanBuffer> CreateBuffer(
             vk::DeviceSize size,
@@ -58,20 +157,108 @@ namespace jgw
             vma::MemoryUsage memoryUsage = vma::MemoryUsage::eAuto
         );
 
+        // Written to the frame allocator once per frame, shaders read it through the device address
+        void SetFrameConstants(const FrameConstants& constants);
+
+        // Called right before submit with the constants of the frame, whatever it changes is written to the
+        // mapped copy the shaders read, so camera input that arrived while recording still makes the frame.
+        // Shaders take the camera from the frame constants only, a matrix pushed while recording would not follow.
+        void SetLateLatch(std::function<void(FrameConstants&)> latch) { lateLatch = std::move(latch); }
+        vk::DeviceAddress GetFrameConstantsAddress() const { return frameConstantsAddress; }
+
+        // Rewritten by the host every frame, prefers device local memory the host can write directly
+        // and falls back to a staging buffer plus copy, see VulkanBuffer::Write and Upload. Size is per frame slot,
+        // bind at GetFrameOffset of the frame being recorded.
+        std::unique_ptr<VulkanBuffer> CreateDynamicBuffer(vk::DeviceSize size, vk::BufferUsageFlags bufferUsage);
+
         std::unique_ptr<VulkanTexture> CreateTexture(const TextureDesc& desc, const VmaAllocationDesc& allocDesc = {});
         std::unique_ptr<VulkanTexture> CreateDepthTexture(vk::Format depthFormat = vk::Format::eD32Sfloat);
 
+        // Destroyed once the GPU has completed the current frame, the last one that may still reference the object.
+        // Lets resources be replaced at runtime without waiting for the device.
+        void DeferDestroy(DeferredObject&& object) { deletionQueue->Push(frameIndex, std::move(object)); }
+        size_t GetPendingDestroyCount() const { return deletionQueue->GetPendingCount(); }
+
+        // Device local memory images are bound to by the caller, several images may alias one allocation
+        vma::Allocation AllocateImageMemory(const vk::MemoryRequirements& requirements);
+        void BindImageMemory(vma::Allocation allocation, vk::Image image);
+        void FreeImageMemory(vma::Allocation allocation);
+
+        // Identical create infos share one sampler for as long as any user holds it
+        std::shared_ptr<VulkanSampler> GetSampler(const vk::SamplerCreateInfo& samplerCI);
+
+        std::vector<MemoryPoolStats> GetTexturePoolStats() const;
+        std::vector<MemoryHeapStats> GetHeapStats() const;
+        MemoryCategoryStats GetCategoryStats(EMemoryCategory category) const { return memoryTracker.Get(category); }
+        bool DumpMemoryStats(const char* filename) const;
+
+        // Sum of usage and budget over device local heaps
+        void GetDeviceLocalBudget(vk::DeviceSize& usage, vk::DeviceSize& budget) const;
+
+        // Record resource usage of the current frame so cold resources can be evicted, before anything
+        // referencing the resource is bound
+        void MarkUsed(VulkanBuffer* buffer) { residency->MarkUsed(buffer, frameIndex); }
+        void MarkUsed(VulkanTexture* texture) { residency->MarkUsed(texture, frameIndex); }
+
+        // Record and submit commands outside of the frame, waits until everything submitted so far has completed
+        void ImmediateSubmit(const std::function<void(vk::CommandBuffer)>& record);
+
+        // Moves are recorded into the frame command buffer, one bounded pass at a time
+        void StartDefragmentation();
+        bool IsDefragmenting() const { return defragContext != nullptr; }
+
         void UploadBuffer(const void* data, VulkanBuffer* srcBuffer, VulkanBuffer* dstBuffer);
+        // Host copy when the texture was created with eHostTransferEXT usage and has a single mip, staging otherwise
         void UploadTexture(const void* data, VulkanBuffer* srcBuffer, VulkanTexture* dstTexture);
-        void UploadCubeTexture(ktxTexture* data, VulkanBuffer* srcBuffer, VulkanTexture* dstTexture);
+
+        // Records the copy of level 0 from a staging buffer followed by mip generation
+        void CopyBufferToTexture(VulkanBuffer* srcBuffer, vk::DeviceSize srcOffset, VulkanTexture* dstTexture);
+
+        // The staging buffer holds the image data in the KTX layout, regions are built from the image offsets
+        void CopyKtxToTexture(ktxTexture* data, VulkanBuffer* srcBuffer, VulkanTexture* dstTexture);
+
+        bool IsFormatSupported(vk::Format format, vk::FormatFeatureFlags features) const;
+
+        // VK_EXT_host_image_copy is enabled and the format can be written from the host into optimal images.
+        // Such images need eHostTransferEXT usage.
+        bool SupportsHostImageCopy(vk::Format format) const;
+
+        // Writes pixels from host memory straight into the image without staging buffer or command buffer,
+        // the image ends up in eShaderReadOnlyOptimal. Safe to call from worker threads for distinct images.
+        bool HostCopyToTexture(VulkanTexture* dstTexture, const std::vector<vk::MemoryToImageCopyEXT>& regions);
+
+        // Same regions as CopyKtxToTexture, read from the image data loaded by libktx
+        bool HostCopyKtxToTexture(ktxTexture* data, VulkanTexture* dstTexture);
 
     private:
         bool CheckInstanceLayerSupport(const std::vector<const char*>& requestInstanceLayers) const;
         bool CheckInstanceExtensionSupport(const std::vector<const char*>& requestInstanceExtensions) const;
         bool CheckDeviceExtensionSupport(const std::vector<const char*>& requestDeviceExtensions) const;
+        bool IsDeviceExtensionSupported(const char* extension) const;
 
         uint32_t GetQueueFamilyIndex(vk::QueueFlags queueFlags) const;
 
+        // Negative for devices that cannot run the engine
+        int64_t ScorePhysicalDevice(vk::PhysicalDevice candidate, const std::vector<const char*>& requestDeviceExtensions) const;
+        bool SelectPhysicalDevice(const std::vector<const char*>& requestDeviceExtensions);
+        void CreateOffscreenTargets();
+
+        void PollPresents();
+        void ReadFrameTimestamps();
+
+        // Signals the next timeline value, plus the binary semaphore if given
+        uint64_t SubmitCommandBuffer(vk::CommandBuffer commandBuffer, vk::Semaphore waitSemaphore = {}, vk::Semaphore signalSemaphore = {});
+        uint64_t GetFrameValue(uint64_t frame) const;
+
+        void CreateTexturePools();
+
+        // Ends the pass once the frame that recorded its copies has completed, then records the next one
+        void DefragmentStep(vk::CommandBuffer commandBuffer);
+        vk::Result EndDefragmentationPass();
+        std::shared_ptr<VulkanShaderModule> GetShaderModule(const std::string& filename);
+        std::shared_ptr<VulkanPipelineLayout> GetPipelineLayout(PipelineBuilder& pd);
+        VmaAllocationDesc ChooseTextureAllocation(const TextureDesc& desc, const VmaAllocationDesc& allocDesc) const;
+
     private:
         vk::Instance instance{};
         vk::SurfaceKHR surface{};
@@ -82,19 +269,79 @@ namespace jgw
         vk::CommandPool commandPool{};
         std::unique_ptr<VulkanSwapchain> swapchainPtr;
         std::unique_ptr<VulkanTexture> depthBuffer;
+        bool swapchainDirty = false;
+
+        static constexpr vk::Format kOffscreenFormat = vk::Format::eR8G8B8A8Srgb;
+        DeviceSelectionConfig deviceSelectionConfig{};
+        std::vector<std::unique_ptr<VulkanTexture>> offscreenTargets;
+        vk::Extent2D offscreenExtent{};
+        bool headless = false;
 
         std::vector<vk::CommandBuffer> commandBuffers;
-        std::vector<vk::Fence> fences;
+        static constexpr uint32_t kFrameHistory = 8;
+
+        vk::Semaphore timelineSemaphore{};
+        uint64_t timelineValue = 0;
+        std::array<uint64_t, kMaxFrameInFlight> slotValues{};
+        std::array<uint64_t, kFrameHistory> frameValues{};
         std::vector<vk::Semaphore> imageAvailableSemaphores;
         std::vector<vk::Semaphore> renderFinishedSemaphores;
 
         vma::VulkanFunctions vulkanFuncs{};
         vma::Allocator vmaAllocator{};
 
+        MemoryPoolConfig memoryPoolConfig{};
+        std::vector<std::unique_ptr<VulkanMemoryPool>> texturePools;
+        MemoryTracker memoryTracker{};
+
+        vma::DefragmentationContext defragContext{};
+        vma::DefragmentationPassMoveInfo defragPass{};
+        std::vector<vk::Buffer> defragOldBuffers;
+        uint64_t defragFrame = 0;
+        bool defragPassPending = false;
+        vk::CommandBuffer immediateCommandBuffer{};
+
+        std::unique_ptr<DeletionQueue> deletionQueue;
+        std::unique_ptr<VulkanPipelineCache> pipelineCache;
+        std::unique_ptr<ResidencyManager> residency;
+        std::unordered_map<uint64_t, std::weak_ptr<VulkanSampler>> samplerCache;
+        std::unordered_map<uint64_t, std::weak_ptr<VulkanPipeline>> graphicsPipelineCache;
+        std::unordered_map<uint64_t, std::weak_ptr<VulkanPipelineLayout>> pipelineLayoutCache;
+        std::unordered_map<std::string, std::weak_ptr<VulkanShaderModule>> shaderModuleCache;
+        PipelineStats pipelineStats{};
+
+        TextureStreamingConfig textureStreamingConfig{};
+        std::unique_ptr<TextureStreamer> textureStreamer;
+        uint64_t frameIndex = 0;
+
+        FrameAllocatorConfig frameAllocatorConfig{};
+        std::unique_ptr<FrameAllocator> frameAllocator;
+        std::unique_ptr<ParallelRecorder> parallelRecorder;
+        vk::DeviceAddress frameConstantsAddress = 0;
+        FrameConstants* frameConstantsData = nullptr;
+        FrameConstants frameConstants{};
+        std::function<void(FrameConstants&)> lateLatch;
+
         GLFWwindow* windowHandle = nullptr;
         uint32_t graphicsFamilyIndex = 0;
         uint32_t frameInFlight = 3;
         uint32_t currentFrame = 0;
         uint32_t apiVersion = VK_API_VERSION_1_4;
+        bool hostImageCopyEnabled = false;
+
+        vk::QueryPool timestampPool{};
+        std::array<bool, kMaxFrameInFlight> timestampsWritten{};
+        uint64_t timestampMask = 0;
+        float timestampPeriod = 0.0f;
+        float gpuFrameTimeMs = -1.0f;
+
+        DrawStats currentDrawStats{};
+        DrawStats lastDrawStats{};
+
+        FramePacingConfig framePacingConfig{};
+        LatencyTracker latency;
+        std::unique_ptr<PresentWaiter> presentWaiter;
+        bool presentWaitEnabled = false;
+        uint64_t presentId = 0;
     };
 }
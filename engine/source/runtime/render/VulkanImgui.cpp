@@ -11,13 +11,28 @@
 
 namespace jgw
 {
+    namespace
+    {
+        template<typename T>
+        void CopyVector(ImVector<T>& dst, const ImVector<T>& src)
+        {
+            dst.resize(src.Size);
+            if (src.Size > 0)
+                memcpy(dst.Data, src.Data, src.Size * sizeof(T));
+        }
+    }
+
     VulkanImgui::VulkanImgui()
+        : snapshotData(std::make_unique<ImDrawData>())
     {
         volkInitialize();
     }
 
     VulkanImgui::~VulkanImgui()
     {
+        for (ImDrawList* list : snapshotLists)
+            IM_DELETE(list);
+
         if (initialized)
         {
             ImGui_ImplVulkan_Shutdown();
@@ -118,13 +133,56 @@ namespace jgw
 
     void VulkanImgui::EndFrame()
     {
-        ImGui::EndFrame();
+        ImGui::Render();
+    }
+
+    void VulkanImgui::Snapshot()
+    {
+        snapshotData->Clear();
+
+        const ImDrawData* drawData = ImGui::GetDrawData();
+        if (drawData == nullptr || !drawData->Valid)
+            return;
+
+        // Texture uploads submit on the queue, they happen here while nothing is rendering instead of in
+        // Render. The snapshot leaves Textures empty so the backend does not touch them again.
+        if (drawData->Textures != nullptr)
+        {
+            for (ImTextureData* texture : *drawData->Textures)
+            {
+                if (texture->Status != ImTextureStatus_OK)
+                    ImGui_ImplVulkan_UpdateTexture(texture);
+            }
+        }
+
+        while (snapshotLists.size() < static_cast<size_t>(drawData->CmdListsCount))
+            snapshotLists.push_back(IM_NEW(ImDrawList)(ImGui::GetDrawListSharedData()));
+
+        // Only what the backend reads, the draw lists of the context are reset by the next NewFrame
+        for (int i = 0; i < drawData->CmdListsCount; ++i)
+        {
+            const ImDrawList* src = drawData->CmdLists[i];
+            ImDrawList* dst = snapshotLists[i];
+            CopyVector(dst->CmdBuffer, src->CmdBuffer);
+            CopyVector(dst->IdxBuffer, src->IdxBuffer);
+            CopyVector(dst->VtxBuffer, src->VtxBuffer);
+            dst->Flags = src->Flags;
+            snapshotData->CmdLists.push_back(dst);
+        }
+
+        snapshotData->Valid = true;
+        snapshotData->CmdListsCount = drawData->CmdListsCount;
+        snapshotData->TotalIdxCount = drawData->TotalIdxCount;
+        snapshotData->TotalVtxCount = drawData->TotalVtxCount;
+        snapshotData->DisplayPos = drawData->DisplayPos;
+        snapshotData->DisplaySize = drawData->DisplaySize;
+        snapshotData->FramebufferScale = drawData->FramebufferScale;
+        snapshotData->OwnerViewport = drawData->OwnerViewport;
     }
 
     void VulkanImgui::Render(VkCommandBuffer commandBuffer)
     {
-        ImGui::Render();
-        ImDrawData* drawData = ImGui::GetDrawData();
-        ImGui_ImplVulkan_RenderDrawData(drawData, commandBuffer);
+        if (snapshotData->Valid)
+            ImGui_ImplVulkan_RenderDrawData(snapshotData.get(), commandBuffer);
     }
 }
@@ -5,6 +5,11 @@
 #define VK_NO_PROTOTYPES
 #include <vulkan/vulkan.h>
 #include <functional>
+#include <memory>
+#include <vector>
+
+struct ImDrawData;
+struct ImDrawList;
 
 namespace jgw
 {
@@ -32,10 +37,17 @@ namespace jgw
 
         void BeginFrame();
         void EndFrame();
+
+        // Copies the draw data of the ended frame for Render, the next frame may be built meanwhile
+        void Snapshot();
         void Render(VkCommandBuffer commandBuffer);
 
     private:
         VkDescriptorPool descriptorPool{};
+
+        // Lists are kept across snapshots, copying stops allocating once the UI has settled
+        std::unique_ptr<ImDrawData> snapshotData;
+        std::vector<ImDrawList*> snapshotLists;
         bool initialized = false;
     };
 }
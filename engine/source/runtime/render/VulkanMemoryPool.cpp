@@ -0,0 +1,49 @@
+#include "VulkanMemoryPool.h"
+
+namespace jgw
+{
+    VulkanMemoryPool::VulkanMemoryPool(vma::Allocator vmaAllocator, uint32_t memoryTypeIndex, const MemoryPoolDesc& desc)
+        : vmaAllocator(vmaAllocator)
+        , memoryTypeIndex(memoryTypeIndex)
+        , desc(desc)
+    {
+        // Only optimal-tiling images are placed in these pools, so a range freed by one image
+        // can be handed to the next one without bufferImageGranularity padding
+        vma::PoolCreateInfo poolCI{
+            .memoryTypeIndex = memoryTypeIndex,
+            .flags = vma::PoolCreateFlagBits::eIgnoreBufferImageGranularity,
+            .blockSize = desc.blockSize
+        };
+
+        auto result = vmaAllocator.createPool(&poolCI, &pool);
+        if (result != vk::Result::eSuccess)
+        {
+            throw std::runtime_error("Failed to create VMA pool: " + vk::to_string(result));
+        }
+
+        vmaAllocator.setPoolName(pool, desc.name);
+    }
+
+    VulkanMemoryPool::~VulkanMemoryPool()
+    {
+        vmaAllocator.destroyPool(pool);
+    }
+
+    bool VulkanMemoryPool::Accepts(const vk::MemoryRequirements& requirements) const
+    {
+        return requirements.size <= desc.maxAllocationSize && (requirements.memoryTypeBits & (1u << memoryTypeIndex)) != 0;
+    }
+
+    MemoryPoolStats VulkanMemoryPool::GetStats() const
+    {
+        vma::Statistics stats = vmaAllocator.getPoolStatistics(pool);
+        return {
+            .name = desc.name,
+            .blockSize = desc.blockSize,
+            .blockBytes = stats.blockBytes,
+            .allocationBytes = stats.allocationBytes,
+            .blockCount = stats.blockCount,
+            .allocationCount = stats.allocationCount
+        };
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "Common.h"
+
+namespace jgw
+{
+    struct MemoryPoolDesc
+    {
+        const char* name = "";
+        vk::DeviceSize maxAllocationSize = 0;
+        vk::DeviceSize blockSize = 0;
+    };
+
+    struct MemoryPoolConfig
+    {
+        // Render targets at least this large get their own VkDeviceMemory, smaller ones are pooled
+        vk::DeviceSize dedicatedThreshold = 16ull << 20;
+
+        // Size classes for sampled images, checked in order
+        std::vector<MemoryPoolDesc> textureSizeClasses = {
+            { .name = "Texture Small",  .maxAllocationSize = 256ull << 10, .blockSize = 16ull << 20 },
+            { .name = "Texture Medium", .maxAllocationSize = 4ull << 20,   .blockSize = 64ull << 20 },
+            { .name = "Texture Large",  .maxAllocationSize = 32ull << 20,  .blockSize = 256ull << 20 }
+        };
+    };
+
+    struct MemoryPoolStats
+    {
+        const char* name = "";
+        vk::DeviceSize blockSize = 0;
+        vk::DeviceSize blockBytes = 0;
+        vk::DeviceSize allocationBytes = 0;
+        uint32_t blockCount = 0;
+        uint32_t allocationCount = 0;
+
+        float Occupancy() const { return blockBytes > 0 ? static_cast<float>(allocationBytes) / blockBytes : 0.0f; }
+    };
+
+    class VulkanMemoryPool final
+    {
+    public:
+        CLASS_COPY_MOVE_DELETE(VulkanMemoryPool)
+
+        explicit VulkanMemoryPool(vma::Allocator vmaAllocator, uint32_t memoryTypeIndex, const MemoryPoolDesc& desc);
+        ~VulkanMemoryPool();
+
+        bool Accepts(const vk::MemoryRequirements& requirements) const;
+        MemoryPoolStats GetStats() const;
+
+        vma::Pool Handle() const { return pool; }
+
+    private:
+        vma::Allocator vmaAllocator;
+        vma::Pool pool;
+
+        uint32_t memoryTypeIndex;
+        MemoryPoolDesc desc;
+    };
+}
@@ -0,0 +1,41 @@
+#include "VulkanMemoryStats.h"
+
+namespace jgw
+{
+    const char* ToString(EMemoryCategory category)
+    {
+        switch (category)
+        {
+        case EMemoryCategory::Geometry:     return "Geometry";
+        case EMemoryCategory::Texture:      return "Texture";
+        case EMemoryCategory::Staging:      return "Staging";
+        case EMemoryCategory::RenderTarget: return "RenderTarget";
+        case EMemoryCategory::Dynamic:      return "Dynamic";
+        case EMemoryCategory::Other:        return "Other";
+        default:                            return "Unknown";
+        }
+    }
+
+    void MemoryTracker::Add(EMemoryCategory category, vk::DeviceSize size)
+    {
+        const size_t index = static_cast<size_t>(category);
+        bytes[index] += size;
+        counts[index] += 1;
+    }
+
+    void MemoryTracker::Remove(EMemoryCategory category, vk::DeviceSize size)
+    {
+        const size_t index = static_cast<size_t>(category);
+        bytes[index] -= size;
+        counts[index] -= 1;
+    }
+
+    MemoryCategoryStats MemoryTracker::Get(EMemoryCategory category) const
+    {
+        const size_t index = static_cast<size_t>(category);
+        return {
+            .bytes = bytes[index].load(),
+            .count = counts[index].load()
+        };
+    }
+}
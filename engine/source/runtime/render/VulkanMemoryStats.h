@@ -0,0 +1,61 @@
+#pragma once
+
+#include "Common.h"
+
+#include <array>
+#include <atomic>
+
+namespace jgw
+{
+    enum class EMemoryCategory : uint32_t
+    {
+        Geometry,
+        Texture,
+        Staging,
+        RenderTarget,
+        Dynamic,
+        Other,
+        Count
+    };
+
+    const char* ToString(EMemoryCategory category);
+
+    struct MemoryCategoryStats
+    {
+        vk::DeviceSize bytes = 0;
+        uint32_t count = 0;
+    };
+
+    struct MemoryHeapStats
+    {
+        uint32_t heapIndex = 0;
+        bool deviceLocal = false;
+        vk::DeviceSize size = 0;
+        vk::DeviceSize budget = 0;
+        vk::DeviceSize usage = 0;
+        vk::DeviceSize blockBytes = 0;
+        vk::DeviceSize allocationBytes = 0;
+        uint32_t blockCount = 0;
+        uint32_t allocationCount = 0;
+    };
+
+    // Bytes and resource counts per category, updated by VulkanBuffer and VulkanTexture
+    class MemoryTracker final
+    {
+    public:
+        CLASS_COPY_MOVE_DELETE(MemoryTracker)
+
+        MemoryTracker() = default;
+
+        void Add(EMemoryCategory category, vk::DeviceSize bytes);
+        void Remove(EMemoryCategory category, vk::DeviceSize bytes);
+
+        MemoryCategoryStats Get(EMemoryCategory category) const;
+
+    private:
+        static constexpr size_t kCategoryCount = static_cast<size_t>(EMemoryCategory::Count);
+
+        std::array<std::atomic<uint64_t>, kCategoryCount> bytes{};
+        std::array<std::atomic<uint32_t>, kCategoryCount> counts{};
+    };
+}
@@ -2,10 +2,33 @@
 
 namespace jgw
 {
-    VulkanPipeline::VulkanPipeline(vk::Device device, vk::Pipeline pipeline, vk::PipelineLayout pipelineLayout) :
+    VulkanPipelineLayout::VulkanPipelineLayout(vk::Device device, const vk::PipelineLayoutCreateInfo& layoutCI, std::string key) :
+        device(device),
+        key(std::move(key))
+    {
+        pipelineLayout = device.createPipelineLayout(layoutCI);
+    }
+
+    VulkanPipelineLayout::~VulkanPipelineLayout()
+    {
+        if (device)
+        {
+            device.destroyPipelineLayout(pipelineLayout);
+        }
+    }
+
+    VulkanPipeline::VulkanPipeline(
+        vk::Device device,
+        vk::Pipeline pipeline,
+        std::shared_ptr<VulkanPipelineLayout> pipelineLayout,
+        std::vector<std::shared_ptr<VulkanShaderModule>> shaderModules,
+        std::string key
+    ) :
         device(device),
         pipeline(pipeline),
-        pipelineLayout(pipelineLayout)
+        pipelineLayout(std::move(pipelineLayout)),
+        shaderModules(std::move(shaderModules)),
+        key(std::move(key))
     {
 
     }
@@ -14,7 +37,6 @@ namespace jgw
     {
         if (device)
         {
-            device.destroyPipelineLayout(pipelineLayout);
             device.destroyPipeline(pipeline);
         }
     }
@@ -1,23 +1,63 @@
 #pragma once
 
 #include "Common.h"
+#include "VulkanShaderModule.h"
 
 namespace jgw
 {
+    // Objects created by VulkanContext::CreateGraphicsPipeline against those it handed out again
+    struct PipelineStats
+    {
+        uint32_t pipelinesCreated = 0;
+        uint32_t pipelinesShared = 0;
+        uint32_t layoutsCreated = 0;
+        uint32_t layoutsShared = 0;
+        uint32_t shaderModulesCreated = 0;
+        uint32_t shaderModulesShared = 0;
+    };
+
+    class VulkanPipelineLayout final
+    {
+    public:
+        CLASS_COPY_MOVE_DELETE(VulkanPipelineLayout)
+
+        explicit VulkanPipelineLayout(vk::Device device, const vk::PipelineLayoutCreateInfo& layoutCI, std::string key);
+        ~VulkanPipelineLayout();
+
+        vk::PipelineLayout Handle() const { return pipelineLayout; }
+        const std::string& Key() const { return key; }
+
+    private:
+        vk::Device device;
+        vk::PipelineLayout pipelineLayout;
+        std::string key;
+    };
+
+    // May be shared by everything built from the same PipelineBuilder state, see VulkanContext::CreateGraphicsPipeline.
+    // Keeps its layout and shader modules alive so further permutations reuse them.
     class VulkanPipeline final
     {
     public:
         CLASS_COPY_MOVE_DELETE(VulkanPipeline)
 
-        explicit VulkanPipeline(vk::Device device, vk::Pipeline pipeline, vk::PipelineLayout pipelineLayout);
+        explicit VulkanPipeline(
+            vk::Device device,
+            vk::Pipeline pipeline,
+            std::shared_ptr<VulkanPipelineLayout> pipelineLayout,
+            std::vector<std::shared_ptr<VulkanShaderModule>> shaderModules,
+            std::string key
+        );
         ~VulkanPipeline();
 
         vk::Pipeline Handle() const { return pipeline; }
-        vk::PipelineLayout Layout() const { return pipelineLayout; }
+        vk::PipelineLayout Layout() const { return pipelineLayout->Handle(); }
+        const std::string& Key() const { return key; }
 
     private:
         vk::Device device;
         vk::Pipeline pipeline;
-        vk::PipelineLayout pipelineLayout;
+        std::shared_ptr<VulkanPipelineLayout> pipelineLayout;
+        std::vector<std::shared_ptr<VulkanShaderModule>> shaderModules;
+        std::string key;
     };
 }
@@ -0,0 +1,141 @@
+#include "VulkanPipelineCache.h"
+#include "Hash.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+namespace jgw
+{
+    namespace
+    {
+        constexpr uint32_t kCacheMagic = 0x4350474a; // "JGPC"
+        constexpr uint32_t kCacheVersion = 1;
+    }
+
+    VulkanPipelineCache::VulkanPipelineCache(vk::Device device, vk::PhysicalDevice physicalDevice, const char* filename)
+        : device(device)
+    {
+        const auto properties = physicalDevice.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceIDProperties>();
+        const auto& deviceProperties = properties.get<vk::PhysicalDeviceProperties2>().properties;
+        const auto& idProperties = properties.get<vk::PhysicalDeviceIDProperties>();
+
+        deviceHeader.magic = kCacheMagic;
+        deviceHeader.version = kCacheVersion;
+        deviceHeader.vendorID = deviceProperties.vendorID;
+        deviceHeader.deviceID = deviceProperties.deviceID;
+        deviceHeader.driverVersion = deviceProperties.driverVersion;
+        std::copy(idProperties.deviceUUID.begin(), idProperties.deviceUUID.end(), deviceHeader.deviceUUID.begin());
+        std::copy(deviceProperties.pipelineCacheUUID.begin(), deviceProperties.pipelineCacheUUID.end(), deviceHeader.pipelineCacheUUID.begin());
+
+        const std::vector<uint8_t> data = Load(filename);
+        loadedSize = data.size();
+        loadedChecksum = data.empty() ? 0 : HashBytes(data.data(), data.size());
+
+        vk::PipelineCacheCreateInfo cacheCI{
+            .initialDataSize = data.size(),
+            .pInitialData = data.empty() ? nullptr : data.data()
+        };
+        cache = device.createPipelineCache(cacheCI);
+
+        if (loadedSize > 0)
+            spdlog::info("Pipeline cache: loaded {} bytes from {}", loadedSize, filename);
+    }
+
+    VulkanPipelineCache::~VulkanPipelineCache()
+    {
+        device.destroyPipelineCache(cache);
+    }
+
+    VulkanPipelineCache::FileHeader VulkanPipelineCache::MakeHeader(const std::vector<uint8_t>& data) const
+    {
+        FileHeader header = deviceHeader;
+        header.dataSize = data.size();
+        header.checksum = HashBytes(data.data(), data.size());
+        return header;
+    }
+
+    std::vector<uint8_t> VulkanPipelineCache::Load(const char* filename) const
+    {
+        std::ifstream is(filename, std::ios::binary);
+        if (!is.is_open())
+            return {};
+
+        FileHeader header{};
+        if (!is.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != kCacheMagic || header.dataSize > (uint64_t(1) << 31))
+        {
+            spdlog::warn("Pipeline cache: {} is not a cache file, ignored", filename);
+            return {};
+        }
+
+        std::vector<uint8_t> data(static_cast<size_t>(header.dataSize));
+        if (!is.read(reinterpret_cast<char*>(data.data()), data.size()))
+        {
+            spdlog::warn("Pipeline cache: {} is truncated, ignored", filename);
+            return {};
+        }
+
+        // A driver update or another GPU invalidates the cache, a checksum mismatch means a corrupt file
+        if (header != MakeHeader(data))
+        {
+            spdlog::info("Pipeline cache: {} was written for another device, driver or is corrupt, ignored", filename);
+            return {};
+        }
+
+        return data;
+    }
+
+    bool VulkanPipelineCache::Save(const char* filename)
+    {
+        std::vector<uint8_t> data;
+        try
+        {
+            data = device.getPipelineCacheData(cache);
+        }
+        catch (const vk::SystemError& err)
+        {
+            spdlog::error("Pipeline cache: {}", err.what());
+            return false;
+        }
+
+        // Nothing new was compiled, the file on disk is already up to date
+        const FileHeader header = MakeHeader(data);
+        if (data.empty() || (data.size() == loadedSize && header.checksum == loadedChecksum))
+            return true;
+
+        std::error_code error;
+        const std::filesystem::path path(filename);
+        if (path.has_parent_path())
+            std::filesystem::create_directories(path.parent_path(), error);
+
+        std::filesystem::path tempPath = path;
+        tempPath += ".tmp";
+        {
+            std::ofstream os(tempPath, std::ios::binary | std::ios::trunc);
+            if (!os.is_open())
+            {
+                spdlog::error("Could not open pipeline cache file {}", tempPath.string());
+                return false;
+            }
+
+            os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            os.write(reinterpret_cast<const char*>(data.data()), data.size());
+            if (!os)
+            {
+                spdlog::error("Could not write pipeline cache file {}", tempPath.string());
+                return false;
+            }
+        }
+
+        std::filesystem::rename(tempPath, path, error);
+        if (error)
+        {
+            spdlog::error("Could not replace pipeline cache file {}: {}", filename, error.message());
+            std::filesystem::remove(tempPath, error);
+            return false;
+        }
+
+        spdlog::info("Pipeline cache: saved {} bytes to {}", data.size(), filename);
+        return true;
+    }
+}
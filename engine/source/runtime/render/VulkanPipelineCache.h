@@ -0,0 +1,55 @@
+#pragma once
+
+#include "Common.h"
+
+#include <array>
+
+namespace jgw
+{
+    // Pipeline cache kept on disk between runs. The file starts with a header naming the device, driver and
+    // a checksum of the data, a file written for anything else is ignored and the cache starts out empty.
+    // Vulkan caches are internally synchronized, so pipelines may be created with it from any thread.
+    class VulkanPipelineCache final
+    {
+    public:
+        CLASS_COPY_MOVE_DELETE(VulkanPipelineCache)
+
+        VulkanPipelineCache(vk::Device device, vk::PhysicalDevice physicalDevice, const char* filename);
+        ~VulkanPipelineCache();
+
+        // Written to a temporary file that replaces the old one, a crash while saving leaves the old cache intact
+        bool Save(const char* filename);
+
+        vk::PipelineCache Handle() const { return cache; }
+
+        // Bytes seeded from the file, 0 when it was missing or rejected
+        size_t GetLoadedSize() const { return loadedSize; }
+
+    private:
+        struct FileHeader
+        {
+            uint32_t magic = 0;
+            uint32_t version = 0;
+            uint32_t vendorID = 0;
+            uint32_t deviceID = 0;
+            uint32_t driverVersion = 0;
+            uint32_t headerSize = sizeof(FileHeader);
+            std::array<uint8_t, VK_UUID_SIZE> deviceUUID{};
+            std::array<uint8_t, VK_UUID_SIZE> pipelineCacheUUID{};
+            uint64_t dataSize = 0;
+            uint64_t checksum = 0;
+
+            bool operator==(const FileHeader&) const = default;
+        };
+
+        FileHeader MakeHeader(const std::vector<uint8_t>& data) const;
+        std::vector<uint8_t> Load(const char* filename) const;
+
+        vk::Device device;
+        vk::PipelineCache cache;
+
+        FileHeader deviceHeader{};
+        size_t loadedSize = 0;
+        uint64_t loadedChecksum = 0;
+    };
+}
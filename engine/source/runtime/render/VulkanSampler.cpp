@@ -0,0 +1,19 @@
+#include "VulkanSampler.h"
+
+namespace jgw
+{
+    VulkanSampler::VulkanSampler(vk::Device device, const vk::SamplerCreateInfo& samplerCI) :
+        device(device),
+        samplerCI(samplerCI)
+    {
+        sampler = device.createSampler(samplerCI);
+    }
+
+    VulkanSampler::~VulkanSampler()
+    {
+        if (device)
+        {
+            device.destroySampler(sampler);
+        }
+    }
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "Common.h"
+
+namespace jgw
+{
+    class VulkanSampler final
+    {
+    public:
+        CLASS_COPY_MOVE_DELETE(VulkanSampler)
+
+        explicit VulkanSampler(vk::Device device, const vk::SamplerCreateInfo& samplerCI);
+        ~VulkanSampler();
+
+        vk::Sampler Handle() const { return sampler; }
+        const vk::SamplerCreateInfo& CreateInfo() const { return samplerCI; }
+
+    private:
+        vk::Device device;
+        vk::Sampler sampler;
+        vk::SamplerCreateInfo samplerCI;
+    };
+}
@@ -0,0 +1,24 @@
+#include "VulkanShaderModule.h"
+#include "Hash.h"
+
+namespace jgw
+{
+    VulkanShaderModule::VulkanShaderModule(vk::Device device, const std::vector<char>& code) :
+        device(device),
+        codeHash(HashBytes(code.data(), code.size()))
+    {
+        vk::ShaderModuleCreateInfo shaderModuleCI{
+            .codeSize = code.size(),
+            .pCode = reinterpret_cast<const uint32_t*>(code.data())
+        };
+        module = device.createShaderModule(shaderModuleCI);
+    }
+
+    VulkanShaderModule::~VulkanShaderModule()
+    {
+        if (device)
+        {
+            device.destroyShaderModule(module);
+        }
+    }
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "Common.h"
+
+namespace jgw
+{
+    class VulkanShaderModule final
+    {
+    public:
+        CLASS_COPY_MOVE_DELETE(VulkanShaderModule)
+
+        explicit VulkanShaderModule(vk::Device device, const std::vector<char>& code);
+        ~VulkanShaderModule();
+
+        vk::ShaderModule Handle() const { return module; }
+
+        // Pipelines are keyed by code, the same SPIR-V under another path still shares them
+        uint64_t CodeHash() const { return codeHash; }
+
+    private:
+        vk::Device device;
+        vk::ShaderModule module;
+        uint64_t codeHash = 0;
+    };
+}
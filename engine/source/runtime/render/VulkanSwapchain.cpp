@@ -18,12 +18,13 @@ namespace jgw
         Destroy();
     }
 
-    bool VulkanSwapchain::Create(GLFWwindow* handle)
+    bool VulkanSwapchain::Create(GLFWwindow* handle, RetiredSwapchain* retired)
     {
         vk::SwapchainKHR oldSwapchain = swapchain;
         surfaceCaps = physicalDevice.getSurfaceCapabilitiesKHR(surface);
 
         swapchainExtent = GetSurfaceExtent(handle);
+        presentMode = ChoosePresentMode();
 
         vk::SwapchainCreateInfoKHR swapchainCI{
             .surface = surface,
@@ -36,7 +37,7 @@ namespace jgw
             .imageSharingMode = vk::SharingMode::eExclusive,
             .preTransform = surfaceCaps.currentTransform,
             .compositeAlpha = vk::CompositeAlphaFlagBitsKHR::eOpaque,
-            .presentMode = ChoosePresentMode(),
+            .presentMode = presentMode,
             .clipped = vk::True,
             .oldSwapchain = oldSwapchain
         };
@@ -44,10 +45,16 @@ namespace jgw
 
         if (oldSwapchain != nullptr)
         {
-            for (auto& imageView : swapchainImageViews)
-                device.destroyImageView(imageView);
-            device.destroySwapchainKHR(oldSwapchain);
+            RetiredSwapchain old{
+                .swapchain = oldSwapchain,
+                .imageViews = std::move(swapchainImageViews)
+            };
             swapchainImageViews.clear();
+
+            if (retired)
+                *retired = std::move(old);
+            else
+                DestroyRetired(old);
         }
 
         swapchainImages = device.getSwapchainImagesKHR(swapchain);
@@ -81,6 +88,17 @@ namespace jgw
         }
     }
 
+    void VulkanSwapchain::DestroyRetired(RetiredSwapchain& retired)
+    {
+        for (auto& imageView : retired.imageViews)
+            device.destroyImageView(imageView);
+        retired.imageViews.clear();
+
+        if (retired.swapchain)
+            device.destroySwapchainKHR(retired.swapchain);
+        retired.swapchain = nullptr;
+    }
+
     vk::Result VulkanSwapchain::AcquireImage(vk::Semaphore imageAvailableSemaphore)
     {
         return device.acquireNextImageKHR(swapchain, UINT64_MAX, imageAvailableSemaphore, nullptr, &imageIndex);
@@ -88,8 +106,11 @@ namespace jgw
 
     uint32_t VulkanSwapchain::ChooseMinImageCount() const
     {
-        uint32_t imageCount = surfaceCaps.minImageCount + 1;
-        if (imageCount > surfaceCaps.maxImageCount)
+        uint32_t imageCount = requestedImageCount > 0 ? requestedImageCount : surfaceCaps.minImageCount + 1;
+        imageCount = std::max(imageCount, surfaceCaps.minImageCount);
+
+        // A maximum of 0 means there is no limit
+        if (surfaceCaps.maxImageCount > 0 && imageCount > surfaceCaps.maxImageCount)
             imageCount = surfaceCaps.maxImageCount;
         return imageCount;
     }
@@ -123,14 +144,18 @@ namespace jgw
         return surfaceCaps.currentExtent;
     }
 
+    bool VulkanSwapchain::IsPresentModeSupported(vk::PresentModeKHR mode) const
+    {
+        return std::find(surfacePresentModes.begin(), surfacePresentModes.end(), mode) != surfacePresentModes.end();
+    }
+
     vk::PresentModeKHR VulkanSwapchain::ChoosePresentMode() const
     {
-        // Prefer mailbox mode for lower latency, fall back to FIFO if not available
-        for (const auto& mode : surfacePresentModes)
-        {
-            if (mode == vk::PresentModeKHR::eMailbox)
-                return mode;
-        }
+        // FIFO is the only mode every surface supports
+        if (IsPresentModeSupported(requestedPresentMode))
+            return requestedPresentMode;
+
+        spdlog::warn("Present mode {} not supported, using FIFO", vk::to_string(requestedPresentMode));
         return vk::PresentModeKHR::eFifo;
     }
 }
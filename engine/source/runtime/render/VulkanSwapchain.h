@@ -5,6 +5,13 @@
 
 namespace jgw
 {
+    // Handles of a replaced swapchain that in-flight frames may still present from
+    struct RetiredSwapchain
+    {
+        vk::SwapchainKHR swapchain{};
+        std::vector<vk::ImageView> imageViews;
+    };
+
     class VulkanSwapchain final
     {
     public:
@@ -13,11 +20,19 @@ namespace jgw
         VulkanSwapchain(vk::PhysicalDevice& physicalDevice, vk::Device& device, vk::SurfaceKHR& surface);
         ~VulkanSwapchain();
 
-        bool Create(GLFWwindow* handle);
+        // The current swapchain is passed as oldSwapchain. Without retired its handles are destroyed right away,
+        // otherwise they are handed to the caller to be destroyed with DestroyRetired once the GPU is done with them.
+        bool Create(GLFWwindow* handle, RetiredSwapchain* retired = nullptr);
         void Destroy();
+        void DestroyRetired(RetiredSwapchain& retired);
 
         vk::Result AcquireImage(vk::Semaphore imageAvailableSemaphore);
 
+        // Take effect on the next Create
+        void SetPresentMode(vk::PresentModeKHR mode) { requestedPresentMode = mode; }
+        void SetImageCount(uint32_t count) { requestedImageCount = count; }
+        bool IsPresentModeSupported(vk::PresentModeKHR mode) const;
+
         vk::SwapchainKHR* GetHandle() { return &swapchain; }
         vk::Image GetImage() { return swapchainImages[imageIndex]; }
         vk::ImageView GetImageView() { return swapchainImageViews[imageIndex]; }
@@ -25,6 +40,7 @@ namespace jgw
         vk::Format GetFormat() const { return surfaceFormat.format; }
         uint32_t GetImageIndex() const { return imageIndex; }
         uint32_t GetImageCount() const { return swapchainImages.size(); }
+        vk::PresentModeKHR GetPresentMode() const { return presentMode; }
 
     private:
         uint32_t ChooseMinImageCount() const;
@@ -46,6 +62,10 @@ namespace jgw
         vk::SurfaceCapabilitiesKHR surfaceCaps{};
         vk::SwapchainKHR swapchain{};
         vk::Extent2D swapchainExtent;
+        vk::PresentModeKHR presentMode{ vk::PresentModeKHR::eFifo };
+
+        vk::PresentModeKHR requestedPresentMode{ vk::PresentModeKHR::eMailbox };
+        uint32_t requestedImageCount{ 0 };
 
         uint32_t imageIndex{ 0 };
     };
@@ -1,4 +1,8 @@
 #include "VulkanTexture.h"
+#include "ResidencyManager.h"
+#include "TextureStreamer.h"
+
+#include <algorithm>
 
 namespace jgw
 {
@@ -7,25 +11,12 @@ namespace jgw
         , vmaAllocator(allocator)
         , desc(desc)
     {
-        vk::ImageCreateInfo imageCI{
-            .flags = desc.flags,
-            .imageType = desc.imageType,
-            .format = desc.format,
-            .extent = desc.extent,
-            .mipLevels = desc.mipLevels,
-            .arrayLayers = desc.arrayLayers,
-            .samples = desc.samples,
-            .tiling = desc.tiling,
-            .usage = desc.usageFlags,
-            .sharingMode = desc.sharingMode,
-            .queueFamilyIndexCount = static_cast<uint32_t>(desc.queueFamilyIndices.size()),
-            .pQueueFamilyIndices = desc.queueFamilyIndices.data(),
-            .initialLayout = desc.initialLayout
-        };
+        vk::ImageCreateInfo imageCI = BuildImageCI(desc);
 
         vma::AllocationCreateInfo allocationCI{
             .flags = allocDesc.flags,
             .usage = allocDesc.usage,
+            .pool = allocDesc.pool,
             .priority = allocDesc.priority
         };
 
@@ -54,10 +45,85 @@ namespace jgw
 
     VulkanTexture::~VulkanTexture()
     {
+        if (residency)
+            residency->Unregister(this);
+        if (streamer)
+            streamer->Unregister(this);
+
+        if (tracker)
+            tracker->Remove(category, vmaAllocationInfo.size);
+
         device.destroyImageView(imageView);
         vmaAllocator.destroyImage(image, vmaAllocation);
     }
 
+    vk::ImageCreateInfo VulkanTexture::BuildImageCI(const TextureDesc& desc)
+    {
+        return vk::ImageCreateInfo{
+            .flags = desc.flags,
+            .imageType = desc.imageType,
+            .format = desc.format,
+            .extent = desc.extent,
+            .mipLevels = desc.mipLevels,
+            .arrayLayers = desc.arrayLayers,
+            .samples = desc.samples,
+            .tiling = desc.tiling,
+            .usage = desc.usageFlags,
+            .sharingMode = desc.sharingMode,
+            .queueFamilyIndexCount = static_cast<uint32_t>(desc.queueFamilyIndices.size()),
+            .pQueueFamilyIndices = desc.queueFamilyIndices.data(),
+            .initialLayout = desc.initialLayout
+        };
+    }
+
+    uint32_t VulkanTexture::GetTexelSize(vk::Format format)
+    {
+        switch (format)
+        {
+        case vk::Format::eR8Unorm:
+        case vk::Format::eR8Srgb:
+            return 1;
+        case vk::Format::eR8G8Unorm:
+        case vk::Format::eR8G8Srgb:
+        case vk::Format::eR16Sfloat:
+            return 2;
+        case vk::Format::eR8G8B8A8Unorm:
+        case vk::Format::eR8G8B8A8Srgb:
+        case vk::Format::eB8G8R8A8Unorm:
+        case vk::Format::eB8G8R8A8Srgb:
+        case vk::Format::eR16G16Sfloat:
+        case vk::Format::eR32Sfloat:
+        case vk::Format::eA2B10G10R10UnormPack32:
+        case vk::Format::eB10G11R11UfloatPack32:
+            return 4;
+        case vk::Format::eR16G16B16A16Sfloat:
+        case vk::Format::eR32G32Sfloat:
+            return 8;
+        case vk::Format::eR32G32B32A32Sfloat:
+            return 16;
+        default:
+            return 0;
+        }
+    }
+
+    vk::Extent3D VulkanTexture::GetMipExtent(const vk::Extent3D& extent, uint32_t level)
+    {
+        return {
+            .width = std::max(1u, extent.width >> level),
+            .height = std::max(1u, extent.height >> level),
+            .depth = std::max(1u, extent.depth >> level)
+        };
+    }
+
+    void VulkanTexture::SwapStorage(VulkanTexture& other)
+    {
+        std::swap(image, other.image);
+        std::swap(imageView, other.imageView);
+        std::swap(vmaAllocation, other.vmaAllocation);
+        std::swap(vmaAllocationInfo, other.vmaAllocationInfo);
+        std::swap(desc, other.desc);
+    }
+
     void VulkanTexture::TransitionLayout(vk::CommandBuffer commandBuffer, vk::ImageLayout oldLayout, vk::ImageLayout newLayout)
     {
         vk::ImageMemoryBarrier barrier{
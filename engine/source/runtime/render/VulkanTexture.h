@@ -1,6 +1,10 @@
 #pragma once
 
 #include "Common.h"
+#include "VulkanMemoryStats.h"
+#include "VulkanBuffer.h"
+
+#include <functional>
 
 namespace jgw
 {
@@ -27,12 +31,15 @@ namespace jgw
     {
         vma::AllocationCreateFlags flags = {};
         vma::MemoryUsage usage = vma::MemoryUsage::eAutoPreferDevice;
+        vma::Pool pool = {};
         float priority = 1.0f;
     };
 
     class VulkanTexture final
     {
         friend class VulkanContext;
+        friend class ResidencyManager;
+        friend class TextureStreamer;
 
     public:
         CLASS_COPY_MOVE_DELETE(VulkanTexture)
@@ -41,13 +48,29 @@ namespace jgw
 
         ~VulkanTexture();
 
+        static vk::ImageCreateInfo BuildImageCI(const TextureDesc& desc);
+
+        // Bytes per texel of uncompressed formats, 0 if unknown
+        static uint32_t GetTexelSize(vk::Format format);
+        static vk::Extent3D GetMipExtent(const vk::Extent3D& extent, uint32_t level);
+
         void TransitionLayout(vk::CommandBuffer commandBuffer, vk::ImageLayout oldLayout, vk::ImageLayout newLayout);
         void TransitionMipLayout(vk::CommandBuffer commandBuffer, vk::ImageLayout oldLayout, vk::ImageLayout newLayout, uint32_t mipLevel);
         void GenerateMipmap(vk::CommandBuffer commandBuffer);
 
         vk::Format GetFormat() const { return desc.format; }
+        vk::Image GetImage() const { return image; }
         vk::ImageView GetView() const { return imageView; }
 
+        // Called at the start of a frame when the residency manager replaced the image view. Frames in flight
+        // may still have the old view bound, so descriptors are rewritten per frame slot rather than in place.
+        // Only textures with a callback are considered for eviction.
+        void SetViewChangedCallback(std::function<void(VulkanTexture*)> callback) { onViewChanged = std::move(callback); }
+        bool IsEvicted() const { return evictedMips > 0; }
+
+        // Exchange the underlying image, view and allocation
+        void SwapStorage(VulkanTexture& other);
+
     private:
         vma::Allocator vmaAllocator;
         vma::Allocation vmaAllocation;
@@ -58,5 +81,16 @@ namespace jgw
         vk::ImageView imageView;
         
         TextureDesc desc;
+
+        MemoryTracker* tracker{ nullptr };
+        EMemoryCategory category{ EMemoryCategory::Texture };
+
+        ResidencyManager* residency{ nullptr };
+        TextureStreamer* streamer{ nullptr };
+        uint64_t lastUsedFrame{ 0 };
+        uint32_t evictedMips{ 0 };
+        TextureDesc evictedDesc{};
+        std::unique_ptr<VulkanBuffer> evictedData;
+        std::function<void(VulkanTexture*)> onViewChanged;
     };
 }
@@ -1,9 +1,10 @@
 #include "Project0.h"
 
-int main()
+int main(int argc, char** argv)
 {
     jgw::WindowConfig config;
     config.title = "Vulkan Project 0";
+    jgw::ParseCommandLine(argc, argv, config);
 
     jgw::Project0 app(config);
     app.Start();
@@ -13,10 +13,10 @@ namespace jgw
 
     protected:
         virtual bool OnInit() override;
-        virtual void OnRender(vk::CommandBuffer commandBuffer) override;
+        virtual void OnRender(RenderGraph& graph) override;
         virtual void OnCleanup() override;
 
     private:
-        std::unique_ptr<VulkanPipeline> pipeline;
+        std::shared_ptr<VulkanPipeline> pipeline;
     };
 }
\ No newline at end of file
@@ -1,9 +1,10 @@
 #include "Project1.h"
 
-int main()
+int main(int argc, char** argv)
 {
     jgw::WindowConfig config;
     config.title = "Vulkan Project 1";
+    jgw::ParseCommandLine(argc, argv, config);
 
     jgw::Project1 app(config);
     app.Start();
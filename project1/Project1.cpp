@@ -8,6 +8,9 @@ namespace jgw
     Project1::Project1(const WindowConfig& config) : BaseApp(config)
     {
         pcData.model = glm::rotate(glm::mat4(1.0f), -glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+
+        // Mip feedback is written with atomics from the fragment shader
+        contextPtr->GetDeviceFeatures().fragmentStoresAndAtomics = vk::True;
     }
 
     bool Project1::OnInit()
@@ -38,86 +41,67 @@ namespace jgw
     void Project1::OnUpdate(double delta)
     {
         cameraPtr->Update(delta);
-
-        pcData.view = cameraPtr->GetViewMatrix();
-        pcData.proj = cameraPtr->GetProjMatrix();
-        pcData.cameraPos = glm::vec4(cameraPtr->GetPosition(), 1);
     }
 
-    void Project1::OnRender(vk::CommandBuffer commandBuffer)
+    void Project1::OnRender(RenderGraph& graph)
     {
-        vk::ClearValue colorCV{
-            .color = std::array<float, 4>({0.0f, 0.0f, 0.0f, 1.0f}),
-        };
-
-        vk::RenderingAttachmentInfo colorAttachment{
-            .imageView = contextPtr->GetSwapchain()->GetImageView(),
-            .imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
-            .loadOp = vk::AttachmentLoadOp::eClear,
-            .storeOp = vk::AttachmentStoreOp::eStore,
-            .clearValue = colorCV
-        };
-
-        vk::ClearValue depthCV{
-            .depthStencil = { .depth = 1.0f }
-        };
-
-        vk::RenderingAttachmentInfo depthAttachment{
-            .imageView = contextPtr->GetDepthTexture()->GetView(),
-            .imageLayout = vk::ImageLayout::eDepthAttachmentOptimal,
-            .loadOp = vk::AttachmentLoadOp::eClear,
-            .storeOp = vk::AttachmentStoreOp::eStore,
-            .clearValue = depthCV
-        };
-
-        vk::RenderingInfo renderInfo{
-            .renderArea = {.offset = {0, 0}, .extent = contextPtr->GetSwapchain()->GetExtent() },
-            .layerCount = 1,
-            .colorAttachmentCount = 1,
-            .pColorAttachments = &colorAttachment,
-            .pDepthAttachment = &depthAttachment
-        };
-
-        commandBuffer.beginRendering(renderInfo);
-
-        commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline->Handle());
-        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline->Layout(), 0, 1, &descriptorSet, 0, nullptr);
-
-        vk::Buffer vertexBuffers[] = { vertexBuffer->Handle() };
-        vk::DeviceSize offsets[] = { 0 };
-        commandBuffer.bindVertexBuffers(0, 1, vertexBuffers, offsets);
-        commandBuffer.bindIndexBuffer(indexBuffer->Handle(), 0, vk::IndexType::eUint32);
-
-        auto extent = contextPtr->GetSwapchain()->GetExtent();
-        vk::Viewport viewport{
-            .x = 0.0f,
-            .y = 0.0f,
-            .width = static_cast<float>(extent.width),
-            .height = static_cast<float>(extent.height),
-            .minDepth = 0.0f,
-            .maxDepth = 1.0f
-        };
-        commandBuffer.setViewport(0, 1, &viewport);
-
-        vk::Rect2D scissor{
-            .offset = {0, 0},
-            .extent = extent
-        };
-        commandBuffer.setScissor(0, 1, &scissor);
-
-        commandBuffer.pushConstants(pipeline->Layout(), vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, 0, sizeof(PushConstantData), &pcData);
-        commandBuffer.drawIndexed(indices.size(), 1, 0, 0, 0);
-
-        // Render skybox
-        commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, skyboxPipeline->Handle());
-        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, skyboxPipeline->Layout(), 0, 1, &descriptorSet, 0, nullptr);
-        commandBuffer.pushConstants(skyboxPipeline->Layout(), vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, 0, sizeof(PushConstantData), &pcData);
-        commandBuffer.draw(36, 1, 0, 0);
-
-        canvas3D->Render(*contextPtr);
-        imguiPtr->Render(commandBuffer);
-
-        commandBuffer.endRendering();
+        graph.AddPass("Main")
+            .WriteColor(swapchainTarget, vk::ClearColorValue{ std::array<float, 4>({0.0f, 0.0f, 0.0f, 1.0f}) })
+            .WriteDepth(depthTarget, vk::ClearDepthStencilValue{ .depth = 1.0f })
+            .SetExecute([this](vk::CommandBuffer commandBuffer) {
+                // The GPU is done with the last frame of this slot, its set can be rewritten
+                const uint32_t frame = contextPtr->GetCurrentFrame();
+                if (descriptorVersions[frame] != textureVersion)
+                {
+                    WriteTextureDescriptors(descriptorSets[frame]);
+                    descriptorVersions[frame] = textureVersion;
+                }
+                const vk::DescriptorSet descriptorSet = descriptorSets[frame];
+
+                commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline->Handle());
+                const uint32_t feedbackOffset = contextPtr->GetTextureStreamer()->GetFeedbackOffset();
+                commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline->Layout(), 0, 1, &descriptorSet, 1, &feedbackOffset);
+
+                contextPtr->MarkUsed(vertexBuffer.get());
+                contextPtr->MarkUsed(indexBuffer.get());
+                contextPtr->MarkUsed(modelTexture.get());
+                contextPtr->MarkUsed(cubeTexture.get());
+
+                vk::Buffer vertexBuffers[] = { vertexBuffer->Handle() };
+                vk::DeviceSize offsets[] = { 0 };
+                commandBuffer.bindVertexBuffers(0, 1, vertexBuffers, offsets);
+                commandBuffer.bindIndexBuffer(indexBuffer->Handle(), 0, vk::IndexType::eUint32);
+
+                auto extent = contextPtr->GetRenderExtent();
+                vk::Viewport viewport{
+                    .x = 0.0f,
+                    .y = 0.0f,
+                    .width = static_cast<float>(extent.width),
+                    .height = static_cast<float>(extent.height),
+                    .minDepth = 0.0f,
+                    .maxDepth = 1.0f
+                };
+                commandBuffer.setViewport(0, 1, &viewport);
+
+                vk::Rect2D scissor{
+                    .offset = {0, 0},
+                    .extent = extent
+                };
+                commandBuffer.setScissor(0, 1, &scissor);
+
+                pcData.frameConstants = contextPtr->GetFrameConstantsAddress();
+                commandBuffer.pushConstants(pipeline->Layout(), vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, 0, sizeof(PushConstantData), &pcData);
+                commandBuffer.drawIndexed(indices.size(), 1, 0, 0, 0);
+
+                // Render skybox
+                commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, skyboxPipeline->Handle());
+                commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, skyboxPipeline->Layout(), 0, 1, &descriptorSet, 1, &feedbackOffset);
+                commandBuffer.pushConstants(skyboxPipeline->Layout(), vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, 0, sizeof(PushConstantData), &pcData);
+                commandBuffer.draw(36, 1, 0, 0);
+
+                canvas3D->Render(*contextPtr);
+                imguiPtr->Render(commandBuffer);
+            });
     }
 
     void Project1::OnCleanup()
@@ -125,7 +109,6 @@ namespace jgw
         auto device = GetDevice();
         device.destroyDescriptorSetLayout(descriptorSetLayout);
         device.destroyDescriptorPool(descriptorPool);
-        device.destroySampler(sampler);
 
         vertexBuffer.reset();
         indexBuffer.reset();
@@ -133,21 +116,20 @@ namespace jgw
         skyboxPipeline.reset();
         modelTexture.reset();
         cubeTexture.reset();
+        sampler.reset();
     }
 
     void Project1::OnResize(int width, int height)
     {
-        auto extent = contextPtr->GetSwapchain()->GetExtent();
+        auto extent = contextPtr->GetRenderExtent();
         const float aspect = extent.width / (float)extent.height;
         cameraPtr->SetAspectRatio(aspect);
     }
 
     void Project1::OnGizmos()
     {
-        auto viewMatrix = cameraPtr->GetViewMatrix();
         auto projMatrix = cameraPtr->GetProjMatrix();
 
-        canvas3D->SetMatrix(projMatrix * viewMatrix);
         canvas3D->Plane(glm::vec3(0, 0, 0), glm::vec3(1, 0, 0), glm::vec3(0, 0, 1), 40, 40, 10.0f, 10.0f, glm::vec4(1, 0, 0, 1), glm::vec4(0, 1, 0, 1));
         canvas3D->Box(pcData.model, glm::vec3(2, 2, 2), glm::vec4(1, 1, 0, 1));
         canvas3D->Frustum(
@@ -216,8 +198,14 @@ namespace jgw
         contextPtr->UploadBuffer(indices.data(), stagingIndexBuffer.get(), indexBuffer.get());
         contextPtr->EndCommand();
 
-        modelTexture = LoadTexture("../assets/rubber_duck/textures/Duck_baseColor.png", true);
-        cubeTexture = LoadCubeTexture("../assets/cubemap_yokohama_rgba.ktx", vk::Format::eR8G8B8A8Unorm);
+        modelTexture = LoadStreamingTexture("../assets/rubber_duck/textures/Duck_baseColor.png");
+        if (!modelTexture)
+            return false;
+
+        pcData.feedbackSlot = contextPtr->GetTextureStreamer()->GetSlot(modelTexture.get());
+        cubeTexture = AcquireKtxTexture("../assets/cubemap_yokohama_rgba.ktx", vk::Format::eR8G8B8A8Unorm);
+        if (!cubeTexture)
+            return false;
 
         vk::SamplerCreateInfo samplerCI{
             .magFilter = vk::Filter::eLinear,
@@ -226,7 +214,7 @@ namespace jgw
             .minLod = 0,
             .maxLod = 13
         };
-        sampler = GetDevice().createSampler(samplerCI);
+        sampler = contextPtr->GetSampler(samplerCI);
         
         return true;
     }
@@ -248,6 +236,12 @@ namespace jgw
                 .descriptorType = vk::DescriptorType::eCombinedImageSampler,
                 .descriptorCount = 1,
                 .stageFlags = vk::ShaderStageFlagBits::eFragment
+            },
+            {
+                .binding = 2,
+                .descriptorType = vk::DescriptorType::eStorageBufferDynamic,
+                .descriptorCount = 1,
+                .stageFlags = vk::ShaderStageFlagBits::eFragment
             }
         };
 
@@ -259,50 +253,86 @@ namespace jgw
         descriptorSetLayout = device.createDescriptorSetLayout(layoutCI);
 
         // Create descriptor pool
-        vk::DescriptorPoolSize poolSize{
-            .type = vk::DescriptorType::eCombinedImageSampler,
-            .descriptorCount = 2
+        const uint32_t setCount = static_cast<uint32_t>(descriptorSets.size());
+        std::vector<vk::DescriptorPoolSize> poolSizes = {
+            { .type = vk::DescriptorType::eCombinedImageSampler, .descriptorCount = 2 * setCount },
+            { .type = vk::DescriptorType::eStorageBufferDynamic, .descriptorCount = setCount }
         };
 
         vk::DescriptorPoolCreateInfo poolInfo{
-            .maxSets = 1,
-            .poolSizeCount = 1,
-            .pPoolSizes = &poolSize
+            .maxSets = setCount,
+            .poolSizeCount = static_cast<uint32_t>(poolSizes.size()),
+            .pPoolSizes = poolSizes.data()
         };
 
         descriptorPool = device.createDescriptorPool(poolInfo);
 
         // Create descriptor sets
+        std::vector<vk::DescriptorSetLayout> setLayouts(setCount, descriptorSetLayout);
         vk::DescriptorSetAllocateInfo allocInfo{
             .descriptorPool = descriptorPool,
-            .descriptorSetCount = 1,
-            .pSetLayouts = &descriptorSetLayout
+            .descriptorSetCount = setCount,
+            .pSetLayouts = setLayouts.data()
         };
 
-        descriptorSet = device.allocateDescriptorSets(allocInfo)[0];
+        auto sets = device.allocateDescriptorSets(allocInfo);
+        std::copy(sets.begin(), sets.end(), descriptorSets.begin());
 
-        vk::DescriptorImageInfo imageInfo{
-            .sampler = sampler,
-            .imageView = modelTexture->GetView(),
-            .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal
+        // Mip feedback of the streamed model texture, offset selects the range of the current frame
+        vk::DescriptorBufferInfo feedbackInfo{
+            .buffer = contextPtr->GetTextureStreamer()->GetFeedbackBuffer(),
+            .offset = 0,
+            .range = contextPtr->GetTextureStreamer()->GetFeedbackRange()
         };
 
+        for (vk::DescriptorSet set : descriptorSets)
+        {
+            WriteTextureDescriptors(set);
+
+            vk::WriteDescriptorSet feedbackWrite{
+                .dstSet = set,
+                .dstBinding = 2,
+                .dstArrayElement = 0,
+                .descriptorCount = 1,
+                .descriptorType = vk::DescriptorType::eStorageBufferDynamic,
+                .pBufferInfo = &feedbackInfo
+            };
+
+            device.updateDescriptorSets(1, &feedbackWrite, 0, nullptr);
+        }
+
+        // Evicted, restored or streamed textures come back with a new view, frames in flight may still use the old one
+        modelTexture->SetViewChangedCallback([this](VulkanTexture*) { ++textureVersion; });
+        cubeTexture->SetViewChangedCallback([this](VulkanTexture*) { ++textureVersion; });
+
+        return true;
+    }
+
+    void Project1::WriteTextureDescriptors(vk::DescriptorSet set)
+    {
+        const std::array<vk::DescriptorImageInfo, 2> imageInfos = { {
+            {
+                .sampler = sampler->Handle(),
+                .imageView = modelTexture->GetView(),
+                .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal
+            },
+            {
+                .sampler = sampler->Handle(),
+                .imageView = cubeTexture->GetView(),
+                .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal
+            }
+        } };
+
         vk::WriteDescriptorSet descriptorWrite{
-            .dstSet = descriptorSet,
+            .dstSet = set,
             .dstBinding = 0,
             .dstArrayElement = 0,
-            .descriptorCount = 1,
+            .descriptorCount = static_cast<uint32_t>(imageInfos.size()),
             .descriptorType = vk::DescriptorType::eCombinedImageSampler,
-            .pImageInfo = &imageInfo
+            .pImageInfo = imageInfos.data()
         };
 
-        device.updateDescriptorSets(1, &descriptorWrite, 0, nullptr);
-
-        imageInfo.imageView = cubeTexture->GetView();
-        descriptorWrite.dstBinding = 1;
-        device.updateDescriptorSets(1, &descriptorWrite, 0, nullptr);
-
-        return true;
+        GetDevice().updateDescriptorSets(1, &descriptorWrite, 0, nullptr);
     }
 
     bool Project1::CreatePipeline()
@@ -354,7 +384,7 @@ namespace jgw
     void Project1::SetupCamera()
     {
         cameraPtr->SetPosition(glm::vec3(0.0f, 1.0f, 3.0f));
-        auto extent = contextPtr->GetSwapchain()->GetExtent();
+        auto extent = contextPtr->GetRenderExtent();
         const float aspect = extent.width / (float)extent.height;
         cameraPtr->SetPerspective(glm::radians(45.0f), aspect, 0.1f, 1000.0f);
     }
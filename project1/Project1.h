@@ -21,7 +21,7 @@ namespace jgw
     protected:
         virtual bool OnInit() override;
         virtual void OnUpdate(double delta) override;
-        virtual void OnRender(vk::CommandBuffer commandBuffer) override;
+        virtual void OnRender(RenderGraph& graph) override;
         virtual void OnCleanup() override;
         virtual void OnResize(int width, int height) override;
         virtual void OnGizmos() override;
@@ -29,6 +29,7 @@ namespace jgw
     private:
         bool LoadModel();
         bool CreateDescriptors();
+        void WriteTextureDescriptors(vk::DescriptorSet set);
         bool CreatePipeline();
         void SetupCamera();
 
@@ -37,22 +38,26 @@ namespace jgw
 
         std::unique_ptr<VulkanBuffer> vertexBuffer;
         std::unique_ptr<VulkanBuffer> indexBuffer;
-        std::unique_ptr<VulkanPipeline> pipeline;
-        std::unique_ptr<VulkanPipeline> skyboxPipeline;
+        std::shared_ptr<VulkanPipeline> pipeline;
+        std::shared_ptr<VulkanPipeline> skyboxPipeline;
         std::unique_ptr<VulkanTexture> modelTexture;
-        std::unique_ptr<VulkanTexture> cubeTexture;
+        std::shared_ptr<VulkanTexture> cubeTexture;
+        std::shared_ptr<VulkanSampler> sampler;
 
-        vk::Sampler sampler{};
         vk::DescriptorPool descriptorPool{};
-        vk::DescriptorSet descriptorSet{};
         vk::DescriptorSetLayout descriptorSetLayout{};
 
+        // One set per frame slot, rewritten when the slot comes up again after a texture view changed
+        std::array<vk::DescriptorSet, VulkanContext::kMaxFrameInFlight> descriptorSets{};
+        std::array<uint32_t, VulkanContext::kMaxFrameInFlight> descriptorVersions{};
+        uint32_t textureVersion = 0;
+
+        // Camera data is read from the shared frame constants
         struct PushConstantData
         {
             glm::mat4 model;
-            glm::mat4 view;
-            glm::mat4 proj;
-            glm::vec4 cameraPos;
+            vk::DeviceAddress frameConstants;
+            uint32_t feedbackSlot;
         } pcData;
     };
 }
@@ -1,9 +1,10 @@
 #include "Project2.h"
 
-int main()
+int main(int argc, char** argv)
 {
     jgw::WindowConfig config;
     config.title = "Vulkan Project 2";
+    jgw::ParseCommandLine(argc, argv, config);
 
     jgw::Project2 app(config);
     app.Start();
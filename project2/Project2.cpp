@@ -33,84 +33,51 @@ namespace jgw
     void Project2::OnUpdate(double delta)
     {
         cameraPtr->Update(delta);
-
-        pcData.view = cameraPtr->GetViewMatrix();
-        pcData.proj = cameraPtr->GetProjMatrix();
-        pcData.cameraPos = glm::vec4(cameraPtr->GetPosition(), 1);
-
-        canvasGrid->SetMatrix(pcData.proj * pcData.view);
-        canvasGrid->SetCameraPos(glm::vec4(cameraPtr->GetPosition(), 1));
     }
 
-    void Project2::OnRender(vk::CommandBuffer commandBuffer)
+    void Project2::OnRender(RenderGraph& graph)
     {
-        vk::ClearValue colorCV{
-            .color = std::array<float, 4>({1.0f, 1.0f, 1.0f, 1.0f}),
-        };
-
-        vk::RenderingAttachmentInfo colorAttachment{
-            .imageView = contextPtr->GetSwapchain()->GetImageView(),
-            .imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
-            .loadOp = vk::AttachmentLoadOp::eClear,
-            .storeOp = vk::AttachmentStoreOp::eStore,
-            .clearValue = colorCV
-        };
-
-        vk::ClearValue depthCV{
-            .depthStencil = { .depth = 1.0f }
-        };
-
-        vk::RenderingAttachmentInfo depthAttachment{
-            .imageView = contextPtr->GetDepthTexture()->GetView(),
-            .imageLayout = vk::ImageLayout::eDepthAttachmentOptimal,
-            .loadOp = vk::AttachmentLoadOp::eClear,
-            .storeOp = vk::AttachmentStoreOp::eStore,
-            .clearValue = depthCV
-        };
-
-        vk::RenderingInfo renderInfo{
-            .renderArea = {.offset = {0, 0}, .extent = contextPtr->GetSwapchain()->GetExtent() },
-            .layerCount = 1,
-            .colorAttachmentCount = 1,
-            .pColorAttachments = &colorAttachment,
-            .pDepthAttachment = &depthAttachment
-        };
-
-        commandBuffer.beginRendering(renderInfo);
-        commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline->Handle());
-
-        vk::Buffer vertexBuffers[] = { vertexBuffer->Handle() };
-        vk::DeviceSize offsets[] = { 0 };
-        commandBuffer.bindVertexBuffers(0, 1, vertexBuffers, offsets);
-        commandBuffer.bindIndexBuffer(indexBuffer->Handle(), 0, vk::IndexType::eUint32);
-
-        auto extent = contextPtr->GetSwapchain()->GetExtent();
-        vk::Viewport viewport{
-            .x = 0.0f,
-            .y = 0.0f,
-            .width = static_cast<float>(extent.width),
-            .height = static_cast<float>(extent.height),
-            .minDepth = 0.0f,
-            .maxDepth = 1.0f
-        };
-        commandBuffer.setViewport(0, 1, &viewport);
-
-        vk::Rect2D scissor{
-            .offset = {0, 0},
-            .extent = extent
-        };
-        commandBuffer.setScissor(0, 1, &scissor);
-
-        pcData.model = glm::rotate(glm::mat4(1.0f), -glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        commandBuffer.pushConstants(pipeline->Layout(), vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eTessellationControl, 0, sizeof(PushConstantData), &pcData);
-        commandBuffer.drawIndexed(indices.size(), 100, 0, 0, 0);
-
-        canvas3D->Render(*contextPtr);
-        canvasGrid->Render(*contextPtr);
-
-        imguiPtr->Render(commandBuffer);
-
-        commandBuffer.endRendering();
+        graph.AddPass("Main")
+            .WriteColor(swapchainTarget, vk::ClearColorValue{ std::array<float, 4>({1.0f, 1.0f, 1.0f, 1.0f}) })
+            .WriteDepth(depthTarget, vk::ClearDepthStencilValue{ .depth = 1.0f })
+            .SetExecute([this](vk::CommandBuffer commandBuffer) {
+                commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline->Handle());
+
+                contextPtr->MarkUsed(vertexBuffer.get());
+                contextPtr->MarkUsed(indexBuffer.get());
+
+                vk::Buffer vertexBuffers[] = { vertexBuffer->Handle() };
+                vk::DeviceSize offsets[] = { 0 };
+                commandBuffer.bindVertexBuffers(0, 1, vertexBuffers, offsets);
+                commandBuffer.bindIndexBuffer(indexBuffer->Handle(), 0, vk::IndexType::eUint32);
+
+                auto extent = contextPtr->GetRenderExtent();
+                vk::Viewport viewport{
+                    .x = 0.0f,
+                    .y = 0.0f,
+                    .width = static_cast<float>(extent.width),
+                    .height = static_cast<float>(extent.height),
+                    .minDepth = 0.0f,
+                    .maxDepth = 1.0f
+                };
+                commandBuffer.setViewport(0, 1, &viewport);
+
+                vk::Rect2D scissor{
+                    .offset = {0, 0},
+                    .extent = extent
+                };
+                commandBuffer.setScissor(0, 1, &scissor);
+
+                pcData.model = glm::rotate(glm::mat4(1.0f), -glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+                pcData.frame = contextPtr->GetFrameConstantsAddress();
+                commandBuffer.pushConstants(pipeline->Layout(), vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eTessellationControl, 0, sizeof(PushConstantData), &pcData);
+                commandBuffer.drawIndexed(indices.size(), 100, 0, 0, 0);
+
+                canvas3D->Render(*contextPtr);
+                canvasGrid->Render(*contextPtr);
+
+                imguiPtr->Render(commandBuffer);
+            });
     }
 
     void Project2::OnCleanup()
@@ -122,7 +89,7 @@ namespace jgw
 
     void Project2::OnResize(int width, int height)
     {
-        auto extent = contextPtr->GetSwapchain()->GetExtent();
+        auto extent = contextPtr->GetRenderExtent();
         const float aspect = extent.width / (float)extent.height;
         cameraPtr->SetAspectRatio(aspect);
     }
@@ -222,7 +189,7 @@ namespace jgw
     void Project2::SetupCamera()
     {
         cameraPtr->SetPosition(glm::vec3(0.5f, 1.0f, 3.0f));
-        auto extent = contextPtr->GetSwapchain()->GetExtent();
+        auto extent = contextPtr->GetRenderExtent();
         const float aspect = extent.width / (float)extent.height;
         cameraPtr->SetPerspective(glm::radians(45.0f), aspect, 0.1f, 1000.0f);
     }
@@ -14,7 +14,7 @@ namespace jgw
     protected:
         virtual bool OnInit() override;
         virtual void OnUpdate(double delta) override;
-        virtual void OnRender(vk::CommandBuffer commandBuffer) override;
+        virtual void OnRender(RenderGraph& graph) override;
         virtual void OnCleanup() override;
         virtual void OnResize(int width, int height) override;
 
@@ -30,14 +30,12 @@ namespace jgw
 
         std::unique_ptr<VulkanBuffer> vertexBuffer;
         std::unique_ptr<VulkanBuffer> indexBuffer;
-        std::unique_ptr<VulkanPipeline> pipeline;
+        std::shared_ptr<VulkanPipeline> pipeline;
 
         struct PushConstantData
         {
             glm::mat4 model;
-            glm::mat4 view;
-            glm::mat4 proj;
-            glm::vec4 cameraPos;
+            vk::DeviceAddress frame;
         } pcData;
     };
 }
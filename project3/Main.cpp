@@ -1,9 +1,10 @@
 #include "Project3.h"
 
-int main()
+int main(int argc, char** argv)
 {
     jgw::WindowConfig config;
     config.title = "Vulkan Project 3";
+    jgw::ParseCommandLine(argc, argv, config);
 
     jgw::Project3 app(config);
     app.Start();
@@ -24,6 +24,7 @@ namespace jgw
         }
 
         SetupCamera();
+        scene->SetModel(glm::scale(glm::mat4(1.0f), glm::vec3(0.01f)));
 
         return true;
     }
@@ -31,49 +32,12 @@ namespace jgw
     void Project3::OnUpdate(double delta)
     {
         cameraPtr->Update(delta);
-
-        glm::mat4 mvp = cameraPtr->GetProjMatrix() * cameraPtr->GetViewMatrix() * glm::scale(glm::mat4(1.0f), glm::vec3(0.01f));
-        scene->SetMVP(mvp);
     }
 
-    void Project3::OnRender(vk::CommandBuffer commandBuffer)
+    void Project3::OnRender(RenderGraph& graph)
     {
-        vk::ClearValue colorCV{
-            .color = std::array<float, 4>({1.0f, 1.0f, 1.0f, 1.0f}),
-        };
-
-        vk::RenderingAttachmentInfo colorAttachment{
-            .imageView = contextPtr->GetSwapchain()->GetImageView(),
-            .imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
-            .loadOp = vk::AttachmentLoadOp::eClear,
-            .storeOp = vk::AttachmentStoreOp::eStore,
-            .clearValue = colorCV
-        };
-
-        vk::ClearValue depthCV{
-            .depthStencil = {.depth = 1.0f }
-        };
-
-        vk::RenderingAttachmentInfo depthAttachment{
-            .imageView = contextPtr->GetDepthTexture()->GetView(),
-            .imageLayout = vk::ImageLayout::eDepthAttachmentOptimal,
-            .loadOp = vk::AttachmentLoadOp::eClear,
-            .storeOp = vk::AttachmentStoreOp::eStore,
-            .clearValue = depthCV
-        };
-
-        vk::RenderingInfo renderInfo{
-            .renderArea = {.offset = {0, 0}, .extent = contextPtr->GetSwapchain()->GetExtent() },
-            .layerCount = 1,
-            .colorAttachmentCount = 1,
-            .pColorAttachments = &colorAttachment,
-            .pDepthAttachment = &depthAttachment
-        };
-
-        commandBuffer.beginRendering(renderInfo);
-
-        auto extent = contextPtr->GetSwapchain()->GetExtent();
-        vk::Viewport viewport{
+        auto extent = contextPtr->GetRenderExtent();
+        viewport = {
             .x = 0.0f,
             .y = 0.0f,
             .width = static_cast<float>(extent.width),
@@ -81,19 +45,30 @@ namespace jgw
             .minDepth = 0.0f,
             .maxDepth = 1.0f
         };
-        commandBuffer.setViewport(0, 1, &viewport);
-
-        vk::Rect2D scissor{
+        scissor = {
             .offset = {0, 0},
             .extent = extent
         };
-        commandBuffer.setScissor(0, 1, &scissor);
-
-        scene->Draw(commandBuffer);
 
-        imguiPtr->Render(commandBuffer);
-
-        commandBuffer.endRendering();
+        // The scene is recorded in secondary command buffers, which cannot be mixed with inline draws
+        graph.AddPass("Scene")
+            .WriteColor(swapchainTarget, vk::ClearColorValue{ std::array<float, 4>({1.0f, 1.0f, 1.0f, 1.0f}) })
+            .WriteDepth(depthTarget, vk::ClearDepthStencilValue{ .depth = 1.0f })
+            .SetRenderingFlags(vk::RenderingFlagBits::eContentsSecondaryCommandBuffers)
+            .SetExecute([this](vk::CommandBuffer) {
+                scene->DrawParallel(*contextPtr, *jobQueue, viewport, scissor);
+            });
+
+        // UI on top in a second pass recorded inline, the depth attachment only matches the ImGui pipeline
+        graph.AddPass("UI")
+            .WriteColor(swapchainTarget)
+            .WriteDepth(depthTarget)
+            .SetExecute([this](vk::CommandBuffer commandBuffer) {
+                commandBuffer.setViewport(0, 1, &viewport);
+                commandBuffer.setScissor(0, 1, &scissor);
+
+                imguiPtr->Render(commandBuffer);
+            });
     }
 
     void Project3::OnCleanup()
@@ -103,7 +78,7 @@ namespace jgw
 
     void Project3::OnResize(int width, int height)
     {
-        auto extent = contextPtr->GetSwapchain()->GetExtent();
+        auto extent = contextPtr->GetRenderExtent();
         const float aspect = extent.width / (float)extent.height;
         cameraPtr->SetAspectRatio(aspect);
     }
@@ -132,10 +107,22 @@ namespace jgw
         return true;
     }
 
+    CameraPath Project3::GetBenchmarkPath() const
+    {
+        // Twenty second loop through the Bistro exterior starting and ending at the initial camera
+        CameraPath path;
+        path.AddKeyframe({ .time = 0.0f, .position = glm::vec3(-14.894f, 5.743f, -5.527f), .rotation = glm::vec3(0.0f, 0.0f, 0.0f) });
+        path.AddKeyframe({ .time = 5.0f, .position = glm::vec3(-8.0f, 3.0f, -2.0f), .rotation = glm::vec3(10.0f, 45.0f, 0.0f) });
+        path.AddKeyframe({ .time = 10.0f, .position = glm::vec3(0.0f, 2.5f, 2.0f), .rotation = glm::vec3(5.0f, 90.0f, 0.0f) });
+        path.AddKeyframe({ .time = 15.0f, .position = glm::vec3(6.0f, 4.0f, -4.0f), .rotation = glm::vec3(15.0f, 180.0f, 0.0f) });
+        path.AddKeyframe({ .time = 20.0f, .position = glm::vec3(-14.894f, 5.743f, -5.527f), .rotation = glm::vec3(0.0f, 360.0f, 0.0f) });
+        return path;
+    }
+
     void Project3::SetupCamera()
     {
         cameraPtr->SetPosition(glm::vec3(-14.894f, 5.743f, -5.527f));
-        auto extent = contextPtr->GetSwapchain()->GetExtent();
+        auto extent = contextPtr->GetRenderExtent();
         const float aspect = extent.width / (float)extent.height;
         cameraPtr->SetPerspective(glm::radians(45.0f), aspect, 0.1f, 1000.0f);
     }
@@ -15,9 +15,10 @@ namespace jgw
     protected:
         virtual bool OnInit() override;
         virtual void OnUpdate(double delta) override;
-        virtual void OnRender(vk::CommandBuffer commandBuffer) override;
+        virtual void OnRender(RenderGraph& graph) override;
         virtual void OnCleanup() override;
         virtual void OnResize(int width, int height) override;
+        virtual CameraPath GetBenchmarkPath() const override;
 
     private:
         bool LoadScene();
@@ -25,5 +26,9 @@ namespace jgw
         void SetupCamera();
 
         std::unique_ptr<VulkanMesh> scene;
+
+        // Shared by the passes of the frame
+        vk::Viewport viewport{};
+        vk::Rect2D scissor{};
     };
 }
\ No newline at end of file
@@ -1,9 +1,10 @@
 #include "Project4.h"
 
-int main()
+int main(int argc, char** argv)
 {
     jgw::WindowConfig config;
     config.title = "Vulkan Project 4";
+    jgw::ParseCommandLine(argc, argv, config);
 
     jgw::Project4 app(config);
     app.Start();